@@ -46,6 +46,7 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    SHA256AutoDetect();
     RandomInit();
     ECC_Start();
     ECCVerifyHandle globalVerifyHandle;
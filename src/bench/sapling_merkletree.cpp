@@ -0,0 +1,77 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+#include "sapling/incrementalmerkletree.h"
+
+// Shielded outputs per block (a dozen shielded transactions with a couple of outputs each)
+static const int BLOCK_COMMITMENTS = 24;
+// Commitments already in the tree
+static const int TREE_COMMITMENTS = 1000;
+// Unspent notes of the wallet, each one with its witness
+static const int WALLET_NOTES = 20;
+
+static std::vector<uint256> RandomCommitments(FastRandomContext& rng, int nCount)
+{
+    std::vector<uint256> vCommitments;
+    vCommitments.reserve(nCount);
+    for (int i = 0; i < nCount; i++) {
+        vCommitments.emplace_back(rng.rand256());
+    }
+    return vCommitments;
+}
+
+// A new block, with fresh commitments, goes through block assembly (CalculateSaplingTreeRoot)
+// and then ConnectBlock (PushAnchor and the hashFinalSaplingRoot check), each starting from
+// the anchor tree.
+static void SaplingTreeBlock(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    SaplingMerkleTree anchorTree;
+    anchorTree.append(RandomCommitments(rng, TREE_COMMITMENTS));
+    while (state.KeepRunning()) {
+        const std::vector<uint256> vCommitments = RandomCommitments(rng, BLOCK_COMMITMENTS);
+
+        SaplingMerkleTree assemblyTree = anchorTree;
+        assemblyTree.append(vCommitments);
+        const uint256 hashFinalSaplingRoot = assemblyTree.root();
+
+        SaplingMerkleTree connectTree = anchorTree;
+        connectTree.append(vCommitments);
+        bool fValid = connectTree.root() == hashFinalSaplingRoot;
+        fValid &= connectTree.root() == hashFinalSaplingRoot;
+        assert(fValid);
+
+        anchorTree = connectTree;
+    }
+}
+
+// The chain tree is appended a new block, then every witness of the wallet (IncrementNoteWitnesses)
+static void SaplingWitnessesBlock(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    SaplingMerkleTree tree;
+    std::vector<SaplingWitness> vWitnesses;
+    for (int i = 0; i < WALLET_NOTES; i++) {
+        const std::vector<uint256> vCommitments = RandomCommitments(rng, TREE_COMMITMENTS / WALLET_NOTES);
+        tree.append(vCommitments);
+        for (SaplingWitness& witness : vWitnesses) {
+            witness.append(vCommitments);
+        }
+        vWitnesses.emplace_back(tree.witness());
+    }
+    while (state.KeepRunning()) {
+        const std::vector<uint256> vCommitments = RandomCommitments(rng, BLOCK_COMMITMENTS);
+        tree.append(vCommitments);
+        const uint256 root = tree.root();
+        for (SaplingWitness& witness : vWitnesses) {
+            witness.append(vCommitments);
+        }
+        assert(vWitnesses.front().root() == root);
+    }
+}
+
+BENCHMARK(SaplingTreeBlock, 20);
+BENCHMARK(SaplingWitnessesBlock, 10);
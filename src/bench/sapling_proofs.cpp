@@ -0,0 +1,106 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainparams.h"
+#include "checkqueue.h"
+#include "consensus/validation.h"
+#include "sapling/incrementalmerkletree.h"
+#include "sapling/note.h"
+#include "sapling/sapling_validation.h"
+#include "sapling/transaction_builder.h"
+#include "script/interpreter.h"
+#include "util/system.h"
+
+#include <boost/thread/thread.hpp>
+
+// Number of shielded transactions (1 spend, 2 outputs each) verified per iteration,
+// roughly what a block full of shielded transactions contains.
+static const int SHIELDED_TXES = 24;
+static const int MIN_CORES = 2;
+
+static const std::vector<CTransaction>& GetShieldedTxes()
+{
+    static std::vector<CTransaction> vTxes;
+    if (!vTxes.empty()) return vTxes;
+
+    SelectParams(CBaseChainParams::REGTEST);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_V4_0, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    initZKSNARKS();
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    vTxes.reserve(SHIELDED_TXES);
+    for (int i = 0; i < SHIELDED_TXES; i++) {
+        auto sk = libzcash::SaplingSpendingKey::random();
+        auto expsk = sk.expanded_spending_key();
+        auto fvk = sk.full_viewing_key();
+        auto pa = sk.default_address();
+
+        // Dummy note to spend
+        libzcash::SaplingNote note(pa, 100000000);
+        SaplingMerkleTree tree;
+        tree.append(note.cmu().get());
+
+        TransactionBuilder builder(consensus);
+        builder.SetFee(10000000);
+        builder.AddSaplingSpend(expsk, note, tree.root(), tree.witness());
+        builder.AddSaplingOutput(fvk.ovk, pa, 50000000);
+        builder.SendChangeTo(pa, fvk.ovk);
+        vTxes.emplace_back(builder.Build().GetTxOrThrow());
+    }
+    return vTxes;
+}
+
+static std::vector<uint256> GetSigHashes(const std::vector<CTransaction>& vTxes)
+{
+    std::vector<uint256> vHashes;
+    vHashes.reserve(vTxes.size());
+    for (const CTransaction& tx : vTxes) {
+        vHashes.emplace_back(SignatureHash(CScript(), tx, NOT_AN_INPUT, SIGHASH_ALL, 0, SIGVERSION_SAPLING));
+    }
+    return vHashes;
+}
+
+// Verify the proofs one transaction after the other (no check threads)
+static void SaplingProofsSerial(benchmark::State& state)
+{
+    const std::vector<CTransaction>& vTxes = GetShieldedTxes();
+    const std::vector<uint256> vHashes = GetSigHashes(vTxes);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vTxes.size(); i++) {
+            CValidationState valState;
+            bool fValid = SaplingValidation::CheckProofs(vTxes[i], vHashes[i], valState, 100);
+            assert(fValid);
+        }
+    }
+}
+
+// Verify the proofs through the check queue, as ContextualCheckBlock does with -par
+static void SaplingProofsCheckQueue(benchmark::State& state)
+{
+    const std::vector<CTransaction>& vTxes = GetShieldedTxes();
+    const std::vector<uint256> vHashes = GetSigHashes(vTxes);
+
+    CCheckQueue<CSaplingCheck> queue(16);
+    boost::thread_group tg;
+    for (int x = 0; x < std::max(MIN_CORES, GetNumCores()) - 1; ++x) {
+        tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CSaplingCheck> control(&queue);
+        std::vector<CSaplingCheck> vChecks;
+        vChecks.reserve(vTxes.size());
+        for (size_t i = 0; i < vTxes.size(); i++) {
+            vChecks.emplace_back(vTxes[i], vHashes[i]);
+        }
+        control.Add(vChecks);
+        bool fValid = control.Wait();
+        assert(fValid);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BENCHMARK(SaplingProofsSerial, 1);
+BENCHMARK(SaplingProofsCheckQueue, 1);
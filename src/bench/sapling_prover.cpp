@@ -0,0 +1,69 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainparams.h"
+#include "sapling/incrementalmerkletree.h"
+#include "sapling/note.h"
+#include "sapling/transaction_builder.h"
+#include "util/system.h"
+
+// A shielded send gathering many notes, as the payout of a pool does:
+// 8 spends and 8 outputs (plus the change), so 17 proofs per transaction.
+static const int PROVER_SPENDS = 8;
+static const int PROVER_OUTPUTS = 8;
+
+static void SaplingProveAndSign(benchmark::State& state, int nThreads)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    UpdateNetworkUpgradeParameters(Consensus::UPGRADE_V4_0, Consensus::NetworkUpgrade::ALWAYS_ACTIVE);
+    initZKSNARKS();
+
+    auto sk = libzcash::SaplingSpendingKey::random();
+    auto expsk = sk.expanded_spending_key();
+    auto fvk = sk.full_viewing_key();
+    auto pa = sk.default_address();
+
+    // Dummy notes to spend
+    std::vector<libzcash::SaplingNote> vNotes;
+    SaplingMerkleTree tree;
+    for (int i = 0; i < PROVER_SPENDS; i++) {
+        vNotes.emplace_back(pa, 100000000);
+        tree.append(vNotes.back().cmu().get());
+    }
+    std::vector<SaplingWitness> vWitnesses;
+    SaplingMerkleTree witnessTree;
+    for (const auto& note : vNotes) {
+        witnessTree.append(note.cmu().get());
+        vWitnesses.emplace_back(witnessTree.witness());
+        for (size_t j = vWitnesses.size(); j < vNotes.size(); j++) {
+            vWitnesses.back().append(vNotes[j].cmu().get());
+        }
+    }
+
+    TransactionBuilder builder(Params().GetConsensus());
+    builder.SetProvingThreads(nThreads);
+    while (state.KeepRunning()) {
+        builder.Clear();
+        builder.SetFee(10000000);
+        for (int i = 0; i < PROVER_SPENDS; i++) {
+            builder.AddSaplingSpend(expsk, vNotes[i], tree.root(), vWitnesses[i]);
+        }
+        for (int i = 0; i < PROVER_OUTPUTS; i++) {
+            builder.AddSaplingOutput(fvk.ovk, pa, 50000000);
+        }
+        builder.SendChangeTo(pa, fvk.ovk);
+        assert(builder.Build().IsTx());
+    }
+}
+
+static void SaplingProveAndSign_1Thread(benchmark::State& state) { SaplingProveAndSign(state, 1); }
+static void SaplingProveAndSign_2Threads(benchmark::State& state) { SaplingProveAndSign(state, 2); }
+static void SaplingProveAndSign_4Threads(benchmark::State& state) { SaplingProveAndSign(state, 4); }
+static void SaplingProveAndSign_8Threads(benchmark::State& state) { SaplingProveAndSign(state, 8); }
+
+BENCHMARK(SaplingProveAndSign_1Thread, 1);
+BENCHMARK(SaplingProveAndSign_2Threads, 1);
+BENCHMARK(SaplingProveAndSign_4Threads, 1);
+BENCHMARK(SaplingProveAndSign_8Threads, 1);
@@ -0,0 +1,136 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "netbase.h"
+#include "socketevents.h"
+
+#ifndef WIN32
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Loopback peers driven per iteration. Kept well below FD_SETSIZE / 2, so that select() can watch all of them.
+static const int LOOPBACK_PEERS = 400;
+// Peers sending in each iteration: most peers of a node are idle at any given time
+static const int ACTIVE_PEERS = LOOPBACK_PEERS / 10;
+// Small messages sent by each active peer per iteration (roughly a ping or an inv with a couple of entries)
+static const int MESSAGES_PER_PEER = 4;
+static const size_t MESSAGE_SIZE = 64;
+
+struct LoopbackPeers
+{
+    //! Our side of the connections, watched through CSocketEvents
+    std::vector<SOCKET> vLocal;
+    //! The remote peers, writing the messages
+    std::vector<SOCKET> vRemote;
+
+    explicit LoopbackPeers(int nPeers)
+    {
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        bool fListening = bind(hListen, (struct sockaddr*)&addr, len) == 0 &&
+                          listen(hListen, SOMAXCONN) == 0 &&
+                          getsockname(hListen, (struct sockaddr*)&addr, &len) == 0;
+        assert(fListening);
+
+        for (int i = 0; i < nPeers; i++) {
+            SOCKET hRemote = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            bool fConnected = connect(hRemote, (struct sockaddr*)&addr, len) == 0;
+            assert(fConnected);
+            int nOne = 1;
+            setsockopt(hRemote, IPPROTO_TCP, TCP_NODELAY, &nOne, sizeof(nOne));
+            SOCKET hLocal = accept(hListen, nullptr, nullptr);
+            assert(hLocal != INVALID_SOCKET);
+            SetSocketNonBlocking(hLocal, true);
+            vRemote.push_back(hRemote);
+            vLocal.push_back(hLocal);
+        }
+        CloseSocket(hListen);
+    }
+
+    ~LoopbackPeers()
+    {
+        for (SOCKET& hSocket : vLocal) CloseSocket(hSocket);
+        for (SOCKET& hSocket : vRemote) CloseSocket(hSocket);
+    }
+};
+
+// A rotating subset of the peers sends its messages, then we wait for readiness and read until all of
+// them arrived, the way the socket handler does. Messages/s = ACTIVE_PEERS * MESSAGES_PER_PEER / time per
+// iteration; the cost of watching the idle peers is what differs between the modes.
+static void SocketEventsLoopback(benchmark::State& state, SocketEventsMode mode)
+{
+    LoopbackPeers peers(LOOPBACK_PEERS);
+    CSocketEvents events(mode);
+    std::string strError;
+    bool fInit = events.Init(strError);
+    for (size_t i = 0; i < peers.vLocal.size(); i++) {
+        fInit &= events.Add(peers.vLocal[i], i);
+    }
+    assert(fInit);
+
+    const size_t nTotalBytes = ACTIVE_PEERS * MESSAGES_PER_PEER * MESSAGE_SIZE;
+    std::vector<unsigned char> vMessage(MESSAGE_SIZE, 0x42);
+    std::vector<bool> vRecvReady(peers.vLocal.size(), false);
+    std::vector<SocketInterest> vInterest;
+    std::vector<SocketEvent> vEvents;
+    char pchBuf[0x10000];
+    size_t nNextPeer = 0;
+
+    while (state.KeepRunning()) {
+        for (int k = 0; k < ACTIVE_PEERS; k++) {
+            SOCKET hRemote = peers.vRemote[nNextPeer];
+            nNextPeer = (nNextPeer + 1) % peers.vRemote.size();
+            for (int j = 0; j < MESSAGES_PER_PEER; j++) {
+                ssize_t nSent = send(hRemote, vMessage.data(), vMessage.size(), 0);
+                assert(nSent == (ssize_t)vMessage.size());
+            }
+        }
+
+        size_t nReceived = 0;
+        while (nReceived < nTotalBytes) {
+            vInterest.clear();
+            if (!events.IsEdgeTriggered()) {
+                for (size_t i = 0; i < peers.vLocal.size(); i++) {
+                    vInterest.emplace_back(peers.vLocal[i], i, true, false);
+                }
+            }
+            events.Wait(vInterest, 50, vEvents);
+            for (const SocketEvent& event : vEvents) {
+                if (event.fRecv) vRecvReady[event.nTag] = true;
+            }
+            for (size_t i = 0; i < peers.vLocal.size(); i++) {
+                if (!vRecvReady[i]) continue;
+                vRecvReady[i] = false;
+                ssize_t nBytes = recv(peers.vLocal[i], pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                if (nBytes > 0) {
+                    nReceived += nBytes;
+                    if (nBytes == (ssize_t)sizeof(pchBuf)) vRecvReady[i] = true;
+                }
+            }
+        }
+    }
+}
+
+static void SocketEventsSelect(benchmark::State& state)
+{
+    SocketEventsLoopback(state, SocketEventsMode::SELECT);
+}
+BENCHMARK(SocketEventsSelect, 100);
+
+#ifdef USE_EPOLL
+static void SocketEventsEpoll(benchmark::State& state)
+{
+    SocketEventsLoopback(state, SocketEventsMode::EPOLL);
+}
+BENCHMARK(SocketEventsEpoll, 100);
+#endif
+
+#endif // WIN32
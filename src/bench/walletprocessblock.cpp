@@ -56,7 +56,7 @@ std::shared_ptr<CBlock> createAndProcessBlock(
     block.hashFinalSaplingRoot = CalculateSaplingTreeRoot(&block, nextHeight, params);
 
     const auto& blockHash = block.GetHash();
-    CBlockIndex* fakeIndex = new CBlockIndex{block};
+    CBlockIndex* fakeIndex = blockIndexArena.Alloc(block);
     fakeIndex->nHeight = nextHeight;
     BlockMap::iterator mi = mapBlockIndex.emplace(blockHash, fakeIndex).first;
     fakeIndex->phashBlock = &((*mi).first);
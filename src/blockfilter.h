@@ -0,0 +1,140 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_BLOCKFILTER_H
+#define OASIS_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+class CScript;
+
+/**
+ * This implements a Golomb-coded set as defined in BIP 158. It is a
+ * compact, probabilistic data structure for testing set membership.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t m_siphash_k0;
+        uint64_t m_siphash_k1;
+        uint8_t m_P;  //!< Golomb-Rice coding parameter
+        uint32_t m_M;  //!< Inverse false positive rate
+
+        Params(uint64_t siphash_k0 = 0, uint64_t siphash_k1 = 0, uint8_t P = 0, uint32_t M = 1)
+            : m_siphash_k0(siphash_k0), m_siphash_k1(siphash_k1), m_P(P), m_M(M)
+        {}
+    };
+
+private:
+    Params m_params;
+    uint32_t m_N;  //!< Number of elements in the filter
+    uint64_t m_F;  //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> m_encoded;
+
+    /** Hash a data element to an integer in the range [0, N * M). */
+    uint64_t HashToRange(const Element& element) const;
+
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+
+    /** Helper method used to implement Match and MatchAny */
+    bool MatchInternal(const uint64_t* sorted_element_hashes, size_t size) const;
+
+public:
+
+    /** Constructs an empty filter. */
+    explicit GCSFilter(const Params& params = Params());
+
+    /** Reconstructs an already-created filter from an encoding. */
+    GCSFilter(const Params& params, std::vector<unsigned char> encoded_filter);
+
+    /** Builds a new filter from the params and set of elements. */
+    GCSFilter(const Params& params, const ElementSet& elements);
+
+    uint32_t GetN() const { return m_N; }
+    const Params& GetParams() const { return m_params; }
+    const std::vector<unsigned char>& GetEncoded() const { return m_encoded; }
+
+    /**
+     * Checks if the element may be in the set. False positives are possible
+     * with probability 1/M.
+     */
+    bool Match(const Element& element) const;
+
+    /**
+     * Checks if any of the given elements may be in the set. False positives
+     * are possible with probability 1/M per element checked. This is more
+     * efficient that checking Match on multiple elements separately.
+     */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+/** Golomb-Rice parameters of the block filters (the ones of the BIP 158 basic filter) */
+static const uint8_t BLOCK_FILTER_P = 19;
+static const uint32_t BLOCK_FILTER_M = 784931;
+
+/**
+ * Complete block filter struct. The filter of a block holds the destinations of the
+ * scripts created and spent by its transactions, instead of the raw scriptPubKeys of
+ * BIP 158: the key and script ids of the standard scripts (both keys of a cold staking
+ * script), and the nonstandard scripts themselves. Unlike scriptPubKeys, these can be
+ * enumerated from the keys of a wallet. Blocks with shielded transactions also hold the
+ * SHIELDED_TX_ELEMENT.
+ */
+class BlockFilter
+{
+private:
+    uint256 m_block_hash;
+    GCSFilter m_filter;
+
+    GCSFilter::Params BuildParams() const;
+
+public:
+
+    BlockFilter() = default;
+
+    //! Reconstruct a BlockFilter from parts.
+    BlockFilter(const uint256& block_hash, std::vector<unsigned char> filter);
+
+    //! Construct a new BlockFilter of the block, with the scripts spent by it (block_undo).
+    BlockFilter(const CBlock& block, const CBlockUndo& block_undo);
+
+    const uint256& GetBlockHash() const { return m_block_hash; }
+    const GCSFilter& GetFilter() const { return m_filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return m_filter.GetEncoded(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << m_block_hash
+          << m_filter.GetEncoded();
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        std::vector<unsigned char> encoded_filter;
+        s >> m_block_hash
+          >> encoded_filter;
+        m_filter = GCSFilter(BuildParams(), std::move(encoded_filter));
+    }
+};
+
+//! Element of the filters of the blocks having shielded transactions
+extern const GCSFilter::Element SHIELDED_TX_ELEMENT;
+
+//! Add the filter elements of a script (see BlockFilter)
+void AddScriptFilterElements(const CScript& script, GCSFilter::ElementSet& elements);
+
+#endif // OASIS_BLOCKFILTER_H
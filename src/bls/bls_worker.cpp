@@ -51,6 +51,8 @@ std::pair<std::function<void(T)>, std::future<T> > BuildFutureDoneCallback2()
 
 /////
 
+std::unique_ptr<CBLSWorker> g_bls_worker;
+
 CBLSWorker::CBLSWorker()
 {
 }
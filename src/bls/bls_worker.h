@@ -10,6 +10,7 @@
 #include "ctpl.h"
 
 #include <future>
+#include <memory>
 #include <mutex>
 
 #include <boost/lockfree/queue.hpp>
@@ -143,6 +144,9 @@ private:
     void PushSigVerifyBatch();
 };
 
+/** The worker of the node, used by the block validation. May be null. */
+extern std::unique_ptr<CBLSWorker> g_bls_worker;
+
 // Builds and caches different things from CBLSWorker
 // Cache keys are provided externally as computing hashes on BLS vectors is too expensive
 // If multiple threads try to build the same thing at the same time, only one will actually build it
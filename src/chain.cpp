@@ -6,6 +6,7 @@
 
 #include "chain.h"
 #include "legacy/stakemodifier.h"  // for ComputeNextStakeModifier
+#include "memusage.h"
 
 
 /**
@@ -121,13 +122,17 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-CBlockIndex::CBlockIndex(const CBlock& block):
+CBlockIndex::CBlockIndex(const CBlockHeader& block):
         nVersion{block.nVersion},
         hashMerkleRoot{block.hashMerkleRoot},
         hashFinalSaplingRoot(block.hashFinalSaplingRoot),
         nTime{block.nTime},
         nBits{block.nBits},
         nNonce{block.nNonce}
+{}
+
+CBlockIndex::CBlockIndex(const CBlock& block):
+        CBlockIndex(static_cast<const CBlockHeader&>(block))
 {
     if (block.IsProofOfStake())
         SetProofOfStake();
@@ -170,6 +175,7 @@ CBlockHeader CBlockIndex::GetBlockHeader() const
     block.nTime = nTime;
     block.nBits = nBits;
     block.nNonce = nNonce;
+    block.hashFinalSaplingRoot = hashFinalSaplingRoot;
     return block;
 }
 
@@ -228,10 +234,7 @@ bool CBlockIndex::SetStakeEntropyBit(unsigned int nEntropyBit)
 // Sets V1 stake modifier (uint64_t)
 void CBlockIndex::SetStakeModifier(const uint64_t nStakeModifier, bool fGeneratedStakeModifier)
 {
-    vStakeModifier.clear();
-    const size_t modSize = sizeof(nStakeModifier);
-    vStakeModifier.resize(modSize);
-    std::memcpy(vStakeModifier.data(), &nStakeModifier, modSize);
+    vStakeModifier.assign((const unsigned char*)&nStakeModifier, sizeof(nStakeModifier));
     if (fGeneratedStakeModifier)
         nFlags |= BLOCK_STAKE_MODIFIER;
 
@@ -253,8 +256,7 @@ void CBlockIndex::SetNewStakeModifier()
 // Sets V2 stake modifiers (uint256)
 void CBlockIndex::SetStakeModifier(const uint256& nStakeModifier)
 {
-    vStakeModifier.clear();
-    vStakeModifier.insert(vStakeModifier.begin(), nStakeModifier.begin(), nStakeModifier.end());
+    vStakeModifier.assign(nStakeModifier.begin(), nStakeModifier.size());
 }
 
 // Generates and sets new V2 stake modifier
@@ -276,8 +278,8 @@ uint64_t CBlockIndex::GetStakeModifierV1() const
 {
     if (vStakeModifier.empty() || Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_TIME_V2))
         return 0;
-    uint64_t nStakeModifier;
-    std::memcpy(&nStakeModifier, vStakeModifier.data(), vStakeModifier.size());
+    uint64_t nStakeModifier = 0;
+    std::memcpy(&nStakeModifier, vStakeModifier.data(), std::min(vStakeModifier.size(), sizeof(nStakeModifier)));
     return nStakeModifier;
 }
 
@@ -349,3 +351,26 @@ const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex*
 }
 
 
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vSlabs.size(); i++) {
+        CBlockIndex* pentries = reinterpret_cast<CBlockIndex*>(vSlabs[i].get());
+        const size_t nUsed = (i + 1 == vSlabs.size() ? nUsedInLastSlab : ENTRIES_PER_SLAB);
+        for (size_t j = 0; j < nUsed; j++) {
+            pentries[j].~CBlockIndex();
+        }
+    }
+    vSlabs.clear();
+    nUsedInLastSlab = 0;
+}
+
+size_t CBlockIndexArena::Size() const
+{
+    return vSlabs.empty() ? 0 : (vSlabs.size() - 1) * ENTRIES_PER_SLAB + nUsedInLastSlab;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return vSlabs.size() * memusage::MallocUsage(sizeof(Entry) * ENTRIES_PER_SLAB) + memusage::DynamicUsage(vSlabs);
+}
@@ -20,6 +20,9 @@
 #include "uint256.h"
 #include "util/system.h"
 
+#include <cstring>
+#include <memory>
+#include <type_traits>
 #include <vector>
 
 /**
@@ -130,6 +133,54 @@ enum {
     BLOCK_STAKE_MODIFIER = (1 << 2), // regenerated stake modifier
 };
 
+/** Stake modifier bytes, stored inline in the block index entry instead of in a
+ * separately allocated vector. Empty for PoW blocks, 8 bytes for the V1 modifier and
+ * 32 bytes for the V2 modifier. Serialized exactly like the std::vector<unsigned char>
+ * it replaces (compact size followed by the bytes), so the on-disk format is unchanged.
+ */
+class CStakeModifierBytes
+{
+public:
+    static const size_t MAX_SIZE = 32;
+
+    bool empty() const { return nSize == 0; }
+    size_t size() const { return nSize; }
+    const unsigned char* data() const { return vch; }
+
+    void clear() { nSize = 0; }
+    void assign(const unsigned char* pbegin, size_t nLen)
+    {
+        if (nLen > MAX_SIZE) throw std::runtime_error("CStakeModifierBytes::assign(): size too large");
+        std::memcpy(vch, pbegin, nLen);
+        nSize = (uint8_t)nLen;
+    }
+
+    friend bool operator==(const CStakeModifierBytes& a, const CStakeModifierBytes& b)
+    {
+        return a.nSize == b.nSize && std::memcmp(a.vch, b.vch, a.nSize) == 0;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, nSize);
+        if (nSize) s.write((const char*)vch, nSize);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint64_t nLen = ReadCompactSize(s);
+        if (nLen > MAX_SIZE) throw std::ios_base::failure("CStakeModifierBytes::Unserialize(): size too large");
+        nSize = (uint8_t)nLen;
+        if (nSize) s.read((char*)vch, nSize);
+    }
+
+private:
+    unsigned char vch[MAX_SIZE];
+    uint8_t nSize{0};
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -175,9 +226,9 @@ public:
     uint32_t nStatus{0};
 
     // proof-of-stake specific fields
-    // char vector holding the stake modifier bytes. It is empty for PoW blocks.
+    // inline buffer holding the stake modifier bytes. It is empty for PoW blocks.
     // Modifier V1 is 64 bit while modifier V2 is 256 bit.
-    std::vector<unsigned char> vStakeModifier{};
+    CStakeModifierBytes vStakeModifier{};
     unsigned int nFlags{0};
 
     //! Change in value held by the Sapling circuit over this block.
@@ -204,6 +255,7 @@ public:
     unsigned int nTimeMax{0};
 
     CBlockIndex() {}
+    CBlockIndex(const CBlockHeader& block);
     CBlockIndex(const CBlock& block);
 
     std::string ToString() const;
@@ -253,6 +305,48 @@ public:
 /** Find the forking point between two chain tips. */
 const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex* pb);
 
+/** Slab allocator for the block index entries referenced by mapBlockIndex.
+ * Entries are carved out of fixed-size slabs instead of being allocated one by one,
+ * which saves the per-allocation malloc overhead and keeps neighbouring entries close
+ * in memory. Entries are never freed individually: Clear() releases all of them at once.
+ * Not thread safe, the caller must hold cs_main.
+ */
+class CBlockIndexArena
+{
+public:
+    static const size_t ENTRIES_PER_SLAB = 4096;
+
+    CBlockIndexArena() {}
+    ~CBlockIndexArena() { Clear(); }
+    CBlockIndexArena(const CBlockIndexArena&) = delete;
+    CBlockIndexArena& operator=(const CBlockIndexArena&) = delete;
+
+    template <typename... Args>
+    CBlockIndex* Alloc(Args&&... args)
+    {
+        if (vSlabs.empty() || nUsedInLastSlab == ENTRIES_PER_SLAB) {
+            vSlabs.emplace_back(new Entry[ENTRIES_PER_SLAB]);
+            nUsedInLastSlab = 0;
+        }
+        void* p = &vSlabs.back()[nUsedInLastSlab];
+        CBlockIndex* pindex = new (p) CBlockIndex(std::forward<Args>(args)...);
+        nUsedInLastSlab++;
+        return pindex;
+    }
+
+    //! Destroy all the entries and release the slabs
+    void Clear();
+    //! Number of entries currently allocated
+    size_t Size() const;
+    //! Heap memory held by the slabs
+    size_t DynamicMemoryUsage() const;
+
+private:
+    typedef std::aligned_storage<sizeof(CBlockIndex), alignof(CBlockIndex)>::type Entry;
+    std::vector<std::unique_ptr<Entry[]>> vSlabs;
+    size_t nUsedInLastSlab{0};
+};
+
 /** Used to marshal pointers into hashes for db storage. */
 
 // New serialization introduced with v3.0.0 "Leap"
@@ -225,6 +225,10 @@ public:
 
         // Reject non-standard transactions by default
         fRequireStandard = true;
+        // After the PoS upgrade a header carries no proof (the stake is checked with the
+        // body), so the headers of unknown blocks are free to make: off until peers that
+        // announce headers without ever serving their blocks can be told apart.
+        fHeadersFirstSyncingActive = false;
 
         // Sapling
         bech32HRPs[SAPLING_PAYMENT_ADDRESS]      = "ps";
@@ -328,6 +332,7 @@ public:
         vFixedSeeds = std::vector<uint8_t>(std::begin(chainparams_seed_test), std::end(chainparams_seed_test));
 
         fRequireStandard = false;
+        fHeadersFirstSyncingActive = true;
 
         // Sapling
         bech32HRPs[SAPLING_PAYMENT_ADDRESS]      = "ptestsapling";
@@ -426,6 +431,7 @@ public:
 
         // Reject non-standard transactions by default
         fRequireStandard = true;
+        fHeadersFirstSyncingActive = true;
 
         // Sapling
         bech32HRPs[SAPLING_PAYMENT_ADDRESS]      = "ptestsapling";
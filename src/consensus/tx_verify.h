@@ -14,6 +14,7 @@
 class CBlockIndex;
 class CChainParams;
 class CCoinsViewCache;
+class CSaplingCheck;
 class CValidationState;
 
 /** Transaction validation functions */
@@ -21,7 +22,7 @@ class CValidationState;
 /** Context-independent validity checks */
 bool CheckTransaction(const CTransaction& tx, CValidationState& state, bool fColdStakingActive);
 /** Context-dependent validity checks */
-bool ContextualCheckTransaction(const CTransactionRef& tx, CValidationState& state, const CChainParams& chainparams, int nHeight, bool isMined, bool fIBD);
+bool ContextualCheckTransaction(const CTransactionRef& tx, CValidationState& state, const CChainParams& chainparams, int nHeight, bool isMined, bool fIBD, std::vector<CSaplingCheck>* pvSaplingChecks = nullptr);
 
 /**
  * Count ECDSA signature operations the old-fashioned (pre-0.6) way
@@ -0,0 +1,160 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHA-256 using the Intel SHA extensions. Each sha256rnds2 instruction runs
+// two rounds on a state held as {ABEF, CDGH}; sha256msg1/sha256msg2 compute
+// the message schedule four words at a time. Only built when the compiler
+// accepts -msha, and only called after SHA256AutoDetect has found SHA-NI
+// support at runtime.
+
+#ifdef ENABLE_SHANI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+namespace sha256_shani
+{
+namespace
+{
+
+alignas(16) const uint32_t K[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul};
+
+alignas(16) const uint32_t IV[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+
+/** Byte-swap each 32-bit word, to read or write big-endian message words. */
+__m128i inline BSwap(__m128i x)
+{
+    return _mm_shuffle_epi8(x, _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull));
+}
+
+/** Convert a state in word order {A..D}, {E..H} into the {ABEF}, {CDGH} layout. */
+void inline Unpack(__m128i& s0, __m128i& s1)
+{
+    __m128i t = _mm_shuffle_epi32(s0, 0xB1); // CDAB
+    s1 = _mm_shuffle_epi32(s1, 0x1B);        // EFGH
+    s0 = _mm_alignr_epi8(t, s1, 8);          // ABEF
+    s1 = _mm_blend_epi16(s1, t, 0xF0);       // CDGH
+}
+
+/** Inverse of Unpack. */
+void inline Pack(__m128i& s0, __m128i& s1)
+{
+    __m128i t = _mm_shuffle_epi32(s0, 0x1B); // FEBA
+    s1 = _mm_shuffle_epi32(s1, 0xB1);        // DCHG
+    s0 = _mm_blend_epi16(t, s1, 0xF0);       // DCBA
+    s1 = _mm_alignr_epi8(s1, t, 8);          // HGFE
+}
+
+/** Run the 64 rounds over the big-endian message words m, adding the result into {s0, s1}. */
+void inline Compress(__m128i& s0, __m128i& s1, __m128i* m)
+{
+    const __m128i save0 = s0, save1 = s1;
+    for (int i = 0; i < 16; i++) {
+        if (i >= 4) {
+            // m[i & 3] holds W[4i-16..4i-13]; extend it to W[4i..4i+3].
+            __m128i x = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+            x = _mm_add_epi32(x, _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4));
+            m[i & 3] = _mm_sha256msg2_epu32(x, m[(i + 3) & 3]);
+        }
+        __m128i msg = _mm_add_epi32(m[i & 3], _mm_load_si128((const __m128i*)(K + 4 * i)));
+        s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+        s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0E));
+    }
+    s0 = _mm_add_epi32(s0, save0);
+    s1 = _mm_add_epi32(s1, save1);
+}
+
+void inline LoadIV(__m128i& s0, __m128i& s1)
+{
+    s0 = _mm_load_si128((const __m128i*)IV);
+    s1 = _mm_load_si128((const __m128i*)(IV + 4));
+    Unpack(s0, s1);
+}
+
+/** Hash two 64-byte inputs with interleaved instruction streams; fDouble selects SHA256d. */
+void inline Hash64_2way(unsigned char* out, const unsigned char* in, bool fDouble)
+{
+    __m128i sa0, sa1, sb0, sb1, ma[4], mb[4];
+    LoadIV(sa0, sa1);
+    LoadIV(sb0, sb1);
+    for (int i = 0; i < 4; i++) {
+        ma[i] = BSwap(_mm_loadu_si128((const __m128i*)(in + 16 * i)));
+        mb[i] = BSwap(_mm_loadu_si128((const __m128i*)(in + 64 + 16 * i)));
+    }
+    Compress(sa0, sa1, ma);
+    Compress(sb0, sb1, mb);
+
+    // Padding block of a 64-byte message
+    ma[0] = mb[0] = _mm_set_epi32(0, 0, 0, 0x80000000);
+    ma[1] = mb[1] = ma[2] = mb[2] = _mm_setzero_si128();
+    ma[3] = mb[3] = _mm_set_epi32(0x200, 0, 0, 0);
+    Compress(sa0, sa1, ma);
+    Compress(sb0, sb1, mb);
+
+    Pack(sa0, sa1);
+    Pack(sb0, sb1);
+    if (fDouble) {
+        // Second hash over the 32-byte digest, padded into a single block
+        ma[0] = sa0; ma[1] = sa1;
+        mb[0] = sb0; mb[1] = sb1;
+        ma[2] = mb[2] = _mm_set_epi32(0, 0, 0, 0x80000000);
+        ma[3] = mb[3] = _mm_set_epi32(0x100, 0, 0, 0);
+        LoadIV(sa0, sa1);
+        LoadIV(sb0, sb1);
+        Compress(sa0, sa1, ma);
+        Compress(sb0, sb1, mb);
+        Pack(sa0, sa1);
+        Pack(sb0, sb1);
+    }
+
+    _mm_storeu_si128((__m128i*)out, BSwap(sa0));
+    _mm_storeu_si128((__m128i*)(out + 16), BSwap(sa1));
+    _mm_storeu_si128((__m128i*)(out + 32), BSwap(sb0));
+    _mm_storeu_si128((__m128i*)(out + 48), BSwap(sb1));
+}
+
+} // namespace
+
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    __m128i s0 = _mm_loadu_si128((const __m128i*)s);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)(s + 4));
+    Unpack(s0, s1);
+    while (blocks--) {
+        __m128i m[4];
+        for (int i = 0; i < 4; i++) {
+            m[i] = BSwap(_mm_loadu_si128((const __m128i*)(chunk + 16 * i)));
+        }
+        Compress(s0, s1, m);
+        chunk += 64;
+    }
+    Pack(s0, s1);
+    _mm_storeu_si128((__m128i*)s, s0);
+    _mm_storeu_si128((__m128i*)(s + 4), s1);
+}
+
+void TransformD64_2way(unsigned char* out, const unsigned char* in)
+{
+    Hash64_2way(out, in, true);
+}
+
+void TransformS64_2way(unsigned char* out, const unsigned char* in)
+{
+    Hash64_2way(out, in, false);
+}
+
+} // namespace sha256_shani
+
+#endif
@@ -185,6 +185,12 @@ public:
         return true;
     }
 
+    CDataStream GetValue()
+    {
+        leveldb::Slice slValue = piter->value();
+        return CDataStream(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+    }
+
     unsigned int GetValueSize()
     {
         return piter->value().size();
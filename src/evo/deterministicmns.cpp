@@ -8,6 +8,7 @@
 #include "chainparams.h"
 #include "consensus/upgrades.h"
 #include "core_io.h"
+#include "crypto/sha256.h"
 #include "evo/specialtx.h"
 #include "key_io.h"
 #include "guiinterface.h"
@@ -20,6 +21,8 @@
 
 #include <univalue.h>
 
+#include <algorithm>
+
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
 
@@ -247,27 +250,35 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 
 std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> CDeterministicMNList::CalculateScores(const uint256& modifier) const
 {
-    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
-    scores.reserve(GetAllMNsCount());
+    std::vector<CDeterministicMNCPtr> dmns;
+    dmns.reserve(GetAllMNsCount());
     ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
         if (dmn->pdmnState->confirmedHash.IsNull()) {
             // we only take confirmed MNs into account to avoid hash grinding on the ProRegTxHash to sneak MNs into a
             // future quorums
             return;
         }
-        // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
-        // Please note that this is not a double-sha256 but a single-sha256
-        // The first part is already precalculated (confirmedHashWithProRegTxHash)
-        // TODO When https://github.com/bitcoin/bitcoin/pull/13191 gets backported, implement something that is similar but for single-sha256
-        uint256 h;
-        CSHA256 sha256;
-        sha256.Write(dmn->pdmnState->confirmedHashWithProRegTxHash.begin(), dmn->pdmnState->confirmedHashWithProRegTxHash.size());
-        sha256.Write(modifier.begin(), modifier.size());
-        sha256.Finalize(h.begin());
-
-        scores.emplace_back(UintToArith256(h), dmn);
+        dmns.emplace_back(dmn);
     });
 
+    // calculate sha256(sha256(proTxHash, confirmedHash), modifier) per MN
+    // Please note that this is not a double-sha256 but a single-sha256
+    // The first part is already precalculated (confirmedHashWithProRegTxHash)
+    // All the 64-byte messages are hashed in one batch, so that multi-way SHA256 implementations can be used.
+    std::vector<uint256> buf(dmns.size() * 2);
+    for (size_t i = 0; i < dmns.size(); i++) {
+        buf[2 * i] = dmns[i]->pdmnState->confirmedHashWithProRegTxHash;
+        buf[2 * i + 1] = modifier;
+    }
+    if (!dmns.empty()) {
+        SHA256S64(buf[0].begin(), buf[0].begin(), dmns.size());
+    }
+
+    std::vector<std::pair<arith_uint256, CDeterministicMNCPtr>> scores;
+    scores.reserve(dmns.size());
+    for (size_t i = 0; i < dmns.size(); i++) {
+        scores.emplace_back(UintToArith256(buf[i]), std::move(dmns[i]));
+    }
     return scores;
 }
 
@@ -506,9 +517,10 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
         diff = oldList.BuildDiff(newList);
 
         evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
+        // the list of the new tip, for the next block
+        CacheList(newList);
         if ((nHeight % DISK_SNAPSHOT_PERIOD) == 0 || oldList.GetHeight() == -1) {
             evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
-            mnListsCache.emplace(newList.GetBlockHash(), newList);
             LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
                 __func__, nHeight, newList.GetAllMNsCount());
         }
@@ -832,17 +844,20 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 
     CDeterministicMNList snapshot;
     std::list<const CBlockIndex*> listDiffIndexes;
+    bool fCached = false;
 
     while (true) {
         // try using cache before reading from disk
         auto itLists = mnListsCache.find(pindex->GetBlockHash());
         if (itLists != mnListsCache.end()) {
-            snapshot = itLists->second;
+            snapshot = itLists->second.list;
+            itLists->second.nLastUse = ++nListsCacheClock;
+            fCached = true;
             break;
         }
 
         if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            CacheList(snapshot);
             break;
         }
 
@@ -864,7 +879,7 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
                 throw std::runtime_error(err);
             }
             snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            CacheList(snapshot);
             break;
         }
 
@@ -874,6 +889,13 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
         pindex = pindex->pprev;
     }
 
+    if (fCached && listDiffIndexes.empty()) {
+        nListsCacheHits++;
+    } else {
+        nListsCacheMisses++;
+    }
+
+    const int nTipHeight = tipIndex ? tipIndex->nHeight : listDiffIndexes.empty() ? pindex->nHeight : listDiffIndexes.back()->nHeight;
     for (const auto& diffIndex : listDiffIndexes) {
         const auto& diff = mnListDiffsCache.at(diffIndex->GetBlockHash());
         if (diff.HasChanges()) {
@@ -882,16 +904,21 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             snapshot.SetBlockHash(diffIndex->GetBlockHash());
             snapshot.SetHeight(diffIndex->nHeight);
         }
+        nListsCacheDiffsApplied++;
+        if (IsListCheckpoint(diffIndex->nHeight, nTipHeight)) {
+            CacheList(snapshot);
+        }
     }
 
     if (tipIndex) {
         // always keep a snapshot for the tip
         if (snapshot.GetBlockHash() == tipIndex->GetBlockHash()) {
-            mnListsCache.emplace(snapshot.GetBlockHash(), snapshot);
+            CacheList(snapshot);
         } else {
             // !TODO: keep snapshots for yet alive quorums
         }
     }
+    EvictLists(nTipHeight);
 
     return snapshot;
 }
@@ -905,6 +932,12 @@ CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
     return GetListForBlock(tipIndex);
 }
 
+CDeterministicMNManager::ListsCacheStats CDeterministicMNManager::GetListsCacheStats() const
+{
+    LOCK(cs);
+    return {mnListsCache.size(), nListsCacheHits, nListsCacheMisses, nListsCacheDiffsApplied};
+}
+
 bool CDeterministicMNManager::IsDIP3Enforced(int nHeight) const
 {
     return Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_VNEXT);
@@ -934,7 +967,9 @@ void CDeterministicMNManager::CleanupCache(int nHeight)
     std::vector<uint256> toDeleteLists;
     std::vector<uint256> toDeleteDiffs;
     for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LIST_DIFFS_CACHE_SIZE < nHeight) {
+        // keep the tip, the recent disk snapshots and the checkpoints
+        const int nListHeight = p.second.list.GetHeight();
+        if (!IsProtectedList(nListHeight, nHeight) && !IsListCheckpoint(nListHeight, nHeight)) {
             toDeleteLists.emplace_back(p.first);
             continue;
         }
@@ -943,6 +978,7 @@ void CDeterministicMNManager::CleanupCache(int nHeight)
     for (const auto& h : toDeleteLists) {
         mnListsCache.erase(h);
     }
+    EvictLists(nHeight);
     for (const auto& p : mnListDiffsCache) {
         if (p.second.nHeight + LIST_DIFFS_CACHE_SIZE < nHeight) {
             toDeleteDiffs.emplace_back(p.first);
@@ -952,3 +988,52 @@ void CDeterministicMNManager::CleanupCache(int nHeight)
         mnListDiffsCache.erase(h);
     }
 }
+
+bool CDeterministicMNManager::IsListCheckpoint(int nHeight, int nTipHeight)
+{
+    const int nDistance = nTipHeight - nHeight;
+    if (nHeight < 0 || nDistance < 0) {
+        return false;
+    }
+    // the stride doubles every LIST_CHECKPOINTS_PER_STRIDE strides, so there are O(log(distance)) checkpoints
+    int nStride = LIST_CHECKPOINT_MIN_STRIDE;
+    while (nDistance > nStride * LIST_CHECKPOINTS_PER_STRIDE) {
+        nStride *= 2;
+    }
+    return (nHeight % nStride) == 0;
+}
+
+void CDeterministicMNManager::CacheList(const CDeterministicMNList& list)
+{
+    AssertLockHeld(cs);
+
+    auto it = mnListsCache.emplace(list.GetBlockHash(), CachedList{list, 0}).first;
+    it->second.nLastUse = ++nListsCacheClock;
+}
+
+bool CDeterministicMNManager::IsProtectedList(int nHeight, int nTipHeight)
+{
+    const bool fDiskSnapshot = (nHeight % DISK_SNAPSHOT_PERIOD) == 0 && nHeight + LIST_DIFFS_CACHE_SIZE >= nTipHeight;
+    return nHeight == nTipHeight || fDiskSnapshot;
+}
+
+void CDeterministicMNManager::EvictLists(int nTipHeight)
+{
+    AssertLockHeld(cs);
+
+    if (mnListsCache.size() <= MAX_LISTS_CACHE_SIZE) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint256>> vLastUses;
+    vLastUses.reserve(mnListsCache.size());
+    for (const auto& p : mnListsCache) {
+        if (!IsProtectedList(p.second.list.GetHeight(), nTipHeight)) {
+            vLastUses.emplace_back(p.second.nLastUse, p.first);
+        }
+    }
+    const size_t nToEvict = std::min(vLastUses.size(), mnListsCache.size() - MAX_LISTS_CACHE_SIZE);
+    std::partial_sort(vLastUses.begin(), vLastUses.begin() + nToEvict, vLastUses.end());
+    for (size_t i = 0; i < nToEvict; i++) {
+        mnListsCache.erase(vLastUses[i].second);
+    }
+}
@@ -554,15 +554,40 @@ class CDeterministicMNManager
     static const int LIST_DIFFS_CACHE_SIZE = DISK_SNAPSHOT_PERIOD * DISK_SNAPSHOTS;
 
 public:
+    // the lists built from diffs are kept as checkpoints at heights getting sparser with the distance
+    // from the tip (see IsListCheckpoint), so that a historical list is only a few diffs away from one
+    static const int LIST_CHECKPOINT_MIN_STRIDE = 16;
+    static const int LIST_CHECKPOINTS_PER_STRIDE = 4;
+    static const size_t MAX_LISTS_CACHE_SIZE = 128; // the least recently used lists are evicted above this
+
+    struct ListsCacheStats {
+        size_t nLists;
+        //! Number of GetListForBlock calls for a cached list, and for a list built from a snapshot and diffs
+        uint64_t nHits;
+        uint64_t nMisses;
+        uint64_t nDiffsApplied;
+    };
+
     mutable RecursiveMutex cs;
 
 private:
     CEvoDB& evoDb;
 
-    std::unordered_map<uint256, CDeterministicMNList, StaticSaltedHasher> mnListsCache;
+    struct CachedList {
+        CDeterministicMNList list;
+        // value of nListsCacheClock when the list was last used
+        uint64_t nLastUse;
+    };
+    // the lists share their unchanged parts (immer maps), so each entry only costs what it changed
+    std::unordered_map<uint256, CachedList, StaticSaltedHasher> mnListsCache;
     std::unordered_map<uint256, CDeterministicMNListDiff, StaticSaltedHasher> mnListDiffsCache;
     const CBlockIndex* tipIndex{nullptr};
 
+    uint64_t nListsCacheClock{0};
+    uint64_t nListsCacheHits{0};
+    uint64_t nListsCacheMisses{0};
+    uint64_t nListsCacheDiffsApplied{0};
+
 public:
     explicit CDeterministicMNManager(CEvoDB& _evoDb);
 
@@ -579,6 +604,8 @@ public:
     CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
     CDeterministicMNList GetListAtChainTip();
 
+    ListsCacheStats GetListsCacheStats() const;
+
     // Whether DMNs are enforced at provided height, or at the chain-tip
     bool IsDIP3Enforced(int nHeight) const;
     bool IsDIP3Enforced() const;
@@ -589,6 +616,15 @@ public:
 
 private:
     void CleanupCache(int nHeight);
+
+    // Whether the list at nHeight is kept as a checkpoint while the tip is at nTipHeight
+    static bool IsListCheckpoint(int nHeight, int nTipHeight);
+    // Add the list to the cache, or mark it as just used
+    void CacheList(const CDeterministicMNList& list);
+    // Whether the list at nHeight is the tip one or a recent disk snapshot, which are never evicted
+    static bool IsProtectedList(int nHeight, int nTipHeight);
+    // Evict the least recently used lists above MAX_LISTS_CACHE_SIZE, except the protected ones
+    void EvictLists(int nTipHeight);
 };
 
 extern std::unique_ptr<CDeterministicMNManager> deterministicMNManager;
@@ -54,8 +54,16 @@ static bool CheckHashSig(const Payload& pl, const CKeyID& keyID, CValidationStat
 }
 
 template <typename Payload>
-static bool CheckHashSig(const Payload& pl, const CBLSPublicKey& pubKey, CValidationState& state)
+static bool CheckHashSig(const CTransaction& tx, const Payload& pl, const CBLSPublicKey& pubKey, CSpecialTxSigBatch* sigBatch, CValidationState& state)
 {
+    if (sigBatch) {
+        // The batch aggregates the signatures, which must be valid points
+        if (!pl.sig.IsValid() || !pubKey.IsValid()) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
+        }
+        sigBatch->Add(tx.GetHash(), pl.sig, pubKey, ::SerializeHash(pl));
+        return true;
+    }
     if (!pl.sig.VerifyInsecure(pubKey, ::SerializeHash(pl))) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
     }
@@ -270,7 +278,7 @@ void ProRegPL::ToJson(UniValue& obj) const
 
 // Provider Update Service Payload
 
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch)
 {
     assert(tx.nType == CTransaction::TxType::PROUPSERV);
 
@@ -317,7 +325,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
         }
 
         // we can only check the signature if pindexPrev != nullptr and the MN is known
-        if (!CheckHashSig(pl, mn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(tx, pl, mn->pdmnState->pubKeyOperator.Get(), sigBatch, state)) {
             // pass the state returned by the function above
             return false;
         }
@@ -470,7 +478,7 @@ void ProUpRegPL::ToJson(UniValue& obj) const
 
 // Provider Update Revoke Payload
 
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch)
 {
     assert(tx.nType == CTransaction::TxType::PROUPREV);
 
@@ -500,7 +508,7 @@ bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
         if (!dmn)
             return state.DoS(100, false, REJECT_INVALID, "bad-protx-hash");
 
-        if (!CheckHashSig(pl, dmn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(tx, pl, dmn->pdmnState->pubKeyOperator.Get(), sigBatch, state)) {
             // pass the state returned by the function above
             return false;
         }
@@ -15,6 +15,7 @@
 #include <univalue.h>
 
 class CBlockIndex;
+class CSpecialTxSigBatch;
 
 // Provider-Register tx payload
 
@@ -163,9 +164,10 @@ public:
 };
 
 bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// The operator signatures of ProUpServ and ProUpRev are added to sigBatch, if not null, instead of being verified
+bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch = nullptr);
 bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch = nullptr);
 
 // If tx is a ProRegTx, return the collateral outpoint in outRet.
 bool GetProRegCollateral(const CTransactionRef& tx, COutPoint& outRet);
@@ -5,6 +5,7 @@
 
 #include "evo/specialtx.h"
 
+#include "bls/bls_worker.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "clientversion.h"
@@ -91,7 +92,35 @@ bool CheckSpecialTxNoContext(const CTransaction& tx, CValidationState& state)
                      REJECT_INVALID, "bad-tx-type");
 }
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+CSpecialTxSigBatch::CSpecialTxSigBatch(CBLSWorker& _worker) :
+    worker(_worker),
+    fCancelled(std::make_shared<std::atomic<bool>>(false))
+{
+}
+
+CSpecialTxSigBatch::~CSpecialTxSigBatch()
+{
+    *fCancelled = true;
+}
+
+void CSpecialTxSigBatch::Add(const uint256& txHash, const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash)
+{
+    std::shared_ptr<std::atomic<bool>> cancelled = fCancelled;
+    vResults.emplace_back(txHash, worker.AsyncVerifySig(sig, pubKey, msgHash, [cancelled] { return cancelled->load(); }));
+}
+
+bool CSpecialTxSigBatch::Verify(CValidationState& state)
+{
+    for (auto& p : vResults) {
+        if (!p.second.get()) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strprintf("tx %s", p.first.ToString()));
+        }
+    }
+    vResults.clear();
+    return true;
+}
+
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch)
 {
     // This function is not called when connecting the genesis block
     assert(pindexPrev != nullptr);
@@ -119,7 +148,7 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
         }
         case CTransaction::TxType::PROUPSERV: {
             // provider-update-service
-            return CheckProUpServTx(tx, pindexPrev, state);
+            return CheckProUpServTx(tx, pindexPrev, state, sigBatch);
         }
         case CTransaction::TxType::PROUPREG: {
             // provider-update-registrar
@@ -127,7 +156,7 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
         }
         case CTransaction::TxType::PROUPREV: {
             // provider-update-revoke
-            return CheckProUpRevTx(tx, pindexPrev, state);
+            return CheckProUpRevTx(tx, pindexPrev, state, sigBatch);
         }
     }
 
@@ -137,13 +166,19 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
 
 bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck)
 {
-    // check special txes
+    // check special txes, verifying the operator signatures together on the BLS worker
+    std::unique_ptr<CSpecialTxSigBatch> sigBatch;
+    if (g_bls_worker) sigBatch.reset(new CSpecialTxSigBatch(*g_bls_worker));
     for (const CTransactionRef& tx: block.vtx) {
-        if (!CheckSpecialTx(*tx, pindex->pprev, state)) {
+        if (!CheckSpecialTx(*tx, pindex->pprev, state, sigBatch.get())) {
             // pass the state returned by the function above
             return false;
         }
     }
+    if (sigBatch && !sigBatch->Verify(state)) {
+        // pass the state returned by the function above
+        return false;
+    }
 
     if (!deterministicMNManager->ProcessBlock(block, pindex, state, fJustCheck)) {
         // pass the state returned by the function above
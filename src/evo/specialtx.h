@@ -7,21 +7,52 @@
 #define OASIS_SPECIALTX_H
 
 #include "streams.h"
+#include "uint256.h"
 #include "version.h"
 #include "primitives/transaction.h"
 
+#include <atomic>
+#include <future>
+#include <memory>
+
+class CBLSPublicKey;
+class CBLSSignature;
+class CBLSWorker;
 class CBlock;
 class CBlockIndex;
 class CValidationState;
-class uint256;
 
 /** The maximum allowed size of the extraPayload (for any TxType) */
 static const unsigned int MAX_SPECIALTX_EXTRAPAYLOAD = 10000;
 
+/**
+ * The BLS signatures of the special txes of a block, handed to a CBLSWorker as they
+ * are found, so that they are verified in aggregated batches on its pool while the
+ * other checks go on. The worker verifies the signatures of a failed batch one by one.
+ */
+class CSpecialTxSigBatch
+{
+private:
+    CBLSWorker& worker;
+    //! Set on destruction, so that the signatures not verified yet are skipped
+    std::shared_ptr<std::atomic<bool>> fCancelled;
+    std::vector<std::pair<uint256, std::future<bool>>> vResults;
+
+public:
+    explicit CSpecialTxSigBatch(CBLSWorker& _worker);
+    ~CSpecialTxSigBatch();
+
+    void Add(const uint256& txHash, const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash);
+
+    //! Wait for the verification of the signatures added, false (with the state set) if one is invalid
+    bool Verify(CValidationState& state);
+};
+
 /** Payload validity checks (including duplicate unique properties against list at pindexPrev)*/
 // Note: for +v2, if the tx is not a special tx, this method returns true.
 // Note2: This function only performs extra payload related checks, it does NOT checks regular inputs and outputs.
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// The BLS signatures are added to sigBatch, if not null, instead of being verified.
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigBatch* sigBatch = nullptr);
 
 // Basic non-contextual checks for special txes
 // Note: for +v2, if the tx is not a special tx, this method returns true.
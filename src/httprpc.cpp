@@ -61,6 +61,34 @@ static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static std::unique_ptr<HTTPRPCTimerInterface> httpRPCTimerInterface;
 
+HTTPJSONWriter::HTTPJSONWriter(HTTPRequest* reqIn) :
+    JSONStreamWriter([reqIn, fStarted = false](std::string&& strChunk, bool fWait) mutable {
+        if (!fStarted) {
+            reqIn->WriteHeader("Content-Type", "application/json");
+            reqIn->StartChunkedReply(HTTP_OK);
+            fStarted = true;
+        }
+        if (!reqIn->WriteReplyChunk(std::move(strChunk)) || (fWait && !reqIn->WaitReplyChunks())) {
+            throw std::runtime_error("Client disconnected");
+        }
+    }),
+    req(reqIn)
+{
+}
+
+void HTTPJSONWriter::Finish()
+{
+    strBuffer += '\n';
+    if (!HasSentOutput()) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strBuffer);
+    } else {
+        req->WriteReplyChunk(std::move(strBuffer));
+        req->EndChunkedReply();
+    }
+    strBuffer.clear();
+}
+
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
     // Send error reply from json-rpc error object
@@ -166,6 +194,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    HTTPJSONWriter replyWriter(req);
     try {
         // Parse request
         UniValue valRequest;
@@ -179,9 +208,16 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
+            // Let the handlers supporting it stream the reply (see WriteRPCResult)
+            jreq.replyWriter = &replyWriter;
 
             UniValue result = tableRPC.execute(jreq);
 
+            if (!replyWriter.IsEmpty()) {
+                replyWriter.Finish();
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -194,6 +230,12 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (replyWriter.HasSentOutput()) {
+            // Too late for an error reply
+            LogPrintf("%s: %s reply interrupted: %s\n", __func__, SanitizeString(jreq.strMethod), objError.write());
+            replyWriter.Finish();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
@@ -5,11 +5,33 @@
 #ifndef BITCOIN_HTTPRPC_H
 #define BITCOIN_HTTPRPC_H
 
+#include "rpc/jsonwriter.h"
+
 #include <string>
 #include <map>
 
 class HTTPRequest;
 
+/**
+ * JSONWriter streaming a JSON reply to a HTTP request. The reply is sent as a
+ * chunked reply once the output exceeds a chunk, as a single reply otherwise.
+ * Throws (in Flush or when a chunk is sent) once the client is disconnected.
+ */
+class HTTPJSONWriter : public JSONStreamWriter
+{
+private:
+    HTTPRequest* req;
+
+public:
+    explicit HTTPJSONWriter(HTTPRequest* reqIn);
+
+    /**
+     * Send the rest of the reply. If the output was already being sent, this is
+     * also how a reply interrupted by an error is closed (truncated).
+     */
+    void Finish() override;
+};
+
 /** Start HTTP RPC subsystem.
  * Precondition; HTTP and RPC has been started.
  */
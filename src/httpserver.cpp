@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <condition_variable>
 #include <future>
 
 #include <event2/thread.h>
@@ -40,6 +41,22 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** State of a chunked reply, shared by the worker writing it and the main http thread */
+struct HTTPChunkedReply
+{
+    Mutex cs;
+    std::condition_variable cond;
+    //! Bytes of the chunks not written to the connection yet
+    size_t nPending GUARDED_BY(cs){0};
+    //! Whether the connection was closed (the request is detached from it then)
+    bool fClosed GUARDED_BY(cs){false};
+    //! Bytes of the chunks handed to evhttp since the output of the connection was last drained (main http thread only)
+    size_t nHandedOver{0};
+    struct evhttp_request* req;
+
+    explicit HTTPChunkedReply(struct evhttp_request* reqIn) : req(reqIn) {}
+};
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -213,19 +230,34 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
-/** HTTP request callback */
-static void http_request_cb(struct evhttp_request* req, void* arg)
+/** Enable or disable reading from a connection */
+static void http_set_reading(evhttp_connection* conn, bool fEnable)
 {
-    // Disable reading to work around a libevent bug, fixed in 2.2.0.
-    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-        evhttp_connection* conn = evhttp_request_get_connection(req);
-        if (conn) {
-            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-            if (bev) {
+    if (conn) {
+        bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+        if (bev) {
+            if (fEnable) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            } else {
                 bufferevent_disable(bev, EV_READ);
             }
         }
     }
+}
+
+/** Whether reading from the connection is disabled while a request is handled */
+static bool http_reading_disabled()
+{
+    return event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001;
+}
+
+/** HTTP request callback */
+static void http_request_cb(struct evhttp_request* req, void* arg)
+{
+    // Disable reading to work around a libevent bug, fixed in 2.2.0.
+    if (http_reading_disabled()) {
+        http_set_reading(evhttp_request_get_connection(req), false);
+    }
     std::unique_ptr<HTTPRequest> hreq(new HTTPRequest(req));
 
     LogPrint(BCLog::HTTP, "Received a %s request for %s from %s\n",
@@ -531,7 +563,11 @@ HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && chunkedReply) {
+        // Complete the chunked reply, even if truncated, to free the request
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -594,19 +630,111 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
         // Re-enable reading from the socket. This is the second part of the libevent
         // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+        if (http_reading_disabled()) {
+            http_set_reading(evhttp_request_get_connection(req_copy), true);
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+/** Called when the connection of a chunked reply is closed */
+static void http_chunked_reply_closed(struct evhttp_connection* conn, void* arg)
+{
+    HTTPChunkedReply* reply = static_cast<HTTPChunkedReply*>(arg);
+    LOCK(reply->cs);
+    reply->fClosed = true;
+    reply->cond.notify_all();
+}
+
+/** Called when the chunks handed to evhttp are written to the connection */
+static void http_chunked_reply_written(struct evhttp_connection* conn, void* arg)
+{
+    HTTPChunkedReply* reply = static_cast<HTTPChunkedReply*>(arg);
+    LOCK(reply->cs);
+    reply->nPending -= reply->nHandedOver;
+    reply->nHandedOver = 0;
+    reply->cond.notify_all();
+}
+
+/* Like WriteReply, the calls to evhttp happen in the main http thread. The
+ * shared HTTPChunkedReply outlives the connection callbacks, which are unset
+ * by EndChunkedReply (or not called anymore once the connection is closed).
+ */
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && req && !chunkedReply);
+    chunkedReply = std::make_shared<HTTPChunkedReply>(req);
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply, nStatus]{
+        evhttp_send_reply_start(reply->req, nStatus, nullptr);
+        evhttp_connection* conn = evhttp_request_get_connection(reply->req);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, http_chunked_reply_closed, reply.get());
+        } else {
+            http_chunked_reply_closed(nullptr, reply.get());
+        }
+    });
+    ev->trigger(nullptr);
+}
+
+bool HTTPRequest::WriteReplyChunk(std::string&& strChunk)
+{
+    assert(!replySent && chunkedReply);
+    if (strChunk.empty()) {
+        return WITH_LOCK(chunkedReply->cs, return !chunkedReply->fClosed; );
+    }
+    {
+        LOCK(chunkedReply->cs);
+        if (chunkedReply->fClosed) return false;
+        chunkedReply->nPending += strChunk.size();
+    }
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply, strChunk = std::move(strChunk)]{
+        if (WITH_LOCK(reply->cs, return reply->fClosed; )) return;
+        struct evbuffer* evb = evbuffer_new();
+        evbuffer_add(evb, strChunk.data(), strChunk.size());
+        reply->nHandedOver += strChunk.size();
+        evhttp_send_reply_chunk_with_cb(reply->req, evb, http_chunked_reply_written, reply.get());
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+bool HTTPRequest::WaitReplyChunks(size_t nMaxPending)
+{
+    assert(!replySent && chunkedReply);
+    WAIT_LOCK(chunkedReply->cs, lock);
+    // A stalled client is disconnected by the timeout of the connection (-rpcservertimeout)
+    chunkedReply->cond.wait(lock, [&]() EXCLUSIVE_LOCKS_REQUIRED(chunkedReply->cs) {
+        return chunkedReply->fClosed || chunkedReply->nPending <= nMaxPending;
+    });
+    return !chunkedReply->fClosed;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && chunkedReply);
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [reply]{
+        const bool fClosed = WITH_LOCK(reply->cs, return reply->fClosed; );
+        evhttp_connection* conn = fClosed ? nullptr : evhttp_request_get_connection(reply->req);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        }
+        // This replaces the write callback of the connection. If the connection was
+        // closed, this frees the request, which was detached from it.
+        evhttp_send_reply_end(reply->req);
+        if (conn && http_reading_disabled()) {
+            http_set_reading(conn, true);
         }
     });
     ev->trigger(nullptr);
     replySent = true;
     req = 0; // transferred back to main thread
+    chunkedReply.reset();
 }
 
 CService HTTPRequest::GetPeer()
@@ -9,15 +9,19 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Bytes of a chunked reply waiting to be written to the connection, past which the writer waits */
+static const size_t MAX_HTTP_REPLY_PENDING = 1024 * 1024;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPChunkedReply;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -60,6 +64,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! The state of the chunked reply, once started
+    std::shared_ptr<HTTPChunkedReply> chunkedReply;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -115,6 +121,34 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked reply (Transfer-Encoding: chunked), for the replies too large
+     * to be built in memory. The body is sent with WriteReplyChunk, and the reply
+     * is completed with EndChunkedReply.
+     *
+     * @note Call this instead of WriteReply, after WriteHeader.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Send a chunk of the body of a chunked reply.
+     * Returns false if the connection was closed.
+     */
+    bool WriteReplyChunk(std::string&& strChunk);
+
+    /**
+     * Wait until at most nMaxPending bytes of the chunks sent are waiting to be
+     * written to the connection. Returns false if the connection was closed.
+     */
+    bool WaitReplyChunks(size_t nMaxPending = MAX_HTTP_REPLY_PENDING);
+
+    /**
+     * Complete a chunked reply.
+     *
+     * @note Like WriteReply, do not call any other HTTPRequest methods after calling this.
+     */
+    void EndChunkedReply();
 };
 
 /** Event handler closure.
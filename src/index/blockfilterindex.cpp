@@ -0,0 +1,168 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "index/blockfilterindex.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "shutdown.h"
+#include "undo.h"
+#include "util/system.h"
+#include "validation.h"
+
+/* The index database stores two items:
+ *
+ * key = 'B' (the best block)
+ * value = CBlockLocator (locator of the best block indexed)
+ *
+ * key = 'f' + block hash
+ * value = BlockFilter (the filter of the block)
+ */
+static const char DB_BEST_BLOCK = 'B';
+static const char DB_BLOCK_FILTER = 'f';
+
+//! Seconds between the progress logs and the best block writes of the sync thread
+static const int64_t SYNC_LOG_INTERVAL = 30;
+static const int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30;
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+BlockFilterIndex::BlockFilterIndex(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_db(new CDBWrapper(GetDataDir() / "blocks" / "filter", n_cache_size, f_memory, f_wipe))
+{
+}
+
+BlockFilterIndex::~BlockFilterIndex()
+{
+    Stop();
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo block_undo;
+    if (pindex->pprev) {
+        const FlatFilePos pos = WITH_LOCK(cs_main, return pindex->GetUndoPos(); );
+        if (pos.IsNull() || !UndoReadFromDisk(block_undo, pos, pindex->pprev->GetBlockHash())) {
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+    const BlockFilter filter(block, block_undo);
+    return m_db->Write(std::make_pair(DB_BLOCK_FILTER, pindex->GetBlockHash()), filter);
+}
+
+void BlockFilterIndex::WriteBestBlock(const CBlockLocator& locator)
+{
+    if (!m_db->Write(DB_BEST_BLOCK, locator)) {
+        error("%s: Failed to write locator to disk", __func__);
+    }
+}
+
+void BlockFilterIndex::ThreadSync()
+{
+    const CBlockIndex* pindex = nullptr;
+    {
+        CBlockLocator locator;
+        if (m_db->Read(DB_BEST_BLOCK, locator)) {
+            LOCK(cs_main);
+            pindex = FindForkInGlobalIndex(chainActive, locator);
+        }
+    }
+
+    int64_t last_log_time = 0;
+    int64_t last_locator_write_time = 0;
+    while (true) {
+        if (m_interrupt) {
+            if (pindex) WriteBestBlock(WITH_LOCK(cs_main, return chainActive.GetLocator(pindex); ));
+            return;
+        }
+
+        {
+            LOCK(cs_main);
+            if (pindex && !chainActive.Contains(pindex)) {
+                // Reorged out: continue from the fork
+                pindex = chainActive.FindFork(pindex);
+            }
+            const CBlockIndex* pindex_next = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+            if (!pindex_next) {
+                // The next blocks are notified by BlockConnected
+                m_synced = true;
+                if (pindex) WriteBestBlock(chainActive.GetLocator(pindex));
+                break;
+            }
+            pindex = pindex_next;
+        }
+
+        int64_t current_time = GetTime();
+        if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
+            LogPrintf("Syncing block filter index with block chain from height %d\n", pindex->nHeight);
+            last_log_time = current_time;
+        }
+        if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+            WriteBestBlock(WITH_LOCK(cs_main, return chainActive.GetLocator(pindex->pprev); ));
+            last_locator_write_time = current_time;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex) || !WriteBlock(block, pindex)) {
+            LogPrintf("%s: Failed to index block %s, the block filter index is not synced\n",
+                      __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    LogPrintf("Block filter index is enabled at height %d\n", pindex ? pindex->nHeight : -1);
+}
+
+void BlockFilterIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex)
+{
+    if (!m_synced) {
+        return;
+    }
+    if (!WriteBlock(*block, pindex)) {
+        LogPrintf("%s: Failed to index block %s\n", __func__, pindex->GetBlockHash().ToString());
+    }
+}
+
+void BlockFilterIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block, const uint256& blockHash, int nBlockHeight, int64_t blockTime)
+{
+    if (!m_synced) {
+        return;
+    }
+    // Nothing reads the filters of the blocks out of the active chain
+    if (!m_db->Erase(std::make_pair(DB_BLOCK_FILTER, blockHash))) {
+        LogPrintf("%s: Failed to erase the filter of block %s\n", __func__, blockHash.ToString());
+    }
+}
+
+void BlockFilterIndex::SetBestChain(const CBlockLocator& locator)
+{
+    if (!m_synced) {
+        return;
+    }
+    WriteBestBlock(locator);
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter_out) const
+{
+    return m_db->Read(std::make_pair(DB_BLOCK_FILTER, pindex->GetBlockHash()), filter_out);
+}
+
+void BlockFilterIndex::Start()
+{
+    // Need to register this ValidationInterface before running ThreadSync, so that
+    // callbacks are not missed if ThreadSync sets m_synced to true.
+    RegisterValidationInterface(this);
+    m_thread_sync = std::thread(&TraceThread<std::function<void()> >, "blkfilter",
+                                std::function<void()>(std::bind(&BlockFilterIndex::ThreadSync, this)));
+}
+
+void BlockFilterIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+    m_interrupt();
+    if (m_thread_sync.joinable()) {
+        m_thread_sync.join();
+    }
+}
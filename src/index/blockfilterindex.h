@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_INDEX_BLOCKFILTERINDEX_H
+#define OASIS_INDEX_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "dbwrapper.h"
+#include "threadinterrupt.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class CBlockIndex;
+
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+//! Max memory allocated to the block filter index DB specific cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 64;
+
+/**
+ * BlockFilterIndex is used to store and retrieve the block filters (see BlockFilter)
+ * of the blocks of the active chain. The filters are built by a background thread,
+ * from the blocks and undo data on disk, until the index reaches the tip. After that,
+ * the filters are built from the BlockConnected notifications.
+ * The filters are stored by block hash, so a reorg doesn't invalidate them, and the
+ * filters of the disconnected blocks are erased.
+ */
+class BlockFilterIndex : public CValidationInterface
+{
+private:
+    std::unique_ptr<CDBWrapper> m_db;
+
+    /// Whether the index is in sync with the main chain. The flag is flipped
+    /// from false to true once, after which point this starts processing
+    /// ValidationInterface notifications to stay in sync.
+    std::atomic<bool> m_synced{false};
+
+    std::thread m_thread_sync;
+    CThreadInterrupt m_interrupt;
+
+    /// Build the filter of the block and write it to the index.
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex);
+
+    /// Write the locator of the best block indexed.
+    void WriteBestBlock(const CBlockLocator& locator);
+
+    /// Sync the index with the block index starting from the current best
+    /// block. Intended to be run in its own thread, m_thread_sync, and can be
+    /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
+    /// flag is set and the BlockConnected ValidationInterface callback takes
+    /// over and the sync thread exits.
+    void ThreadSync();
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex) override;
+
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block, const uint256& blockHash, int nBlockHeight, int64_t blockTime) override;
+
+    void SetBestChain(const CBlockLocator& locator) override;
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit BlockFilterIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+    ~BlockFilterIndex();
+
+    /// Start initializes the sync state and registers the instance as a
+    /// ValidationInterface so that it stays in sync with blockchain updates.
+    void Start();
+
+    /// Stops the instance from staying in sync with blockchain updates.
+    void Stop();
+
+    /// Whether the filters of all the blocks of the active chain are indexed.
+    bool IsSynced() const { return m_synced; }
+
+    /// Get a single filter by block.
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter_out) const;
+};
+
+/// The global block filter index, used by the wallet rescans. May be null.
+extern std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+#endif // OASIS_INDEX_BLOCKFILTERINDEX_H
@@ -8,15 +8,20 @@
 
 #include "kernel.h"
 
+#include "crypto/common.h"
+#include "ctpl.h"
 #include "db.h"
 #include "legacy/stakemodifier.h"
 #include "policy/policy.h"
 #include "script/interpreter.h"
 #include "stakeinput.h"
 #include "util/system.h"
+#include "util/threadnames.h"
 #include "utilmoneystr.h"
 #include "validation.h"
 
+#include <future>
+
 /**
  * CStakeKernel Constructor
  *
@@ -54,13 +59,30 @@ uint256 CStakeKernel::GetHash() const
     return Hash(ss.begin(), ss.end());
 }
 
-// Check that the kernel hash meets the target required
-bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
+// Return a hasher fed with the part of the kernel message that doesn't depend on nTime
+CHash256 CStakeKernel::GetPrefixHasher() const
+{
+    CDataStream ss(stakeModifier);
+    ss << nTimeBlockFrom << stakeUniqueness;
+    CHash256 hasher;
+    hasher.Write((const unsigned char*)ss.data(), ss.size());
+    return hasher;
+}
+
+// Return the hash target, weighted by the stake value
+arith_uint256 CStakeKernel::GetTarget() const
 {
-    // Get weighted target
     arith_uint256 bnTarget;
     bnTarget.SetCompact(nBits);
     bnTarget *= (arith_uint256(stakeValue) / 100);
+    return bnTarget;
+}
+
+// Check that the kernel hash meets the target required
+bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
+{
+    // Get weighted target
+    const arith_uint256& bnTarget = GetTarget();
 
     // Check PoS kernel hash
     const arith_uint256& hashProofOfStake = UintToArith256(GetHash());
@@ -83,6 +105,94 @@ bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
 }
 
 
+/*
+ * CStakeKernelSearch
+ */
+
+CStakeKernelSearch::CStakeKernelSearch(int nThreadsIn) : nThreads(nThreadsIn) {}
+
+CStakeKernelSearch::~CStakeKernelSearch()
+{
+    if (workerPool) {
+        workerPool->stop(true);
+    }
+}
+
+void CStakeKernelSearch::Reset(const CBlockIndex* pindexPrevIn, unsigned int nBitsIn, uint64_t nInputsIdIn)
+{
+    vCandidates.clear();
+    pindexPrev = pindexPrevIn;
+    nBits = nBitsIn;
+    nInputsId = nInputsIdIn;
+}
+
+void CStakeKernelSearch::AddInput(CStakeInput* stakeInput)
+{
+    // nTimeTx is not part of the prefix
+    CStakeKernel stakeKernel(pindexPrev, stakeInput, nBits, 0);
+    vCandidates.push_back({stakeKernel.GetPrefixHasher(), stakeKernel.GetTarget()});
+}
+
+void CStakeKernelSearch::EraseInputs(const std::vector<bool>& vErase, uint64_t nInputsIdIn)
+{
+    assert(vErase.size() == vCandidates.size());
+    size_t j = 0;
+    for (size_t i = 0; i < vCandidates.size(); i++) {
+        if (!vErase[i]) vCandidates[j++] = vCandidates[i];
+    }
+    vCandidates.resize(j);
+    nInputsId = nInputsIdIn;
+}
+
+bool CStakeKernelSearch::IsCachedFor(const CBlockIndex* pindexPrevIn, unsigned int nBitsIn, uint64_t nInputsIdIn) const
+{
+    return pindexPrev == pindexPrevIn && nBits == nBitsIn && nInputsId == nInputsIdIn;
+}
+
+CStakeKernelSearch::Hits CStakeKernelSearch::Search(int nTimeTx)
+{
+    // nTimeTx serialized as in CStakeKernel::GetHash
+    unsigned char timeTx[4];
+    WriteLE32(timeTx, (uint32_t)nTimeTx);
+
+    auto searchRange = [this, &timeTx](size_t begin, size_t end) {
+        Hits hits;
+        uint256 hash;
+        for (size_t i = begin; i < end; i++) {
+            CHash256 hasher(vCandidates[i].hasher);
+            hasher.Write(timeTx, sizeof(timeTx)).Finalize(hash.begin());
+            if (UintToArith256(hash) < vCandidates[i].bnTarget) hits.emplace_back(i);
+        }
+        return hits;
+    };
+
+    const size_t nInputs = vCandidates.size();
+    if (nThreads <= 1 || nInputs < MIN_PARALLEL_INPUTS) {
+        return searchRange(0, nInputs);
+    }
+
+    if (!workerPool) {
+        workerPool.reset(new ctpl::thread_pool(nThreads));
+        RenameThreadPool(*workerPool, "oasis-stake");
+    }
+    const size_t nBatchSize = (nInputs + nThreads - 1) / nThreads;
+    std::vector<std::future<Hits>> futures;
+    for (size_t begin = 0; begin < nInputs; begin += nBatchSize) {
+        const size_t end = std::min(begin + nBatchSize, nInputs);
+        futures.emplace_back(workerPool->push([&searchRange, begin, end](int threadId) {
+            return searchRange(begin, end);
+        }));
+    }
+    // Batches are in ascending order, and so are the hits in each one
+    Hits hits;
+    for (auto& f : futures) {
+        const Hits& batchHits = f.get();
+        hits.insert(hits.end(), batchHits.begin(), batchHits.end());
+    }
+    return hits;
+}
+
+
 /*
  * PoS Validation
  */
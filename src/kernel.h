@@ -9,8 +9,16 @@
 #ifndef OASIS_KERNEL_H
 #define OASIS_KERNEL_H
 
+#include "arith_uint256.h"
+#include "hash.h"
 #include "stakeinput.h"
 
+#include <memory>
+
+namespace ctpl {
+class thread_pool;
+}
+
 class CStakeKernel {
 public:
     /**
@@ -26,6 +34,12 @@ public:
     // Return stake kernel hash
     uint256 GetHash() const;
 
+    // Return a hasher fed with the part of the kernel message that doesn't depend on nTime
+    CHash256 GetPrefixHasher() const;
+
+    // Return the hash target, weighted by the stake value
+    arith_uint256 GetTarget() const;
+
     // Check that the kernel hash meets the target required
     bool CheckKernelHash(bool fSkipLog = false) const;
 
@@ -40,6 +54,53 @@ private:
     CAmount stakeValue{0};     // target multiplier
 };
 
+/*
+ * CStakeKernelSearch   Kernel search over all the stakeable inputs of a wallet.
+ *
+ * The kernel message is (modifier, nTimeBlockFrom, uniqueness, nTimeTx): only the
+ * last field changes from one time slot to the next. The constant prefix of each
+ * input is hashed once per tip (AddInput) and each slot (Search) only hashes
+ * nTimeTx on top of the cached midstate, spreading the inputs over a thread pool.
+ */
+class CStakeKernelSearch
+{
+public:
+    // Result of a search: indexes of the inputs whose kernel meets the target (ascending)
+    typedef std::vector<size_t> Hits;
+
+    explicit CStakeKernelSearch(int nThreadsIn);
+    ~CStakeKernelSearch();
+
+    // Clear the cache, to stake on top of pindexPrev with nBits. nInputsId is a caller
+    // defined identifier of the list of inputs that is going to be added.
+    void Reset(const CBlockIndex* pindexPrev, unsigned int nBits, uint64_t nInputsId);
+    // Cache the kernel prefix of a stake input (inputs are indexed in order of addition)
+    void AddInput(CStakeInput* stakeInput);
+    // Drop the cached inputs flagged in vErase (e.g. spent), nInputsId identifies the new list
+    void EraseInputs(const std::vector<bool>& vErase, uint64_t nInputsId);
+    // Whether the cache holds the inputs nInputsId, for staking on top of pindexPrev with nBits
+    bool IsCachedFor(const CBlockIndex* pindexPrev, unsigned int nBits, uint64_t nInputsId) const;
+    size_t size() const { return vCandidates.size(); }
+
+    // Hash the kernels of all the cached inputs for nTimeTx
+    Hits Search(int nTimeTx);
+
+private:
+    struct Candidate {
+        CHash256 hasher;        // midstate after the constant prefix
+        arith_uint256 bnTarget; // weighted target
+    };
+    std::vector<Candidate> vCandidates;
+    const CBlockIndex* pindexPrev{nullptr};
+    unsigned int nBits{0};
+    uint64_t nInputsId{0};
+
+    // Below this number of inputs the search is done on the calling thread
+    static const size_t MIN_PARALLEL_INPUTS = 512;
+    int nThreads;
+    std::unique_ptr<ctpl::thread_pool> workerPool;
+};
+
 /* PoS Validation */
 
 /*
@@ -562,21 +562,70 @@ bool CMasternodePayments::IsScheduled(const CMasternode& mn, int nNotBlockHeight
 
 void CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
 {
-    {
-        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+    CTxDestination addr;
+    ExtractDestination(winnerIn.payee, addr);
+    LogPrint(BCLog::MASTERNODE, "mnw - Adding winner %s for block %d\n", EncodeDestination(addr), winnerIn.nBlockHeight);
+
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+
+    mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+
+    if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
+        CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
+        mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
+    }
+
+    const int nVotes = mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+    if (nVotes == MNPAYMENTS_LASTPAID_VOTES_REQUIRED) {
+        mapPayeePaidHeights[winnerIn.payee].insert(winnerIn.nBlockHeight);
+    }
+}
 
-        mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+int CMasternodePayments::GetLastPaidHeight(const CScript& payee, int nMinHeight, int nMaxHeight) const
+{
+    LOCK(cs_mapMasternodeBlocks);
 
-        if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
-            CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-            mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
+    const auto it = mapPayeePaidHeights.find(payee);
+    if (it == mapPayeePaidHeights.end() || nMaxHeight < nMinHeight) return -1;
+
+    // first height strictly above nMaxHeight, step back once to get the highest one in range
+    auto itHeight = it->second.upper_bound(nMaxHeight);
+    if (itHeight == it->second.begin()) return -1;
+    --itHeight;
+    return *itHeight >= nMinHeight ? *itHeight : -1;
+}
+
+void CMasternodePayments::RebuildPayeeIndex()
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_vecPayments);
+
+    mapPayeePaidHeights.clear();
+    for (const auto& it : mapMasternodeBlocks) {
+        for (const CMasternodePayee& payee : it.second.vecPayments) {
+            if (payee.nVotes >= MNPAYMENTS_LASTPAID_VOTES_REQUIRED) {
+                mapPayeePaidHeights[payee.scriptPubKey].insert(it.first);
+            }
         }
     }
+}
 
-    CTxDestination addr;
-    ExtractDestination(winnerIn.payee, addr);
-    LogPrint(BCLog::MASTERNODE, "mnw - Adding winner %s for block %d\n", EncodeDestination(addr), winnerIn.nBlockHeight);
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+void CMasternodePayments::RemoveBlockPayees(int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+
+    const auto it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it == mapMasternodeBlocks.end()) return;
+
+    {
+        LOCK(cs_vecPayments);
+        for (const CMasternodePayee& payee : it->second.vecPayments) {
+            auto itIndex = mapPayeePaidHeights.find(payee.scriptPubKey);
+            if (itIndex == mapPayeePaidHeights.end()) continue;
+            itIndex->second.erase(nBlockHeight);
+            if (itIndex->second.empty()) mapPayeePaidHeights.erase(itIndex);
+        }
+    }
+    mapMasternodeBlocks.erase(it);
 }
 
 bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
@@ -702,7 +751,7 @@ void CMasternodePayments::CleanPaymentList(int mnCount, int nHeight)
             LogPrint(BCLog::MASTERNODE, "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
             masternodeSync.mapSeenSyncMNW.erase((*it).first);
             mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
+            RemoveBlockPayees(winner.nBlockHeight);
         } else {
             ++it;
         }
@@ -25,6 +25,8 @@ extern CMasternodePayments masternodePayments;
 
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
+// minimum votes for a payee to be considered paid at a given height (used for queue ordering)
+#define MNPAYMENTS_LASTPAID_VOTES_REQUIRED 2
 
 bool IsBlockPayeeValid(const CBlock& block, const CBlockIndex* pindexPrev);
 std::string GetRequiredPaymentsString(int nBlockHeight);
@@ -102,19 +104,21 @@ public:
         vecPayments.clear();
     }
 
-    void AddPayee(const CScript& payeeIn, int nIncrement)
+    // Return the updated vote count for payeeIn
+    int AddPayee(const CScript& payeeIn, int nIncrement)
     {
         LOCK(cs_vecPayments);
 
         for (CMasternodePayee& payee : vecPayments) {
             if (payee.scriptPubKey == payeeIn) {
                 payee.nVotes += nIncrement;
-                return;
+                return payee.nVotes;
             }
         }
 
         CMasternodePayee c(payeeIn, nIncrement);
         vecPayments.push_back(c);
+        return nIncrement;
     }
 
     bool GetPayee(CScript& payee) const
@@ -223,6 +227,7 @@ public:
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
         mapMasternodeBlocks.clear();
         mapMasternodePayeeVotes.clear();
+        mapPayeePaidHeights.clear();
     }
 
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -243,18 +248,34 @@ public:
     bool IsTransactionValid(const CTransaction& txNew, const CBlockIndex* pindexPrev);
     bool IsScheduled(const CMasternode& mn, int nNotBlockHeight);
 
+    // Highest height in [nMinHeight, nMaxHeight] where payee has at least MNPAYMENTS_LASTPAID_VOTES_REQUIRED votes (-1 if none)
+    int GetLastPaidHeight(const CScript& payee, int nMinHeight, int nMaxHeight) const;
+    // Recompute mapPayeePaidHeights from mapMasternodeBlocks (after loading mnpayments.dat)
+    void RebuildPayeeIndex();
+
     bool ProcessMNWinner(CMasternodePaymentWinner& winner, CNode* pfrom, CValidationState& state);
     void ProcessMessageMasternodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txCoinbase, CMutableTransaction& txCoinstake, const CBlockIndex* pindexPrev, bool fProofOfStake) const;
     std::string ToString() const;
 
-    SERIALIZE_METHODS(CMasternodePayments, obj) { READWRITE(obj.mapMasternodePayeeVotes, obj.mapMasternodeBlocks); }
+    SERIALIZE_METHODS(CMasternodePayments, obj)
+    {
+        READWRITE(obj.mapMasternodePayeeVotes, obj.mapMasternodeBlocks);
+        SER_READ(obj, obj.RebuildPayeeIndex());
+    }
 
 private:
     // keep track of last voted height for mnw signers
     std::map<COutPoint, int> mapMasternodesLastVote; //prevout, nBlockHeight
 
+    // Reverse index of mapMasternodeBlocks: payee -> heights where it reached MNPAYMENTS_LASTPAID_VOTES_REQUIRED votes.
+    // Heights are chain-independent, so the time of the payment is resolved against the caller's chain (reorg safe).
+    // Protected by cs_mapMasternodeBlocks.
+    std::map<CScript, std::set<int>> mapPayeePaidHeights;
+
+    void RemoveBlockPayees(int nBlockHeight);
+
     bool CanVote(const COutPoint& outMasternode, int nBlockHeight) const;
     void RecordWinnerVote(const COutPoint& outMasternode, int nBlockHeight);
 };
@@ -1067,7 +1067,17 @@ int64_t CMasternodeMan::GetLastPaid(const MasternodeRef& mn, int count_enabled,
 {
     if (BlockReading == nullptr) return false;
 
-    const CScript& mnpayee = mn->GetPayeeScript();
+    // Look back up to count_enabled * 1.25 blocks from BlockReading (never below height 1) for a block
+    // where this payee has at least 2 votes. This will aid in consensus allowing the network to converge
+    // on the same payees quickly, then keep the same schedule.
+    // The payee index answers this in O(log n), the block time is then read from BlockReading's own chain.
+    const int max_depth = count_enabled * 1.25;
+    const int nMinHeight = std::max(BlockReading->nHeight - max_depth + 1, 1);
+    const int nPaidHeight = masternodePayments.GetLastPaidHeight(mn->GetPayeeScript(), nMinHeight, BlockReading->nHeight);
+    if (nPaidHeight < 0) return 0;
+
+    const CBlockIndex* pindexPaid = BlockReading->GetAncestor(nPaidHeight);
+    if (pindexPaid == nullptr) return 0;
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     ss << mn->vin;
@@ -1077,23 +1087,7 @@ int64_t CMasternodeMan::GetLastPaid(const MasternodeRef& mn, int count_enabled,
     // use a deterministic offset to break a tie -- 2.5 minutes
     int64_t nOffset = UintToArith256(hash).GetCompact(false) % 150;
 
-    int max_depth = count_enabled * 1.25;
-    for (int n = 0; n < max_depth; n++) {
-        const auto& it = masternodePayments.mapMasternodeBlocks.find(BlockReading->nHeight);
-        if (it != masternodePayments.mapMasternodeBlocks.end()) {
-            // Search for this payee, with at least 2 votes. This will aid in consensus
-            // allowing the network to converge on the same payees quickly, then keep the same schedule.
-            if (it->second.HasPayeeWithVotes(mnpayee, 2))
-                return BlockReading->nTime + nOffset;
-        }
-        BlockReading = BlockReading->pprev;
-
-        if (BlockReading == nullptr || BlockReading->nHeight <= 0) {
-            break;
-        }
-    }
-
-    return 0;
+    return pindexPaid->nTime + nOffset;
 }
 
 std::string CMasternodeMan::ToString() const
@@ -4,14 +4,89 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bls/bls_wrapper.h"
+#include "crypto/sha256.h"
 #include "hash.h"
 #include "key_io.h"
 #include "messagesigner.h"
+#include "random.h"
+#include "sync.h"
 #include "tinyformat.h"
 #include "util/system.h"
 #include "util/validation.h"
 #include "utilstrencodings.h"
 
+#include <deque>
+#include <unordered_map>
+
+namespace {
+/**
+ * Message signature verification cache, so that a tier two message relayed by several
+ * peers (or verified ahead by the CTierTwoSigVerifier) has its signature checked only once.
+ * The invalid signatures are cached too, so that a message verified ahead with an invalid
+ * signature isn't checked again when it is processed.
+ */
+class CMessageSignatureCache
+{
+public:
+    struct Result {
+        bool fValid;
+        //! The key recovered from a valid ECDSA signature
+        CKeyID keyID;
+    };
+
+private:
+    //! Entries are SHA256(nonce || hash || key || signature), the key being the public key
+    //! of a BLS signature, and empty for an ECDSA signature (its key is recovered from it).
+    uint256 nonce;
+    Mutex cs_sigcache;
+    std::unordered_map<uint256, Result> mapResults GUARDED_BY(cs_sigcache);
+    //! The entries in insertion order, the oldest ones are evicted first
+    std::deque<uint256> dequeEntries GUARDED_BY(cs_sigcache);
+
+public:
+    //! Enough for the votes and pings of several thousands masternodes
+    static const size_t MAX_ENTRIES = 50000;
+
+    CMessageSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    uint256 ComputeEntry(const uint256& hash, const unsigned char* key, size_t keySize, const std::vector<unsigned char>& vchSig) const
+    {
+        uint256 entry;
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(key, keySize).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry, Result& resultRet)
+    {
+        LOCK(cs_sigcache);
+        auto it = mapResults.find(entry);
+        if (it == mapResults.end()) {
+            return false;
+        }
+        resultRet = it->second;
+        return true;
+    }
+
+    void Set(const uint256& entry, const Result& result)
+    {
+        LOCK(cs_sigcache);
+        if (!mapResults.emplace(entry, result).second) {
+            return;
+        }
+        dequeEntries.push_back(entry);
+        if (dequeEntries.size() > MAX_ENTRIES) {
+            mapResults.erase(dequeEntries.front());
+            dequeEntries.pop_front();
+        }
+    }
+};
+
+static CMessageSignatureCache messageSignatureCache;
+}
+
 
 bool CMessageSigner::GetKeysFromSecret(const std::string& strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
@@ -87,15 +162,15 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const s
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
-    CPubKey pubkeyFromSig;
-    if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
+    CKeyID keyIDFromSig;
+    if (!PreVerifyHash(hash, vchSig, keyIDFromSig)) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
 
-    if(pubkeyFromSig.GetID() != keyID) {
+    if(keyIDFromSig != keyID) {
         strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, hash=%s, vchSig=%s",
-                EncodeDestination(keyID), EncodeDestination(pubkeyFromSig.GetID()),
+                EncodeDestination(keyID), EncodeDestination(keyIDFromSig),
                 hash.ToString(), EncodeBase64(vchSig));
         return false;
     }
@@ -103,9 +178,42 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std
     return true;
 }
 
+static uint256 ComputeBLSEntry(const uint256& hash, const CBLSPublicKey& pk, const std::vector<unsigned char>& vchSig)
+{
+    const std::vector<unsigned char> vchPubKey = pk.ToByteVector();
+    return messageSignatureCache.ComputeEntry(hash, vchPubKey.data(), vchPubKey.size(), vchSig);
+}
+
 bool CHashSigner::VerifyHash(const uint256& hash, const CBLSPublicKey& pk, const std::vector<unsigned char>& vchSig)
 {
-    return CBLSSignature(vchSig).VerifyInsecure(pk, hash);
+    const uint256 entry = ComputeBLSEntry(hash, pk, vchSig);
+    CMessageSignatureCache::Result result;
+    if (!messageSignatureCache.Get(entry, result)) {
+        result.fValid = CBLSSignature(vchSig).VerifyInsecure(pk, hash);
+        messageSignatureCache.Set(entry, result);
+    }
+    return result.fValid;
+}
+
+bool CHashSigner::PreVerifyHash(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet)
+{
+    const uint256 entry = messageSignatureCache.ComputeEntry(hash, nullptr, 0, vchSig);
+    CMessageSignatureCache::Result result;
+    if (!messageSignatureCache.Get(entry, result)) {
+        CPubKey pubkeyFromSig;
+        result.fValid = pubkeyFromSig.RecoverCompact(hash, vchSig);
+        if (result.fValid) result.keyID = pubkeyFromSig.GetID();
+        messageSignatureCache.Set(entry, result);
+    }
+    keyIDRet = result.keyID;
+    return result.fValid;
+}
+
+bool CHashSigner::IsHashSigCached(const uint256& hash, const std::vector<unsigned char>& vchSig, const CBLSPublicKey* pk)
+{
+    CMessageSignatureCache::Result result;
+    return messageSignatureCache.Get(pk ? ComputeBLSEntry(hash, *pk, vchSig)
+                                        : messageSignatureCache.ComputeEntry(hash, nullptr, 0, vchSig), result);
 }
 
 /** CSignedMessage Class
@@ -165,6 +273,18 @@ bool CSignedMessage::CheckSignature(const CKeyID& keyID) const
     return CMessageSigner::VerifyMessage(keyID, vchSig, strMessage, strError);
 }
 
+void CSignedMessage::PreVerifySignature(const CBLSPublicKey* pk) const
+{
+    if (vchSig.size() == BLS_CURVE_SIG_SIZE) {
+        if (pk) CheckSignature(*pk);
+        return;
+    }
+    const uint256 hash = (nMessVersion == MessageVersion::MESS_VER_HASH ? GetSignatureHash()
+                                                                        : CMessageSigner::GetMessageHash(GetStrMessage()));
+    CKeyID keyID;
+    CHashSigner::PreVerifyHash(hash, vchSig, keyID);
+}
+
 bool CSignedMessage::CheckSignature(const CBLSPublicKey& pk) const
 {
     // Only MESS_VER_HASH allowed
@@ -54,6 +54,11 @@ public:
     static bool VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
     /// Verify the hash BLS signature, returns true if successful
     static bool VerifyHash(const uint256& hash, const CBLSPublicKey& pk, const std::vector<unsigned char>& vchSig);
+    /// Recover the key of the hash signature (or get it from the signature cache),
+    /// returns true if successful
+    static bool PreVerifyHash(const uint256& hash, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet);
+    /// Whether the result of the verification of the hash signature is cached (pk for a BLS signature)
+    static bool IsHashSigCached(const uint256& hash, const std::vector<unsigned char>& vchSig, const CBLSPublicKey* pk = nullptr);
 };
 
 /** Base Class for all signed messages on the network
@@ -91,6 +96,10 @@ public:
     // Sign-Verify with BLS
     bool Sign(const CBLSSecretKey& sk);
     bool CheckSignature(const CBLSPublicKey& pk) const;
+
+    // Verify the signature ahead (with pk, if it is a BLS signature), so that the
+    // CheckSignature of the message processing finds it in the signature cache
+    void PreVerifySignature(const CBLSPublicKey* pk = nullptr) const;
 };
 
 #endif
@@ -62,6 +62,19 @@
 
 const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
+// Largest read made straight into the payload of a message being received
+static const unsigned int MAX_DIRECT_RECV_SIZE = 256 * 1024;
+// Headers and payloads handed to the kernel in a single sendmsg() call
+static const int MAX_SEND_SEGMENTS = 64;
+
+#ifdef WIN32
+// Segments are sent one at a time with send()
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#endif
+
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
 //
@@ -736,16 +749,7 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes, bool& complete
         nBytes -= handled;
 
         if (msg.complete()) {
-
-            // Store received bytes per message command
-            // to prevent a memory DOS, only allow valid commands
-            mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.hdr.pchCommand);
-            if (i == mapRecvBytesPerMsgCmd.end())
-                i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
-            assert(i != mapRecvBytesPerMsgCmd.end());
-            i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
-
-            msg.nTime = nTimeMicros;
+            MessageReceived(msg, nTimeMicros);
             complete = true;
         }
     }
@@ -753,6 +757,46 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes, bool& complete
     return true;
 }
 
+char* CNode::GetRecvDataBuffer(unsigned int nMin, unsigned int& nMax)
+{
+    LOCK(cs_vRecv);
+    if (vRecvMsg.empty() || !vRecvMsg.back().in_data || vRecvMsg.back().complete())
+        return nullptr;
+    CNetMessage& msg = vRecvMsg.back();
+    if (msg.hdr.nMessageSize - msg.nDataPos < nMin)
+        return nullptr;
+    return msg.reserveData(nMax);
+}
+
+void CNode::ReceiveMsgData(unsigned int nBytes, bool& complete)
+{
+    complete = false;
+    int64_t nTimeMicros = GetTimeMicros();
+    LOCK(cs_vRecv);
+    nLastRecv = nTimeMicros / 1000000;
+    nRecvBytes += nBytes;
+    CNetMessage& msg = vRecvMsg.back();
+    msg.commitData(nBytes);
+    if (msg.complete()) {
+        MessageReceived(msg, nTimeMicros);
+        complete = true;
+    }
+}
+
+// requires LOCK(cs_vRecv)
+void CNode::MessageReceived(CNetMessage& msg, int64_t nTimeMicros)
+{
+    // Store received bytes per message command
+    // to prevent a memory DOS, only allow valid commands
+    mapMsgCmdSize::iterator i = mapRecvBytesPerMsgCmd.find(msg.hdr.pchCommand);
+    if (i == mapRecvBytesPerMsgCmd.end())
+        i = mapRecvBytesPerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapRecvBytesPerMsgCmd.end());
+    i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+
+    msg.nTime = nTimeMicros;
+}
+
 void CNode::SetSendVersion(int nVersionIn)
 {
     // Send version may only be changed in the version message, and
@@ -810,20 +854,32 @@ int CNetMessage::readHeader(const char* pch, unsigned int nBytes)
 }
 
 int CNetMessage::readData(const char* pch, unsigned int nBytes)
+{
+    unsigned int nCopy = nBytes;
+    memcpy(reserveData(nCopy), pch, nCopy);
+    commitData(nCopy);
+
+    return nCopy;
+}
+
+char* CNetMessage::reserveData(unsigned int& nBytes)
 {
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
-    unsigned int nCopy = std::min(nRemaining, nBytes);
+    nBytes = std::min(nRemaining, nBytes);
 
-    if (vRecv.size() < nDataPos + nCopy) {
+    if (vRecv.size() < nDataPos + nBytes) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nBytes + 256 * 1024));
     }
 
-    hasher.Write((const unsigned char*)pch, nCopy);
-    memcpy(&vRecv[nDataPos], pch, nCopy);
-    nDataPos += nCopy;
+    return &vRecv[nDataPos];
+}
 
-    return nCopy;
+void CNetMessage::commitData(unsigned int nBytes)
+{
+    assert(nDataPos + nBytes <= vRecv.size());
+    hasher.Write((const unsigned char*)&vRecv[nDataPos], nBytes);
+    nDataPos += nBytes;
 }
 
 const uint256& CNetMessage::GetMessageHash() const
@@ -840,28 +896,67 @@ size_t CConnman::SocketSendData(CNode* pnode)
     auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
+    // Cleared before writing, so that an edge reported meanwhile is not lost. Set again
+    // below if everything was written, as the socket is then still writable.
+    pnode->fSendReady = false;
+
     while (it != pnode->vSendMsg.end()) {
-        const auto& data = *it;
-        assert(data.size() > pnode->nSendOffset);
-        int nBytes = 0;
+        // Gather the unsent headers and payloads, so that they are written with a single
+        // call, straight from the queued buffers.
+        struct iovec vSegments[MAX_SEND_SEGMENTS];
+        int nSegments = 0;
+        size_t nGathered = 0;
+        size_t nSkip = pnode->nSendOffset;
+        auto addSegment = [&](const unsigned char* pch, size_t nSize) {
+            if (nSkip >= nSize) {
+                nSkip -= nSize;
+                return;
+            }
+            vSegments[nSegments].iov_base = const_cast<unsigned char*>(pch) + nSkip;
+            vSegments[nSegments].iov_len = nSize - nSkip;
+            nGathered += nSize - nSkip;
+            nSegments++;
+            nSkip = 0;
+        };
+        for (auto jt = it; jt != pnode->vSendMsg.end() && nSegments + 2 <= MAX_SEND_SEGMENTS; ++jt) {
+            const std::vector<unsigned char>& payload = jt->msg.Payload();
+            addSegment(jt->header, CMessageHeader::HEADER_SIZE);
+            if (!payload.empty())
+                addSegment(payload.data(), payload.size());
+        }
+        assert(nGathered > 0);
+
+        int64_t nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nGathered = vSegments[0].iov_len;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(vSegments[0].iov_base), nGathered, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = vSegments;
+            msg.msg_iovlen = nSegments;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
-                pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            // Drop the messages written completely
+            size_t nOffset = pnode->nSendOffset + nBytes;
+            while (it != pnode->vSendMsg.end() && nOffset >= it->size()) {
+                nOffset -= it->size();
+                pnode->nSendSize -= it->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->nSendOffset = nOffset;
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nGathered) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -881,6 +976,7 @@ size_t CConnman::SocketSendData(CNode* pnode)
     if (it == pnode->vSendMsg.end()) {
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
+        pnode->fSendReady = true;
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
@@ -1058,7 +1154,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket)) {
+    if (fSelectableSocketsOnly && !IsSelectableSocket(hSocket)) {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
         return;
@@ -1089,282 +1185,321 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
-    {
-        LOCK(cs_vNodes);
-        vNodes.push_back(pnode);
-    }
+    RegisterNode(pnode);
 
     // We received a new connection, harvest entropy from the time (and our peer count)
     RandAddEvent((uint32_t)id);
 }
 
-void CConnman::ThreadSocketHandler()
+void CConnman::RegisterNode(CNode* pnode)
 {
-    unsigned int nPrevNodeCount = 0;
-    while (!interruptNet) {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            std::vector<CNode*> vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy) {
-                if (pnode->fDisconnect) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+    // Spread the peers over the socket handler threads. A peer is always serviced by the same thread.
+    pnode->nNetThread = pnode->GetId() % nNetThreads;
+    CSocketEvents& events = *vSocketEvents[pnode->nNetThread];
+    if (events.IsEdgeTriggered()) {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET || !events.Add(pnode->hSocket, (uint64_t)pnode->GetId())) {
+            pnode->fDisconnect = true;
+        }
+    }
 
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
+    LOCK(cs_vNodes);
+    vNodes.push_back(pnode);
+}
 
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+void CConnman::DisconnectNodes()
+{
+    {
+        LOCK(cs_vNodes);
+        // Disconnect unused nodes
+        std::vector<CNode*> vNodesCopy = vNodes;
+        for (CNode* pnode : vNodesCopy) {
+            if (pnode->fDisconnect) {
+                // remove from vNodes
+                vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
 
-                    // hold in disconnected pool until all refs are released
-                    pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
+                // release outbound grant (if any)
+                pnode->grantOutbound.Release();
+
+                // close socket and cleanup
+                pnode->CloseSocketDisconnect();
+
+                // hold in disconnected pool until all refs are released
+                pnode->Release();
+                vNodesDisconnected.push_back(pnode);
             }
         }
-        {
-            // Delete disconnected nodes
-            std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            for (CNode* pnode : vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_inventory, lockInv);
-                        if (lockInv) {
-                            TRY_LOCK(pnode->cs_vSend, lockSend);
-                            if (lockSend) {
-                                fDelete = true;
-                            }
+    }
+    {
+        // Delete disconnected nodes
+        std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        for (CNode* pnode : vNodesDisconnectedCopy) {
+            // wait until threads are done using it
+            if (pnode->GetRefCount() <= 0) {
+                bool fDelete = false;
+                {
+                    TRY_LOCK(pnode->cs_inventory, lockInv);
+                    if (lockInv) {
+                        TRY_LOCK(pnode->cs_vSend, lockSend);
+                        if (lockSend) {
+                            fDelete = true;
                         }
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        DeleteNode(pnode);
-                    }
+                }
+                if (fDelete) {
+                    vNodesDisconnected.remove(pnode);
+                    DeleteNode(pnode);
                 }
             }
         }
-        size_t vNodesSize;
-        {
-            LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
-        }
-        if(vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            if(clientInterface)
-                clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
-        }
+    }
+}
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+void CConnman::NotifyNumConnectionsChanged(unsigned int& nPrevNodeCount)
+{
+    size_t vNodesSize;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if(vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        if(clientInterface)
+            clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+}
 
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
+//! Tag of the listening sockets in the socket events (node ids are used for peers)
+static const uint64_t LISTEN_SOCKET_TAG = (uint64_t)1 << 63;
 
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+void CConnman::SocketHandler(int nThread)
+{
+    CSocketEvents& events = *vSocketEvents[nThread];
+    const bool fEdgeTriggered = events.IsEdgeTriggered();
+
+    // Copy the nodes serviced by this thread
+    std::vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            if (pnode->nNetThread == nThread) {
+                pnode->AddRef();
+                vNodesCopy.push_back(pnode);
+            }
         }
+    }
 
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes) {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
+    //
+    // Find which sockets have data to receive
+    //
+    int64_t nTimeout = 50; // frequency to poll pnode->vSend
+    std::vector<SocketInterest> vInterest;
+    if (!fEdgeTriggered) {
+        if (nThread == 0) {
+            for (size_t i = 0; i < vhListenSocket.size(); i++) {
+                vInterest.emplace_back(vhListenSocket[i].socket, LISTEN_SOCKET_TAG | i, true, false);
+            }
+        }
+        for (CNode* pnode : vNodesCopy) {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
 
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            vInterest.emplace_back(pnode->hSocket, (uint64_t)pnode->GetId(), select_recv && !select_send, select_send);
+        }
+    } else {
+        // Don't block when a node still has readiness left over from a previous event
+        for (CNode* pnode : vNodesCopy) {
+            if ((pnode->fRecvReady && !pnode->fPauseRecv) ||
+                (pnode->fSendReady && WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty()))) {
+                nTimeout = 0;
+                break;
+            }
+        }
+    }
 
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+    std::vector<SocketEvent> vEvents;
+    if (!events.Wait(vInterest, nTimeout, vEvents)) {
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(nTimeout)))
+            vEvents.clear();
+    }
 
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
+    std::unordered_map<uint64_t, SocketEvent> mapNodeEvents;
+    for (const SocketEvent& event : vEvents) {
+        if (interruptNet)
+            break;
+        if (event.nTag & LISTEN_SOCKET_TAG) {
+            //
+            // Accept new connections
+            //
+            const size_t i = event.nTag & ~LISTEN_SOCKET_TAG;
+            if (i < vhListenSocket.size() && vhListenSocket[i].socket != INVALID_SOCKET && event.fRecv) {
+                AcceptConnection(vhListenSocket[i]);
             }
+        } else {
+            mapNodeEvents.emplace(event.nTag, event);
         }
+    }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    //
+    // Service each socket
+    //
+    for (CNode* pnode : vNodesCopy) {
         if (interruptNet)
-            return;
+            break;
 
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
+        bool recvSet = false;
+        bool sendSet = false;
+        auto it = mapNodeEvents.find((uint64_t)pnode->GetId());
+        if (fEdgeTriggered) {
+            if (it != mapNodeEvents.end()) {
+                if (it->second.fRecv || it->second.fError) pnode->fRecvReady = true;
+                if (it->second.fSend) pnode->fSendReady = true;
             }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
+            const bool fHasSendData = WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty());
+            sendSet = fHasSendData && pnode->fSendReady;
+            // Drain the write buffer first, as in select mode
+            recvSet = !fHasSendData && !pnode->fPauseRecv && pnode->fRecvReady;
+        } else if (it != mapNodeEvents.end()) {
+            recvSet = it->second.fRecv || it->second.fError;
+            sendSet = it->second.fSend;
         }
 
         //
-        // Accept new connections
+        // Receive
         //
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
-                AcceptConnection(hListenSocket);
-            }
+        if (recvSet) {
+            SocketRecvData(pnode);
         }
 
         //
-        // Service each socket
+        // Send
         //
-        std::vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
-                pnode->AddRef();
+        if (sendSet) {
+            LOCK(pnode->cs_vSend);
+            size_t nBytes = SocketSendData(pnode);
+            if (nBytes)
+                RecordBytesSent(nBytes);
         }
-        for (CNode* pnode : vNodesCopy) {
-            if (interruptNet)
-                return;
 
-            //
-            // Receive
-            //
-            bool recvSet = false;
-            bool sendSet = false;
-            bool errorSet = false;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
-            }
-            if (recvSet || errorSet) {
-                {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = 0;
-                        {
-                            LOCK(pnode->cs_hSocket);
-                            if (pnode->hSocket == INVALID_SOCKET)
-                                continue;
-                            nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        }
-                        if (nBytes > 0) {
-                            bool notify = false;
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                                pnode->CloseSocketDisconnect();
-                            RecordBytesRecv(nBytes);
-                            if (notify) {
-                                size_t nSizeAdded = 0;
-                                auto it(pnode->vRecvMsg.begin());
-                                for (; it != pnode->vRecvMsg.end(); ++it) {
-                                    if (!it->complete())
-                                        break;
-                                    nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                                }
-                                {
-                                    LOCK(pnode->cs_vProcessMsg);
-                                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                                    pnode->nProcessQueueSize += nSizeAdded;
-                                    pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                                }
-                                WakeMessageHandler();
-                            }
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint(BCLog::NET, "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
+        //
+        // Inactivity checking
+        //
+        int64_t nTime = GetSystemTimeInSeconds();
+        if (nTime - pnode->nTimeConnected > 60) {
+            if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+                LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
+                pnode->fDisconnect = true;
+            } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+                LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+                pnode->fDisconnect = true;
+            } else if (nTime - pnode->nLastRecv > TIMEOUT_INTERVAL) {
+                LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+                pnode->fDisconnect = true;
+            } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+                LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+                pnode->fDisconnect = true;
             }
+        }
+    }
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+    }
+}
 
-            //
-            // Send
-            //
-            if (sendSet) {
-                LOCK(pnode->cs_vSend);
-                size_t nBytes = SocketSendData(pnode);
-                if (nBytes)
-                    RecordBytesSent(nBytes);
+void CConnman::SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    // The payload of large messages (blocks) is read straight into the message, instead of
+    // being copied from pchBuf. Only this thread touches vRecvMsg, so the buffer stays valid.
+    unsigned int nDirect = MAX_DIRECT_RECV_SIZE;
+    char* pchDirect = pnode->GetRecvDataBuffer(sizeof(pchBuf), nDirect);
+    unsigned int nBufSize = pchDirect ? nDirect : sizeof(pchBuf);
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            return;
+        // Cleared before reading, so that an edge reported meanwhile is not lost
+        pnode->fRecvReady = false;
+        nBytes = recv(pnode->hSocket, pchDirect ? pchDirect : pchBuf, nBufSize, MSG_DONTWAIT);
+    }
+    if (nBytes > 0) {
+        // A full buffer means there may be more to read
+        if (nBytes == (int)nBufSize)
+            pnode->fRecvReady = true;
+        bool notify = false;
+        if (pchDirect) {
+            pnode->ReceiveMsgData(nBytes, notify);
+        } else if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify)) {
+            pnode->CloseSocketDisconnect();
+        }
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
             }
-
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
             }
+            WakeMessageHandler();
         }
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodesCopy)
-                pnode->Release();
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint(BCLog::NET, "socket closed\n");
+        pnode->CloseSocketDisconnect();
+    } else if (nBytes < 0) {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
         }
     }
 }
 
+void CConnman::ThreadSocketHandler(int nThread)
+{
+    unsigned int nPrevNodeCount = 0;
+    while (!interruptNet) {
+        // Node bookkeeping is done by the first thread only
+        if (nThread == 0) {
+            DisconnectNodes();
+            NotifyNumConnectionsChanged(nPrevNodeCount);
+        }
+        SocketHandler(nThread);
+    }
+}
+
 void CConnman::WakeMessageHandler()
 {
     {
@@ -1754,10 +1889,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->fAddnode = true;
 
     m_msgproc->InitializeNode(pnode);
-    {
-        LOCK(cs_vNodes);
-        vNodes.push_back(pnode);
-    }
+    RegisterNode(pnode);
 }
 
 void CConnman::ThreadMessageHandler()
@@ -1954,6 +2086,24 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
     nReceiveFloodSize = connOptions.nReceiveFloodSize;
 
+    nNetThreads = std::max(1, std::min(connOptions.nNetThreads, MAX_NET_THREADS));
+    vSocketEvents.clear();
+    for (int i = 0; i < nNetThreads; i++) {
+        vSocketEvents.emplace_back(new CSocketEvents(connOptions.socketEventsMode));
+        if (!vSocketEvents.back()->Init(strNodeError)) {
+            vSocketEvents.clear();
+            return false;
+        }
+    }
+    // Listening sockets are serviced by the first thread
+    for (size_t i = 0; i < vhListenSocket.size(); i++) {
+        if (!vSocketEvents[0]->Add(vhListenSocket[i].socket, LISTEN_SOCKET_TAG | i, true)) {
+            strNodeError = strprintf("Failed to watch listening socket: %s", NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+    LogPrintf("Using %s for %d socket handler thread(s)\n", SocketEventsModeToString(connOptions.socketEventsMode), nNetThreads);
+
     SetBestHeight(connOptions.nBestHeight);
 
     clientInterface = connOptions.uiInterface;
@@ -2020,7 +2170,12 @@ bool CConnman::Start(CScheduler& scheduler, std::string& strNodeError, Options c
     }
 
     // Send and receive from sockets, accept connections
-    threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
+    for (int i = 0; i < nNetThreads; i++) {
+        threadSocketHandlers.emplace_back([this, i]() {
+            const std::string strThreadName = i == 0 ? "net" : strprintf("net.%d", i);
+            TraceThread(strThreadName.c_str(), std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this, i)));
+        });
+    }
 
     if (!gArgs.GetBoolArg("-dnsseed", true))
         LogPrintf("DNS seeding disabled\n");
@@ -2100,8 +2255,11 @@ void CConnman::Stop()
         threadOpenAddedConnections.join();
     if (threadDNSAddressSeed.joinable())
         threadDNSAddressSeed.join();
-    if (threadSocketHandler.joinable())
-        threadSocketHandler.join();
+    for (std::thread& thread : threadSocketHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadSocketHandlers.clear();
 
     if (fAddressesInitialized)
     {
@@ -2127,6 +2285,7 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+    vSocketEvents.clear();
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2428,17 +2587,20 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
+    const std::vector<unsigned char>& payload = msg.Payload();
+    size_t nMessageSize = payload.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
-    std::vector<unsigned char> serializedHeader;
-    serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = !msg.hashPayload.IsNull() ? msg.hashPayload : Hash(payload.data(), payload.data() + nMessageSize);
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
-    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
-    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
+    // Serialized in place, in the layout of CMessageHeader
+    CNetSendMsg sendMsg;
+    memcpy(sendMsg.header, hdr.pchMessageStart, MESSAGE_START_SIZE);
+    memcpy(sendMsg.header + MESSAGE_START_SIZE, hdr.pchCommand, CMessageHeader::COMMAND_SIZE);
+    WriteLE32(sendMsg.header + CMessageHeader::MESSAGE_SIZE_OFFSET, hdr.nMessageSize);
+    memcpy(sendMsg.header + CMessageHeader::CHECKSUM_OFFSET, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     size_t nBytesSent = 0;
     {
@@ -2448,12 +2610,11 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
         pnode->nSendSize += nTotalSize;
+        sendMsg.msg = std::move(msg);
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.push_back(std::move(sendMsg));
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
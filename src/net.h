@@ -19,6 +19,7 @@
 #include "netaddress.h"
 #include "protocol.h"
 #include "random.h"
+#include "socketevents.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
@@ -69,6 +70,10 @@ static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
+/** -netthreads default: number of socket handler threads */
+static const int DEFAULT_NET_THREADS = 1;
+/** Maximum number of socket handler threads */
+static const int MAX_NET_THREADS = 16;
 /** Disconnected peers are added to setOffsetDisconnectedPeers only if node has less than ENOUGH_CONNECTIONS */
 #define ENOUGH_CONNECTIONS 2
 /** Maximum number of peers added to setOffsetDisconnectedPeers before triggering a warning */
@@ -104,6 +109,12 @@ class CTransaction;
 class CNodeStats;
 class CClientUIInterface;
 
+/**
+ * Immutable, reference counted message payload. The same bytes (e.g. a block read from disk) can be
+ * queued to any number of peers without being copied.
+ */
+typedef std::shared_ptr<const std::vector<unsigned char>> CNetPayloadRef;
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -114,7 +125,13 @@ struct CSerializedNetMsg
     CSerializedNetMsg& operator=(const CSerializedNetMsg&) = delete;
 
     std::vector<unsigned char> data;
+    //! If set, the payload, sent instead of data
+    CNetPayloadRef sharedData;
+    //! Double SHA256 of the payload, when already known (computed by PushMessage otherwise)
+    uint256 hashPayload;
     std::string command;
+
+    const std::vector<unsigned char>& Payload() const { return sharedData ? *sharedData : data; }
 };
 
 class NetEventsInterface;
@@ -143,6 +160,8 @@ public:
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
         std::vector<bool> m_asmap;
+        int nNetThreads = DEFAULT_NET_THREADS;
+        SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
     };
     CConnman(uint64_t seed0, uint64_t seed1);
     ~CConnman();
@@ -314,7 +333,13 @@ private:
     void ThreadOpenConnections();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
-    void ThreadSocketHandler();
+    //! Add a new node to vNodes and assign it to a socket handler thread
+    void RegisterNode(CNode* pnode);
+    void DisconnectNodes();
+    void NotifyNumConnectionsChanged(unsigned int& nPrevNodeCount);
+    void SocketHandler(int nThread);
+    void SocketRecvData(CNode* pnode);
+    void ThreadSocketHandler(int nThread);
     void ThreadDNSAddressSeed();
 
     void WakeMessageHandler();
@@ -410,7 +435,11 @@ private:
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
-    std::thread threadSocketHandler;
+    std::vector<std::thread> threadSocketHandlers;
+
+    /** Socket handler threads, and the readiness backend of each of them */
+    int nNetThreads{DEFAULT_NET_THREADS};
+    std::vector<std::unique_ptr<CSocketEvents>> vSocketEvents;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
@@ -555,6 +584,20 @@ public:
 
     int readHeader(const char* pch, unsigned int nBytes);
     int readData(const char* pch, unsigned int nBytes);
+
+    //! Make room for up to nBytes more payload bytes (fewer if less are outstanding), and return where they go
+    char* reserveData(unsigned int& nBytes);
+    //! Account for nBytes payload bytes written at the pointer returned by reserveData
+    void commitData(unsigned int nBytes);
+};
+
+/** A message in a peer's send queue: the serialized header, followed by the payload */
+struct CNetSendMsg
+{
+    unsigned char header[CMessageHeader::HEADER_SIZE];
+    CSerializedNetMsg msg;
+
+    size_t size() const { return CMessageHeader::HEADER_SIZE + msg.Payload().size(); }
 };
 
 
@@ -570,7 +613,7 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CNetSendMsg> vSendMsg;
     RecursiveMutex cs_vSend;
     RecursiveMutex cs_hSocket;
     RecursiveMutex cs_vRecv;
@@ -623,6 +666,13 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+
+    //! Socket handler thread servicing this node
+    int nNetThread{0};
+    //! Readiness remembered between edge-triggered events: the socket may have data to read,
+    //! or room to write. Unused with level-triggered (select) socket events.
+    std::atomic_bool fRecvReady{false};
+    std::atomic_bool fSendReady{false};
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
@@ -689,6 +739,8 @@ private:
     int nSendVersion;
     std::list<CNetMessage> vRecvMsg;  // Used only by SocketHandler thread
 
+    void MessageReceived(CNetMessage& msg, int64_t nTimeMicros);
+
     mutable RecursiveMutex cs_addrName;
     std::string addrName;
 
@@ -724,6 +776,15 @@ public:
 
     bool ReceiveMsgBytes(const char* pch, unsigned int nBytes, bool& complete);
 
+    /**
+     * If at least nMin payload bytes of the message being received are outstanding, return where
+     * (up to nMax of) them can be read to directly, instead of going through ReceiveMsgBytes.
+     * Returns nullptr otherwise.
+     */
+    char* GetRecvDataBuffer(unsigned int nMin, unsigned int& nMax);
+    //! Account for nBytes read to the buffer returned by GetRecvDataBuffer
+    void ReceiveMsgData(unsigned int nBytes, bool& complete);
+
     void SetRecvVersion(int nVersionIn)
     {
         nRecvVersion = nVersionIn;
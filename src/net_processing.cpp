@@ -7,6 +7,7 @@
 
 #include "net_processing.h"
 
+#include "blockencodings.h"
 #include "budget/budgetmanager.h"
 #include "chain.h"
 #include "evo/deterministicmns.h"
@@ -20,6 +21,7 @@
 #include "primitives/transaction.h"
 #include "sporkdb.h"
 #include "streams.h"
+#include "tiertwo_sigverifier.h"
 #include "validation.h"
 #include "util/validation.h"
 
@@ -29,6 +31,16 @@ static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SH
 
 /** the maximum percentage of addresses from our addrman to return in response to a getaddr message. */
 static constexpr size_t MAX_PCT_ADDR_TO_SEND = 23;
+/** Maximum number of unconnecting headers announcements before DoS score */
+static const int MAX_UNCONNECTING_HEADERS = 10;
+/** Maximum total size of the blocks downloaded ahead of their parent's data */
+static const size_t MAX_BLOCKS_AWAITING_PARENT_SIZE = 64 * 1024 * 1024;
+/** Version of the compact block encoding (BIP152) we provide and accept */
+static const uint64_t CMPCTBLOCKS_VERSION = 1;
+/** Maximum number of peers announcing new blocks to us with compact blocks */
+static const size_t MAX_CMPCTBLOCK_ANNOUNCERS = 3;
+/** Maximum depth of the blocks we answer getblocktxn for; deeper blocks are sent in full */
+static const int MAX_BLOCKTXN_DEPTH = 10;
 
 struct IteratorComparator
 {
@@ -95,15 +107,74 @@ struct QueuedBlock {
     int64_t nTime;              //! Time of "getdata" request in microseconds.
     int nValidatedQueuedBefore; //! Number of blocks queued with validated headers (globally) at the time this one is requested.
     bool fValidatedHeaders;     //! Whether this block has validated headers at the time of request.
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock; //! Optional, for compact blocks waiting for a blocktxn.
 };
 std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
+/**
+ * Blocks downloaded in parallel that arrived before the data of their parent.
+ * They are handed to ProcessNewBlock once the parent has been processed.
+ * Protected by cs_main.
+ */
+std::map<uint256, std::shared_ptr<const CBlock>> mapBlocksAwaitingParent;
+std::multimap<uint256, uint256> mapBlocksAwaitingParentByPrev;
+size_t nBlocksAwaitingParentSize = 0;
+
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
+/** Peers we asked to announce new blocks with compact blocks, least recently useful first. Protected by cs_main. */
+std::list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
+/** A block, serialized as it is relayed, with the checksum of the block message */
+struct CRecentBlock {
+    uint256 hash;
+    CNetPayloadRef payload;
+    uint256 hashPayload;
+};
+
+/**
+ * Recently connected blocks, or served blocks near the tip, most recently used first. When many peers request a new
+ * tip, it is sent from here, without reading the block files or hashing the payload again.
+ */
+Mutex cs_recentBlocks;
+std::list<CRecentBlock> lRecentBlocks GUARDED_BY(cs_recentBlocks);
+//! The last connected block, to answer getblocktxn without reading it back
+std::shared_ptr<const CBlock> pMostRecentBlock GUARDED_BY(cs_recentBlocks);
+//! Its serialized compact block, announced to the peers that asked for compact blocks
+CRecentBlock recentCompactBlock GUARDED_BY(cs_recentBlocks);
+
+bool GetRecentBlock(const uint256& hash, CRecentBlock& block)
+{
+    LOCK(cs_recentBlocks);
+    for (auto it = lRecentBlocks.begin(); it != lRecentBlocks.end(); ++it) {
+        if (it->hash == hash) {
+            lRecentBlocks.splice(lRecentBlocks.begin(), lRecentBlocks, it);
+            block = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+CRecentBlock AddRecentBlock(const uint256& hash, CNetPayloadRef payload)
+{
+    CRecentBlock block{hash, std::move(payload), uint256()};
+    block.hashPayload = Hash(block.payload->begin(), block.payload->end());
+
+    LOCK(cs_recentBlocks);
+    for (const CRecentBlock& recent : lRecentBlocks) {
+        if (recent.hash == hash) return recent;
+    }
+    lRecentBlocks.push_front(block);
+    if (lRecentBlocks.size() > RECENT_BLOCKS_CACHE_SIZE)
+        lRecentBlocks.pop_back();
+    return block;
+}
+
 } // anon namespace
 
 namespace
@@ -214,6 +285,12 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Length of current-streak of unconnecting headers announcements
+    int nUnconnectingHeaders;
+    //! Whether this peer wants new blocks announced with a cmpctblock message.
+    bool fPreferHeaderAndIDs;
+    //! Whether this peer can give us compact blocks (it sent us a sendcmpct of our version).
+    bool fProvidesHeaderAndIDs;
 
     CNodeBlocks nodeBlocks;
 
@@ -228,6 +305,9 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        nUnconnectingHeaders = 0;
+        fPreferHeaderAndIDs = false;
+        fProvidesHeaderAndIDs = false;
     }
 };
 
@@ -289,7 +369,8 @@ void MarkBlockAsReceived(const uint256& hash)
 }
 
 // Requires cs_main.
-void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex* pindex = nullptr)
+void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex* pindex = nullptr,
+                         std::unique_ptr<PartiallyDownloadedBlock> partialBlock = nullptr)
 {
     CNodeState* state = State(nodeid);
     assert(state != nullptr);
@@ -297,9 +378,9 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex*
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL};
-    nQueuedValidatedHeaders += newentry.fValidatedHeaders;
-    std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
+    std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
+            {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL, std::move(partialBlock)});
+    nQueuedValidatedHeaders += it->fValidatedHeaders;
     state->nBlocksInFlight++;
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
 }
@@ -339,6 +420,136 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256& hash)
     }
 }
 
+/** Whether the peer answers getheaders with headers, so blocks can be requested in parallel. */
+bool PeerSyncsHeaders(const CNode* pnode)
+{
+    return Params().HeadersFirstSyncingActive() && pnode->nVersion >= HEADERS_FIRST_VERSION;
+}
+
+// Requires cs_main
+bool CanDirectFetch()
+{
+    return chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().GetConsensus().nTargetSpacing * 20;
+}
+
+/**
+ * Ask a peer that just gave us a valid new block to announce the next ones with compact blocks.
+ * As per BIP152, at most MAX_CMPCTBLOCK_ANNOUNCERS peers do so: the one that was useful least
+ * recently is asked to go back to inv announcements. Requires cs_main.
+ */
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connman)
+{
+    CNodeState* nodestate = State(nodeid);
+    if (!nodestate || !nodestate->fProvidesHeaderAndIDs)
+        return;
+
+    for (std::list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); it++) {
+        if (*it == nodeid) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(nodeid);
+            return;
+        }
+    }
+    connman->ForNode(nodeid, [connman](CNode* pfrom) {
+        if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_ANNOUNCERS) {
+            connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman](CNode* pnodeStop) {
+                connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /* fAnnounceUsingCMPCTBLOCK */ false, CMPCTBLOCKS_VERSION));
+                return true;
+            });
+            lNodesAnnouncingHeaderAndIDs.pop_front();
+        }
+        connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /* fAnnounceUsingCMPCTBLOCK */ true, CMPCTBLOCKS_VERSION));
+        lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+        return true;
+    });
+}
+
+// Requires cs_main.
+void EraseBlockAwaitingParent(std::map<uint256, std::shared_ptr<const CBlock>>::iterator it)
+{
+    const std::shared_ptr<const CBlock>& pblock = it->second;
+    auto range = mapBlocksAwaitingParentByPrev.equal_range(pblock->hashPrevBlock);
+    for (auto itPrev = range.first; itPrev != range.second; ++itPrev) {
+        if (itPrev->second == it->first) {
+            mapBlocksAwaitingParentByPrev.erase(itPrev);
+            break;
+        }
+    }
+    nBlocksAwaitingParentSize -= ::GetSerializeSize(*pblock, PROTOCOL_VERSION);
+    mapBlocksAwaitingParent.erase(it);
+}
+
+/** Drop the blocks that can no longer be connected from here (they are re-requested if still needed). Requires cs_main. */
+void PruneBlocksAwaitingParent()
+{
+    for (auto it = mapBlocksAwaitingParent.begin(); it != mapBlocksAwaitingParent.end(); ) {
+        auto itCur = it++;
+        BlockMap::const_iterator mi = mapBlockIndex.find(itCur->first);
+        BlockMap::const_iterator miPrev = mapBlockIndex.find(itCur->second->hashPrevBlock);
+        if (mi == mapBlockIndex.end() || miPrev == mapBlockIndex.end() ||
+                (mi->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK)) ||
+                (miPrev->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK))) {
+            mapBlockSource.erase(itCur->first);
+            EraseBlockAwaitingParent(itCur);
+        }
+    }
+}
+
+/** Keep a block until the data of its parent is processed. Requires cs_main. */
+bool AddBlockAwaitingParent(const std::shared_ptr<const CBlock>& pblock)
+{
+    const uint256& hash = pblock->GetHash();
+    if (mapBlocksAwaitingParent.count(hash))
+        return true;
+
+    const size_t nSize = ::GetSerializeSize(*pblock, PROTOCOL_VERSION);
+    if (nBlocksAwaitingParentSize + nSize > MAX_BLOCKS_AWAITING_PARENT_SIZE) {
+        PruneBlocksAwaitingParent();
+        if (nBlocksAwaitingParentSize + nSize > MAX_BLOCKS_AWAITING_PARENT_SIZE)
+            return false;
+    }
+
+    mapBlocksAwaitingParent.emplace(hash, pblock);
+    mapBlocksAwaitingParentByPrev.emplace(pblock->hashPrevBlock, hash);
+    nBlocksAwaitingParentSize += nSize;
+    return true;
+}
+
+/** Process the blocks that were waiting for hashParent, and recursively their own children. */
+void ProcessBlocksAwaitingParent(const uint256& hashParent)
+{
+    AssertLockNotHeld(cs_main);
+
+    std::deque<uint256> queue;
+    queue.push_back(hashParent);
+    while (!queue.empty()) {
+        const uint256 head = queue.front();
+        queue.pop_front();
+
+        std::vector<std::shared_ptr<const CBlock>> vChildren;
+        {
+            LOCK(cs_main);
+            BlockMap::const_iterator mi = mapBlockIndex.find(head);
+            if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA))
+                continue;
+            auto range = mapBlocksAwaitingParentByPrev.equal_range(head);
+            for (auto it = range.first; it != range.second; ++it) {
+                auto itBlock = mapBlocksAwaitingParent.find(it->second);
+                if (itBlock != mapBlocksAwaitingParent.end())
+                    vChildren.push_back(itBlock->second);
+            }
+            for (const auto& pblock : vChildren)
+                EraseBlockAwaitingParent(mapBlocksAwaitingParent.find(pblock->GetHash()));
+        }
+
+        for (const auto& pblock : vChildren) {
+            LogPrint(BCLog::NET, "%s: processing block %s received ahead of its parent\n", __func__, pblock->GetHash().ToString());
+            ProcessNewBlock(pblock, nullptr);
+            queue.push_back(pblock->GetHash());
+        }
+    }
+}
+
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
  *  at most count entries. */
 void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller)
@@ -401,6 +612,9 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             if (pindex->nStatus & BLOCK_HAVE_DATA) {
                 if (pindex->nChainTx)
                     state->pindexLastCommonBlock = pindex;
+            } else if (mapBlocksAwaitingParent.count(pindex->GetBlockHash())) {
+                // Already downloaded, waiting for the data of its parent.
+                continue;
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
                 if (pindex->nHeight > nWindowEnd) {
@@ -454,6 +668,7 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
     mapNodeState.erase(nodeid);
 }
@@ -663,6 +878,21 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn) :
 
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
 {
+    // Keep the serialized block, for the peers that will request it once it is announced,
+    // and its compact block, for the peers that want it announced with one
+    if (!IsInitialBlockDownload()) {
+        auto vBlock = std::make_shared<std::vector<unsigned char>>();
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, *vBlock, 0, *pblock};
+        AddRecentBlock(pindex->GetBlockHash(), std::move(vBlock));
+
+        auto vCmpctBlock = std::make_shared<std::vector<unsigned char>>();
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, *vCmpctBlock, 0, CBlockHeaderAndShortTxIDs(*pblock)};
+        const uint256 hashPayload = Hash(vCmpctBlock->begin(), vCmpctBlock->end());
+        LOCK(cs_recentBlocks);
+        pMostRecentBlock = pblock;
+        recentCompactBlock = {pindex->GetBlockHash(), std::move(vCmpctBlock), hashPayload};
+    }
+
     LOCK(g_cs_orphans);
 
     std::vector<uint256> vOrphanErase;
@@ -699,11 +929,36 @@ void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex* pindexNew, const CB
 
     if (!fInitialDownload) {
         const uint256& hashNewTip = pindexNew->GetBlockHash();
+        // When the tip moved by a single block, the peers that asked for it get its compact block
+        // right away instead of an inv, saving the getdata round-trip and most of the block data.
+        CRecentBlock cmpctblock;
+        if (pindexFork == pindexNew->pprev) {
+            LOCK(cs_recentBlocks);
+            if (recentCompactBlock.hash == hashNewTip)
+                cmpctblock = recentCompactBlock;
+        }
+
+        LOCK(cs_main);
         // Relay inventory, but don't relay old inventory during initial block download.
-        connman->ForEachNode([nNewHeight, hashNewTip](CNode* pnode) {
-            if (nNewHeight > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : 0)) {
-                pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+        connman->ForEachNode([this, nNewHeight, hashNewTip, pindexNew, &cmpctblock](CNode* pnode) {
+            AssertLockHeld(cs_main);
+            if (nNewHeight <= (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : 0))
+                return;
+            CNodeState* state = State(pnode->GetId());
+            if (cmpctblock.payload && state && state->fPreferHeaderAndIDs) {
+                ProcessBlockAvailability(pnode->GetId());
+                if (state->pindexBestKnownBlock && state->pindexBestKnownBlock->GetAncestor(nNewHeight) == pindexNew)
+                    return; // The peer already has it
+                LogPrint(BCLog::NET, "%s sending cmpctblock %s to peer=%d\n", __func__, hashNewTip.ToString(), pnode->GetId());
+                CSerializedNetMsg msg;
+                msg.command = NetMsgType::CMPCTBLOCK;
+                msg.sharedData = cmpctblock.payload;
+                msg.hashPayload = cmpctblock.hashPayload;
+                connman->PushMessage(pnode, std::move(msg));
+                pnode->AddInventoryKnown(CInv(MSG_BLOCK, hashNewTip));
+                return;
             }
+            pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
         });
     }
 
@@ -728,6 +983,11 @@ void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationSta
             // Spam filter
             CheckBlockSpam(it->second, block.GetHash());
         }
+    } else if (state.IsValid() && it != mapBlockSource.end() && !IsInitialBlockDownload() &&
+               mapBlocksInFlight.count(hash) == mapBlocksInFlight.size()) {
+        // A peer gave us a new valid block, and we are not downloading anything else: it is a
+        // good source of new blocks, ask it to announce them with compact blocks.
+        MaybeSetPeerAsAnnouncingHeaderAndIDs(it->second, connman);
     }
 
     if (it != mapBlockSource.end())
@@ -961,14 +1221,37 @@ void static ProcessGetBlockData(CNode* pfrom, const CInv& inv, CConnman* connman
     }
     // Don't send not-validated blocks
     if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-        // Send block from disk
-        CBlock block;
-        if (!ReadBlockFromDisk(block, (*mi).second))
-            assert(!"cannot load block from disk");
-        if (inv.type == MSG_BLOCK)
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, block));
-        else // MSG_FILTERED_BLOCK)
+        CRecentBlock recentBlock;
+        const bool fRecent = GetRecentBlock(inv.hash, recentBlock);
+        if (inv.type == MSG_BLOCK) {
+            if (!fRecent) {
+                // Send the block as stored on disk, the on-wire serialization, without deserializing it
+                auto vBlock = std::make_shared<std::vector<unsigned char>>();
+                if (!ReadRawBlockFromDisk(*vBlock, (*mi).second))
+                    assert(!"cannot load block from disk");
+                // Only the blocks near the tip are worth caching: a peer syncing
+                // historic blocks would otherwise evict the new ones.
+                if (chainActive.Height() - mi->second->nHeight < (int)RECENT_BLOCKS_CACHE_SIZE) {
+                    recentBlock = AddRecentBlock(inv.hash, std::move(vBlock));
+                } else {
+                    recentBlock.hash = inv.hash;
+                    recentBlock.payload = std::move(vBlock);
+                }
+            }
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            msg.sharedData = recentBlock.payload;
+            msg.hashPayload = recentBlock.hashPayload;
+            connman->PushMessage(pfrom, std::move(msg));
+        } else // MSG_FILTERED_BLOCK)
         {
+            CBlock block;
+            if (fRecent) {
+                CDataStream ssBlock(*recentBlock.payload, SER_NETWORK, PROTOCOL_VERSION);
+                ssBlock >> block;
+            } else if (!ReadBlockFromDisk(block, (*mi).second)) {
+                assert(!"cannot load block from disk");
+            }
             bool send_ = false;
             CMerkleBlock merkleBlock;
             {
@@ -1088,6 +1371,91 @@ void static ProcessGetData(CNode* pfrom, CConnman* connman, const std::atomic<bo
     }
 }
 
+/** Process a block received from a peer, in full or reconstructed from a compact block. */
+void static ProcessBlockFromPeer(CNode* pfrom, const std::shared_ptr<CBlock>& pblock, CConnman* connman)
+{
+    CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    const uint256& hashBlock = pblock->GetHash();
+    CInv inv(MSG_BLOCK, hashBlock);
+    LogPrint(BCLog::NET, "received block %s peer=%d\n", inv.hash.ToString(), pfrom->GetId());
+
+    bool fParentKnown = false;
+    bool fParentHaveData = false;
+    bool fHeaderKnown = false;
+    bool fHaveData = false;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator miPrev = mapBlockIndex.find(pblock->hashPrevBlock);
+        fParentKnown = miPrev != mapBlockIndex.end();
+        fParentHaveData = fParentKnown && (miPrev->second->nStatus & BLOCK_HAVE_DATA);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hashBlock);
+        fHeaderKnown = mi != mapBlockIndex.end();
+        fHaveData = fHeaderKnown && (mi->second->nStatus & BLOCK_HAVE_DATA);
+    }
+
+    // sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
+    if (!fParentKnown) {
+        if (PeerSyncsHeaders(pfrom)) {
+            // fetch the missing headers, the blocks will then be downloaded in parallel
+            CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(pindexBestHeader););
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, locator, hashBlock));
+            return;
+        }
+        CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(););
+        if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
+            // we already asked for this block, so lets work backwards and ask for the previous block
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, pblock->hashPrevBlock));
+            pfrom->vBlockRequested.emplace_back(pblock->hashPrevBlock);
+        } else {
+            // ask to sync to this block
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, hashBlock));
+            pfrom->vBlockRequested.emplace_back(hashBlock);
+        }
+    } else {
+        pfrom->AddInventoryKnown(inv);
+        if (!fHaveData) {
+            {
+                LOCK(cs_main);
+                MarkBlockAsReceived(hashBlock);
+                if (!fParentHaveData) {
+                    // Downloaded in parallel ahead of its parent: keep it (only if we asked
+                    // for it, i.e. its header is known) until the parent is processed.
+                    if (fHeaderKnown && AddBlockAwaitingParent(pblock)) {
+                        mapBlockSource.emplace(hashBlock, pfrom->GetId());
+                        LogPrint(BCLog::NET, "%s : block %s received ahead of its parent %s\n", __func__, hashBlock.GetHex(), pblock->hashPrevBlock.GetHex());
+                    }
+                    return;
+                }
+                mapBlockSource.emplace(hashBlock, pfrom->GetId());
+            }
+            ProcessNewBlock(pblock, nullptr);
+
+            // Process the blocks that were waiting for this one
+            ProcessBlocksAwaitingParent(hashBlock);
+
+            // Disconnect node if its running an old protocol version,
+            // used during upgrades, when the node is already connected.
+            pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol());
+        } else {
+            LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, pblock->GetHash().GetHex());
+        }
+    }
+}
+
+void static SendBlockTransactions(CNode* pfrom, const CBlock& block, const BlockTransactionsRequest& req, CConnman* connman)
+{
+    BlockTransactions resp(req);
+    for (size_t i = 0; i < req.indexes.size(); i++) {
+        if (req.indexes[i] >= block.vtx.size()) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100, "getblocktxn with out-of-bounds tx indices");
+            return;
+        }
+        resp.txn[i] = block.vtx[req.indexes[i]];
+    }
+    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::BLOCKTXN, resp));
+}
+
 bool fRequestedSporksIDB = false;
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman* connman, std::atomic<bool>& interruptMsgProc)
 {
@@ -1289,6 +1657,12 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LogPrintf("New outbound peer connected: version: %d, blocks=%d, peer=%d%s\n",
                   pfrom->nVersion.load(), pfrom->nStartingHeight, pfrom->GetId(),
                   (fLogIPs ? strprintf(", peeraddr=%s", pfrom->addr.ToString()) : ""));
+
+        if (pfrom->nVersion >= COMPACT_BLOCKS_VERSION) {
+            // Tell our peer we can give it compact blocks. We only ask it to announce new blocks
+            // with them once it gave us a good block (see BlockChecked).
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, /* fAnnounceUsingCMPCTBLOCK */ false, CMPCTBLOCKS_VERSION));
+        }
     }
 
 
@@ -1345,6 +1719,18 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             return true;
     }
 
+    else if (strCommand == NetMsgType::SENDCMPCT) {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION) {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            nodestate->fProvidesHeaderAndIDs = true;
+            nodestate->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
     else if (strCommand == NetMsgType::INV) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -1378,9 +1764,22 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
-                    LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->GetId());
+                    if (PeerSyncsHeaders(pfrom)) {
+                        // First request the headers preceding the announced block. In the normal case, this
+                        // results in the headers of the last few blocks, which are then downloaded in parallel.
+                        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), inv.hash));
+                        LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->GetId());
+                        CNodeState* nodestate = State(pfrom->GetId());
+                        if (CanDirectFetch() && nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                            // Near the tip, also fetch the announced block right away
+                            vToFetch.push_back(inv);
+                            MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                        }
+                    } else {
+                        // Add this to the list of blocks to request
+                        vToFetch.push_back(inv);
+                        LogPrint(BCLog::NET, "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->GetId());
+                    }
                 }
             } else {
                 // Allowed inv request types while we are in IBD
@@ -1425,7 +1824,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::GETBLOCKS || strCommand == NetMsgType::GETHEADERS) {
+    else if (strCommand == NetMsgType::GETBLOCKS || (strCommand == NetMsgType::GETHEADERS && !Params().HeadersFirstSyncingActive())) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -1463,7 +1862,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && Params().HeadersFirstSyncingActive()) {
+    else if (strCommand == NetMsgType::GETHEADERS && Params().HeadersFirstSyncingActive()) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -1496,7 +1895,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
-        LogPrintf("getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->GetId());
+        LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->GetId());
         for (; pindex; pindex = chainActive.Next(pindex)) {
             vHeaders.push_back(pindex->GetBlockHeader());
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
@@ -1668,85 +2067,241 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
-        LOCK(cs_main);
-
         if (nCount == 0) {
             // Nothing interesting. Stop asking this peers for more headers.
             return true;
         }
-        CBlockIndex* pindexLast = NULL;
+
+        {
+            LOCK(cs_main);
+            CNodeState* nodestate = State(pfrom->GetId());
+            if (mapBlockIndex.find(headers[0].hashPrevBlock) == mapBlockIndex.end()) {
+                // The headers do not connect to anything we know (e.g. a peer reorganized);
+                // ask for the ones in between, and only punish repeated failures.
+                nodestate->nUnconnectingHeaders++;
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), UINT256_ZERO));
+                LogPrint(BCLog::NET, "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
+                        headers[0].GetHash().ToString(),
+                        headers[0].hashPrevBlock.ToString(),
+                        pindexBestHeader->nHeight,
+                        pfrom->GetId(), nodestate->nUnconnectingHeaders);
+                if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0) {
+                    Misbehaving(pfrom->GetId(), 20, strprintf("%d non-connecting headers", nodestate->nUnconnectingHeaders));
+                }
+                return true;
+            }
+        }
+
+        uint256 hashLastBlock;
         for (const CBlockHeader& header : headers) {
-            CValidationState state;
-            if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
+            if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
+                LOCK(cs_main);
                 Misbehaving(pfrom->GetId(), 20, "non-continuous headers sequence");
                 return false;
             }
+            hashLastBlock = header.GetHash();
+        }
 
-            /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-             * before headers are reimplemented on mainnet
-             */
-            if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
-                int nDoS;
-                if (state.IsInvalid(nDoS)) {
-                    if (nDoS > 0) {
-                        Misbehaving(pfrom->GetId(), nDoS, "invalid header received");
-                    } else {
-                        LogPrint(BCLog::NET, "peer=%d: invalid header received\n", pfrom->GetId());
-                    }
-                    return false;
+        CValidationState state;
+        CBlockIndex* pindexLast = nullptr;
+        if (!ProcessNewBlockHeaders(headers, state, &pindexLast)) {
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                LOCK(cs_main);
+                if (nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS, "invalid header received");
+                } else {
+                    LogPrint(BCLog::NET, "peer=%d: invalid header received\n", pfrom->GetId());
                 }
+                return false;
             }
         }
 
+        LOCK(cs_main);
+        State(pfrom->GetId())->nUnconnectingHeaders = 0;
+
         if (pindexLast)
             UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
         if (nCount == MAX_HEADERS_RESULTS && pindexLast) {
             // Headers message had its maximum size; the peer may have more headers.
-            // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
-            // from there instead.
-            LogPrintf("more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->GetId(), pfrom->nStartingHeight);
+            LogPrint(BCLog::NET, "more getheaders (%d) to end to peer=%d (startheight:%d)\n", pindexLast->nHeight, pfrom->GetId(), pfrom->nStartingHeight);
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexLast), UINT256_ZERO));
         }
     }
 
-    else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    else if (strCommand == NetMsgType::GETBLOCKTXN) {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        std::shared_ptr<const CBlock> pblock;
+        {
+            LOCK(cs_recentBlocks);
+            if (pMostRecentBlock && pMostRecentBlock->GetHash() == req.blockhash)
+                pblock = pMostRecentBlock;
+        }
+        if (!pblock) {
+            LOCK(cs_main);
+            BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+            if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->GetId());
+                return true;
+            }
+            if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+                // Answer requests for old blocks with the full block: a peer could otherwise make
+                // us read many blocks from disk by sending cheap getblocktxn messages.
+                LogPrint(BCLog::NET, "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->GetId(), MAX_BLOCKTXN_DEPTH);
+                pfrom->vRecvGetData.emplace_back(MSG_BLOCK, req.blockhash);
+                // The message processing loop will go around again (without pausing) and we'll respond then
+                return true;
+            }
+            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockRead, it->second))
+                assert(!"cannot load block from disk");
+            pblock = pblockRead;
+        }
+        SendBlockTransactions(pfrom, *pblock, req, connman);
+    }
+
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
-        const uint256& hashBlock = pblock->GetHash();
-        CInv inv(MSG_BLOCK, hashBlock);
-        LogPrint(BCLog::NET, "received block %s peer=%d\n", inv.hash.ToString(), pfrom->GetId());
-
-        // sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(pblock->hashPrevBlock)) {
-            CBlockLocator locator = WITH_LOCK(cs_main, return chainActive.GetLocator(););
-            if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
-                // we already asked for this block, so lets work backwards and ask for the previous block
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, pblock->hashPrevBlock));
-                pfrom->vBlockRequested.emplace_back(pblock->hashPrevBlock);
-            } else {
-                // ask to sync to this block
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKS, locator, hashBlock));
-                pfrom->vBlockRequested.emplace_back(hashBlock);
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        const uint256 hashBlock = cmpctblock.header.GetHash();
+        LogPrint(BCLog::NET, "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->GetId());
+
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(cmpctblock.header.hashPrevBlock);
+            if (mi == mapBlockIndex.end()) {
+                // The block doesn't connect to anything we know: request the headers in between
+                if (!IsInitialBlockDownload())
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), UINT256_ZERO));
+                return true;
             }
-        } else {
-            pfrom->AddInventoryKnown(inv);
-            if (!mapBlockIndex.count(hashBlock)) {
-                {
-                    LOCK(cs_main);
-                    MarkBlockAsReceived(hashBlock);
-                    mapBlockSource.emplace(hashBlock, pfrom->GetId());
+            // After the PoS upgrade a header carries no proof until its block is checked, so only
+            // the header of a block that would extend our best chain is added to the block index.
+            const CBlockIndex* pindexPrev = mi->second;
+            if (!(pindexPrev->nStatus & BLOCK_HAVE_DATA) || pindexPrev->nChainWork < chainActive.Tip()->nChainWork) {
+                LogPrint(BCLog::NET, "peer=%d: ignoring cmpctblock %s not extending our best chain\n", pfrom->GetId(), hashBlock.ToString());
+                return true;
+            }
+        }
+
+        CValidationState state;
+        CBlockIndex* pindex = nullptr;
+        if (!ProcessNewBlockHeaders({cmpctblock.header}, state, &pindex)) {
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                LOCK(cs_main);
+                if (nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS, "invalid header received via cmpctblock");
+                } else {
+                    LogPrint(BCLog::NET, "peer=%d: invalid header received via cmpctblock\n", pfrom->GetId());
                 }
-                ProcessNewBlock(pblock, nullptr);
+            }
+            return true;
+        }
 
-                // Disconnect node if its running an old protocol version,
-                // used during upgrades, when the node is already connected.
-                pfrom->DisconnectOldProtocol(pfrom->nVersion, ActiveProtocol());
-            } else {
-                LogPrint(BCLog::NET, "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, pblock->GetHash().GetHex());
+        std::shared_ptr<CBlock> pblock;
+        {
+            LOCK(cs_main);
+            assert(pindex);
+            UpdateBlockAvailability(pfrom->GetId(), hashBlock);
+            pfrom->AddInventoryKnown(CInv(MSG_BLOCK, hashBlock));
+
+            // Nothing to do if we already have the block, or if it would not become our new tip
+            if ((pindex->nStatus & BLOCK_HAVE_DATA) || mapBlocksAwaitingParent.count(hashBlock))
+                return true;
+            if (pindex->nChainWork <= chainActive.Tip()->nChainWork)
+                return true;
+
+            auto itInFlight = mapBlocksInFlight.find(hashBlock);
+            const bool fInFlightFromPeer = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            if (fInFlightFromPeer && itInFlight->second.second->partialBlock) {
+                // Already waiting for the blocktxn of this block
+                return true;
+            }
+            // Reconstruct the block from our mempool and orphan pool
+            std::unique_ptr<PartiallyDownloadedBlock> partialBlock(new PartiallyDownloadedBlock(&mempool));
+            std::vector<std::pair<uint256, CTransactionRef>> vExtraTxn;
+            {
+                LOCK(g_cs_orphans);
+                vExtraTxn.reserve(mapOrphanTransactions.size());
+                for (const auto& orphan : mapOrphanTransactions)
+                    vExtraTxn.emplace_back(orphan.first, orphan.second.tx);
+            }
+            ReadStatus status = partialBlock->InitData(cmpctblock, vExtraTxn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(hashBlock); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100, "invalid compact block");
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            if (status == READ_STATUS_OK) {
+                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                    if (!partialBlock->IsTxAvailable(i))
+                        req.indexes.push_back(i);
+                }
+                if (req.indexes.empty()) {
+                    pblock = std::make_shared<CBlock>();
+                    status = partialBlock->FillBlock(*pblock, {});
+                }
+            }
+            if (status != READ_STATUS_OK) {
+                // Short id collision, or a block that doesn't match its merkle root: request it in full
+                MarkBlockAsInFlight(pfrom->GetId(), hashBlock, pindex);
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, std::vector<CInv>{CInv(MSG_BLOCK, hashBlock)}));
+                return true;
+            }
+            if (!pblock) {
+                // Ask for the transactions we don't have
+                req.blockhash = hashBlock;
+                MarkBlockAsInFlight(pfrom->GetId(), hashBlock, pindex, std::move(partialBlock));
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+                return true;
+            }
+        }
+        ProcessBlockFromPeer(pfrom, pblock, connman);
+    }
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        {
+            LOCK(cs_main);
+            auto itInFlight = mapBlocksInFlight.find(resp.blockhash);
+            if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId() ||
+                    !itInFlight->second.second->partialBlock) {
+                LogPrint(BCLog::NET, "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->GetId());
+                return true;
+            }
+
+            const CBlockIndex* pindex = itInFlight->second.second->pindex;
+            ReadStatus status = itInFlight->second.second->partialBlock->FillBlock(*pblock, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100, "invalid compact block/non-matching block transactions");
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now :(
+                MarkBlockAsInFlight(pfrom->GetId(), resp.blockhash, pindex);
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETDATA, std::vector<CInv>{CInv(MSG_BLOCK, resp.blockhash)}));
+                return true;
             }
         }
+        ProcessBlockFromPeer(pfrom, pblock, connman);
+    }
+
+    else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        vRecv >> *pblock;
+        ProcessBlockFromPeer(pfrom, pblock, connman);
     }
 
     // This asymmetric behavior for inbound and outbound connections was introduced
@@ -1914,6 +2469,11 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         if (std::find(allMessages.begin(), allMessages.end(), strCommand) != allMessages.end()) {
             // Check if the dispatcher can process this message first. If not, try going with the old flow.
             if (!masternodeSync.MessageDispatcher(pfrom, strCommand, vRecv)) {
+                // Pings, votes and winners have their signature verified ahead on the worker pool
+                if (g_tiertwo_sigverifier && CTierTwoSigVerifier::IsVerifiedAhead(strCommand) &&
+                    g_tiertwo_sigverifier->Push(pfrom, strCommand, vRecv)) {
+                    return true;
+                }
                 // Probably one the extensions
                 mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
                 g_budgetman.ProcessMessage(pfrom, strCommand, vRecv);
@@ -1930,6 +2490,28 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 }
 
 
+// Log the exception being handled, thrown while processing a message
+static void LogProcessMessageException(const std::string& strCommand, unsigned int nMessageSize)
+{
+    try {
+        throw;
+    } catch (const std::ios_base::failure& e) {
+        if (strstr(e.what(), "end of data")) {
+            // Allow exceptions from under-length message on vRecv
+            LogPrint(BCLog::NET, "ProcessMessages(%s, %u bytes): Exception '%s' caught, normally caused by a message being shorter than its stated length\n", SanitizeString(strCommand), nMessageSize, e.what());
+        } else if (strstr(e.what(), "size too large")) {
+            // Allow exceptions from over-long size
+            LogPrint(BCLog::NET, "ProcessMessages(%s, %u bytes): Exception '%s' caught\n", SanitizeString(strCommand), nMessageSize, e.what());
+        } else {
+            PrintExceptionContinue(&e, "ProcessMessages()");
+        }
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ProcessMessages()");
+    } catch (...) {
+        PrintExceptionContinue(NULL, "ProcessMessages()");
+    }
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     // Message format
@@ -2006,20 +2588,8 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
             return false;
         if (!pfrom->vRecvGetData.empty())
             fMoreWork = true;
-    } catch (const std::ios_base::failure& e) {
-        if (strstr(e.what(), "end of data")) {
-            // Allow exceptions from under-length message on vRecv
-            LogPrint(BCLog::NET, "ProcessMessages(%s, %u bytes): Exception '%s' caught, normally caused by a message being shorter than its stated length\n", SanitizeString(strCommand), nMessageSize, e.what());
-        } else if (strstr(e.what(), "size too large")) {
-            // Allow exceptions from over-long size
-            LogPrint(BCLog::NET, "ProcessMessages(%s, %u bytes): Exception '%s' caught\n", SanitizeString(strCommand), nMessageSize, e.what());
-        } else {
-            PrintExceptionContinue(&e, "ProcessMessages()");
-        }
-    } catch (const std::exception& e) {
-        PrintExceptionContinue(&e, "ProcessMessages()");
     } catch (...) {
-        PrintExceptionContinue(NULL, "ProcessMessages()");
+        LogProcessMessageException(strCommand, nMessageSize);
     }
 
     if (!fRet)
@@ -2028,6 +2598,19 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     return fMoreWork;
 }
 
+void ProcessTierTwoMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
+{
+    const unsigned int nMessageSize = vRecv.size();
+    try {
+        mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+        g_budgetman.ProcessMessage(pfrom, strCommand, vRecv);
+        masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
+    } catch (...) {
+        LogProcessMessageException(strCommand, nMessageSize);
+        LogPrint(BCLog::NET, "ProcessMessage(%s, %u bytes) FAILED peer=%d\n", SanitizeString(strCommand), nMessageSize, pfrom->GetId());
+    }
+}
+
 class CompareInvMempoolOrder
 {
     CTxMemPool *mp;
@@ -2153,10 +2736,14 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
             if ((nSyncStarted == 0 && fFetch) || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
                 state.fSyncStarted = true;
                 nSyncStarted++;
-                //CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-                //LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->GetId(), pto->nStartingHeight);
-                //pto->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO);
-                connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                if (PeerSyncsHeaders(pto)) {
+                    // Headers first; the blocks are then fetched in parallel by FindNextBlocksToDownload.
+                    const CBlockIndex* pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+                    LogPrint(BCLog::NET, "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->GetId(), pto->nStartingHeight);
+                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexStart), UINT256_ZERO));
+                } else {
+                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETBLOCKS, chainActive.GetLocator(chainActive.Tip()), UINT256_ZERO));
+                }
             }
         }
 
@@ -2317,7 +2904,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
             for (const CBlockIndex* pindex : vToDownload) {
                 vGetData.emplace_back(MSG_BLOCK, pindex->GetBlockHash());
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), pindex);
-                LogPrintf("Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
+                LogPrint(BCLog::NET, "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->GetId());
             }
             if (state.nBlocksInFlight == 0 && staller != -1) {
@@ -26,6 +26,9 @@ static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_SIZE = 100;
 /** Default for -blockspamfiltermaxavg, maximum average size of an index occurrence in the block spam filter */
 static const unsigned int DEFAULT_BLOCK_SPAM_FILTER_MAX_AVG = 10;
 
+/** Number of serialized blocks kept in memory to serve getdata requests without reading the block files */
+static const unsigned int RECENT_BLOCKS_CACHE_SIZE = 8;
+
 /** Average delay between trickled inventory transmissions in seconds.
  *  Blocks and whitelisted receivers bypass this, outbound peers get half this delay. */
 static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
@@ -69,6 +72,8 @@ struct CNodeStateStats {
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats);
+/** Process a tier two message queued by the CTierTwoSigVerifier, handling its errors like ProcessMessages */
+void ProcessTierTwoMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="") EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
@@ -20,6 +20,8 @@
 
 extern int nConnectTimeout;
 extern bool fNameLookup;
+//! Reject sockets that select() can't watch (fd >= FD_SETSIZE). Cleared when the socket handlers use epoll.
+extern bool fSelectableSocketsOnly;
 
 /** -timeout default */
 static const int DEFAULT_CONNECT_TIMEOUT = 5000;
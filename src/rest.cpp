@@ -8,6 +8,7 @@
 #include "core_io.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "httprpc.h"
 #include "httpserver.h"
 #include "rpc/server.h"
 #include "streams.h"
@@ -57,9 +58,9 @@ struct CCoin {
 };
 
 extern void TxToJSON(CWallet* const pwallet, const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
-extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(JSONWriter& writer, bool fVerbose = false);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string message)
@@ -69,6 +70,29 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/** Reply with the JSON document written by fn, streamed if it's large */
+static bool WriteJSONReply(HTTPRequest* req, const std::function<void(JSONWriter&)>& fn)
+{
+    HTTPJSONWriter writer(req);
+    std::string strError;
+    try {
+        fn(writer);
+        writer.Finish();
+        return true;
+    } catch (const UniValue& objError) {
+        strError = find_value(objError, "message").get_str();
+    } catch (const std::exception& e) {
+        strError = e.what();
+    }
+    if (!writer.HasSentOutput()) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, strError);
+    }
+    // Too late for an error reply
+    LogPrintf("%s: %s reply interrupted: %s\n", __func__, req->GetURI(), strError);
+    writer.Finish();
+    return false;
+}
+
 static enum RetFormat ParseDataFormat(std::vector<std::string>& params, const std::string& strReq)
 {
     boost::split(params, strReq, boost::is_any_of("."));
@@ -224,11 +248,7 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, [&](JSONWriter& writer) { blockToJSON(writer, block, pblockindex, showTxDetails); });
     }
 
     default: {
@@ -304,12 +324,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, [](JSONWriter& writer) { mempoolToJSON(writer, true); });
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
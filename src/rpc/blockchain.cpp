@@ -16,6 +16,7 @@
 #include "masternodeman.h"
 #include "policy/feerate.h"
 #include "policy/policy.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "sync.h"
 #include "txdb.h"
@@ -128,60 +129,72 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+void blockToJSON(JSONWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", block.GetHash().GetHex());
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    result.pushKV("finalsaplingroot", block.hashFinalSaplingRoot.GetHex());
-    UniValue txs(UniValue::VARR);
+    // The fields before and after the transactions, read first so that cs_main
+    // isn't held while the transactions are written
+    UniValue head(UniValue::VOBJ);
+    UniValue tail(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        head.pushKV("hash", block.GetHash().GetHex());
+        int confirmations = -1;
+        // Only report confirmations if the block is on the main chain
+        if (chainActive.Contains(blockindex))
+            confirmations = chainActive.Height() - blockindex->nHeight + 1;
+        head.pushKV("confirmations", confirmations);
+        head.pushKV("size", (int)::GetSerializeSize(block, PROTOCOL_VERSION));
+        head.pushKV("height", blockindex->nHeight);
+        head.pushKV("version", block.nVersion);
+        head.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+        head.pushKV("finalsaplingroot", block.hashFinalSaplingRoot.GetHex());
+
+        tail.pushKV("time", block.GetBlockTime());
+        tail.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+        tail.pushKV("nonce", (uint64_t)block.nNonce);
+        tail.pushKV("bits", strprintf("%08x", block.nBits));
+        tail.pushKV("difficulty", GetDifficulty(blockindex));
+        tail.pushKV("chainwork", blockindex->nChainWork.GetHex());
+
+        if (blockindex->pprev)
+            tail.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+        CBlockIndex* pnext = chainActive.Next(blockindex);
+        if (pnext)
+            tail.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+
+        //////////
+        ////////// Coin stake data ////////////////
+        /////////
+        if (block.IsProofOfStake()) {
+            uint256 hashProofOfStakeRet{UINT256_ZERO};
+            if (blockindex->pprev && !GetStakeKernelHash(hashProofOfStakeRet, block, blockindex->pprev))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot get proof of stake hash");
+
+            std::string stakeModifier = (Params().GetConsensus().NetworkUpgradeActive(blockindex->nHeight, Consensus::UPGRADE_V4_0) ?
+                                         blockindex->GetStakeModifierV2().GetHex() :
+                                         strprintf("%016x", blockindex->GetStakeModifierV1()));
+            tail.pushKV("stakeModifier", stakeModifier);
+            tail.pushKV("hashProofOfStake", hashProofOfStakeRet.GetHex());
+        }
+    }
+
+    writer.BeginObject();
+    writer.KeyValues(head);
+    writer.Key("tx");
+    writer.BeginArray();
     for (const auto& txIn : block.vtx) {
         const CTransaction& tx = *txIn;
         if (txDetails) {
             UniValue objTx(UniValue::VOBJ);
             TxToJSON(nullptr, tx, UINT256_ZERO, objTx);
-            txs.push_back(objTx);
+            writer.Value(objTx);
+            writer.Flush();
         } else
-            txs.push_back(tx.GetHash().GetHex());
-    }
-    result.pushKV("tx", txs);
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-
-    if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex* pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
-
-    //////////
-    ////////// Coin stake data ////////////////
-    /////////
-    if (block.IsProofOfStake()) {
-        uint256 hashProofOfStakeRet{UINT256_ZERO};
-        if (blockindex->pprev && !GetStakeKernelHash(hashProofOfStakeRet, block, blockindex->pprev))
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot get proof of stake hash");
-
-        std::string stakeModifier = (Params().GetConsensus().NetworkUpgradeActive(blockindex->nHeight, Consensus::UPGRADE_V4_0) ?
-                                     blockindex->GetStakeModifierV2().GetHex() :
-                                     strprintf("%016x", blockindex->GetStakeModifierV1()));
-        result.pushKV("stakeModifier", stakeModifier);
-        result.pushKV("hashProofOfStake", hashProofOfStakeRet.GetHex());
+            writer.Value(tx.GetHash().GetHex());
     }
-
-    return result;
+    writer.EndArray();
+    writer.KeyValues(tail);
+    writer.EndObject();
 }
 
 UniValue getblockcount(const JSONRPCRequest& request)
@@ -434,27 +447,48 @@ static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.pushKV("depends", depends);
 }
 
-UniValue mempoolToJSON(bool fVerbose = false)
+/** Number of mempool entries written between the waits for the reader (without the mempool lock) */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 1000;
+
+void mempoolToJSON(JSONWriter& writer, bool fVerbose = false)
 {
     if (fVerbose) {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx) {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.pushKV(hash.ToString(), info);
+        // The entries are written in batches, releasing the mempool lock in between.
+        // The ones removed meanwhile are skipped.
+        std::vector<uint256> vtxid;
+        {
+            LOCK(mempool.cs);
+            vtxid.reserve(mempool.mapTx.size());
+            for (const CTxMemPoolEntry& e : mempool.mapTx) {
+                vtxid.push_back(e.GetTx().GetHash());
+            }
         }
-        return o;
+        writer.BeginObject();
+        for (size_t nBatchStart = 0; nBatchStart < vtxid.size(); nBatchStart += MEMPOOL_JSON_BATCH_SIZE) {
+            {
+                LOCK(mempool.cs);
+                const size_t nBatchEnd = std::min(vtxid.size(), nBatchStart + MEMPOOL_JSON_BATCH_SIZE);
+                for (size_t i = nBatchStart; i < nBatchEnd; i++) {
+                    const auto it = mempool.mapTx.find(vtxid[i]);
+                    if (it == mempool.mapTx.end()) continue;
+                    UniValue info(UniValue::VOBJ);
+                    entryToJSON(info, *it);
+                    writer.KeyValue(vtxid[i].ToString(), info);
+                }
+            }
+            writer.Flush();
+        }
+        writer.EndObject();
     } else {
         std::vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
-        for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+        writer.BeginArray();
+        for (size_t i = 0; i < vtxid.size(); i++) {
+            writer.Value(vtxid[i].ToString());
+            if ((i + 1) % MEMPOOL_JSON_BATCH_SIZE == 0) writer.Flush();
+        }
+        writer.EndArray();
     }
 }
 
@@ -483,13 +517,11 @@ UniValue getrawmempool(const JSONRPCRequest& request)
             "\nExamples\n" +
             HelpExampleCli("getrawmempool", "true") + HelpExampleRpc("getrawmempool", "true"));
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    return WriteRPCResult(request, [fVerbose](JSONWriter& writer) { mempoolToJSON(writer, fVerbose); });
 }
 
 UniValue getblockhash(const JSONRPCRequest& request)
@@ -562,8 +594,6 @@ UniValue getblock(const JSONRPCRequest& request)
             HelpExampleCli("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") +
             HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -571,14 +601,18 @@ UniValue getblock(const JSONRPCRequest& request)
     if (request.params.size() > 1)
         fVerbose = request.params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = nullptr;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    if (!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        pblockindex = mapBlockIndex[hash];
+
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    }
 
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -587,7 +621,7 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex);
+    return WriteRPCResult(request, [&](JSONWriter& writer) { blockToJSON(writer, block, pblockindex); });
 }
 
 UniValue getblockheader(const JSONRPCRequest& request)
@@ -633,6 +667,7 @@ UniValue getblockheader(const JSONRPCRequest& request)
     if (request.params.size() > 1)
         fVerbose = request.params[1].get_bool();
 
+    LOCK(cs_main);
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
@@ -1158,6 +1193,10 @@ UniValue mempoolInfoToJSON()
     size_t maxmempool = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    uint64_t nScriptCacheLookups, nScriptCacheHits;
+    GetScriptExecutionCacheStats(nScriptCacheLookups, nScriptCacheHits);
+    ret.pushKV("scriptcachelookups", nScriptCacheLookups);
+    ret.pushKV("scriptcachehits", nScriptCacheHits);
 
     return ret;
 }
@@ -1178,6 +1217,8 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"scriptcachelookups\": xxxxx  (numeric) Transactions looked up in the script execution cache while connecting blocks\n"
+            "  \"scriptcachehits\": xxxxx     (numeric) Of which found, because their scripts were executed when accepted to the mempool\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -1320,8 +1361,13 @@ UniValue getblockindexstats(const JSONRPCRequest& request) {
                 "  \"txbytes\": xxxxx                (numeric) Sum of the size of all txes over block range\n"
                 "  \"ttlfee\": xxxxx                 (numeric) Sum of the fee amount of all txes over block range\n"
                 "  \"feeperkb\": xxxxx               (numeric) Average fee per kb (excluding zc txes)\n"
+                "  \"shieldedvaluein\": xxxxx        (numeric) Sum of the value moved out of the shielded pool\n"
+                "  \"shieldedvalueout\": xxxxx       (numeric) Sum of the value moved into the shielded pool\n"
                 "}\n"
 
+                "\nNote: with -blockstatsindex the per-block data is read from the index (and missing\n"
+                "entries are added to it), otherwise each block is read from disk with its undo data.\n"
+
                 "\nExamples:\n" +
                 HelpExampleCli("getblockindexstats", "1200000 1000") +
                 HelpExampleRpc("getblockindexstats", "1200000, 1000"));
@@ -1333,54 +1379,49 @@ UniValue getblockindexstats(const JSONRPCRequest& request) {
     ret.pushKV("Starting block", heightStart);
     ret.pushKV("Ending block", heightEnd);
 
+    std::vector<const CBlockIndex*> vIndex;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = chainActive[heightEnd];
+        if (!pindex)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid block height");
+        vIndex.reserve(heightEnd - heightStart + 1);
+        for (; pindex && pindex->nHeight >= heightStart; pindex = pindex->pprev) {
+            vIndex.push_back(pindex);
+        }
+    }
+
+    // Entries of the stats index (keyed by height, so stale ones left by a reorg are skipped)
+    std::map<int, CDiskBlockStats> mapStats;
+    if (fBlockStatsIndex && !pblocktree->ReadBlockStats(heightStart, heightEnd, mapStats)) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read block stats index");
+    }
+
     CAmount nFees = 0;
     int64_t nBytes = 0;
     int64_t nTxCount = 0;
     int64_t nTxCount_all = 0;
-
-    const CBlockIndex* pindex = WITH_LOCK(cs_main, return chainActive[heightEnd]);
-    if (!pindex)
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid block height");
-
-    while (pindex && pindex->nHeight >= heightStart) {
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read block from disk");
-        }
-
-        CAmount nValueIn = 0;
-        CAmount nValueOut = 0;
-        const int ntx = block.vtx.size();
-        const int firstTxIndex = block.IsProofOfStake() ? 2 : 1;
-        nTxCount_all += ntx;
-        nTxCount = nTxCount + ntx - firstTxIndex;
-
-        // loop through each tx in block and save size and fee (except for coinbase/coinstake)
-        for (int idx = firstTxIndex; idx < ntx; idx++) {
-            const CTransaction& tx = *(block.vtx[idx]);
-
-            // Transaction size
-            nBytes += GetSerializeSize(tx, CLIENT_VERSION);
-
-            // Transparent inputs
-            for (unsigned int j = 0; j < tx.vin.size(); j++) {
-                COutPoint prevout = tx.vin[j].prevout;
-                CTransactionRef txPrev;
-                uint256 hashBlock;
-                if(!GetTransaction(prevout.hash, txPrev, hashBlock, true))
-                    throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read tx from disk");
-                nValueIn += txPrev->vout[prevout.n].nValue;
-            }
-            // Shield inputs
-            nValueIn += tx.GetShieldedValueIn();
-
-            // Tranparent/Shield outputs
-            nValueOut += tx.GetValueOut();
-
-            // update fee
-            nFees += nValueIn - nValueOut;
+    CAmount nShieldedValueIn = 0;
+    CAmount nShieldedValueOut = 0;
+
+    for (const CBlockIndex* pindex : vIndex) {
+        CDiskBlockStats stats;
+        auto it = mapStats.find(pindex->nHeight);
+        if (it != mapStats.end() && it->second.hashBlock == pindex->GetBlockHash()) {
+            stats = it->second;
+        } else {
+            if (!ReadBlockStatsFromDisk(pindex, stats))
+                throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read block from disk");
+            // fill the gap (blocks connected before the index was enabled)
+            if (fBlockStatsIndex && !pblocktree->WriteBlockStats(pindex->nHeight, stats))
+                throw JSONRPCError(RPC_DATABASE_ERROR, "failed to write block stats index");
         }
-        pindex = pindex->pprev;
+        nTxCount += stats.nTxCount;
+        nTxCount_all += stats.nTxCountAll;
+        nBytes += stats.nTxBytes;
+        nFees += stats.nFees;
+        nShieldedValueIn += stats.nShieldedValueIn;
+        nShieldedValueOut += stats.nShieldedValueOut;
     }
 
     // get fee rate
@@ -1392,6 +1433,8 @@ UniValue getblockindexstats(const JSONRPCRequest& request) {
     ret.pushKV("txbytes", (int64_t)nBytes);
     ret.pushKV("ttlfee", FormatMoney(nFees));
     ret.pushKV("feeperkb", FormatMoney(nFeeRate.GetFeePerK()));
+    ret.pushKV("shieldedvaluein", FormatMoney(nShieldedValueIn));
+    ret.pushKV("shieldedvalueout", FormatMoney(nShieldedValueOut));
 
     return ret;
 }
@@ -1438,23 +1481,23 @@ UniValue getfeeinfo(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafe argNames
+{ //  category              name                      actor (function)         okSafe argNames, okParallel
   //  --------------------- ------------------------  -----------------------  ------ --------
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {}, true },
     { "blockchain",         "getbestsaplinganchor",   &getbestsaplinganchor,   true,  {} },
-    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"} },
+    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbose"}, true },
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
-    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         false, {"blockhash","verbose"} },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  {}, true },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"}, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         false, {"blockhash","verbose"}, true },
     { "blockchain",         "getblockindexstats",     &getblockindexstats,     true,  {"height","range"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {}, true },
     { "blockchain",         "getfeeinfo",             &getfeeinfo,             true,  {"blocks"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,  {}, true },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"}, true },
     { "blockchain",         "getsupplyinfo",          &getsupplyinfo,          true,  {"force_update"} },
-    { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
+    { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"}, true },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"nblocks"} },
 
@@ -66,6 +66,8 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "getnetworkhashps", 0, "nblocks" },
     { "getnetworkhashps", 1, "height" },
     { "getnodeaddresses", 0, "count" },
+    { "getoperationresult", 0, "operationids" },
+    { "getoperationstatus", 0, "operationids" },
     { "getrawmempool", 0, "verbose" },
     { "getrawtransaction", 1, "verbose" },
     { "getreceivedbyaddress", 1, "minconf" },
@@ -156,6 +158,10 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "shieldsendmany", 2, "minconf" },
     { "shieldsendmany", 3, "fee" },
     { "shieldsendmany", 4, "subtract_fee_from" },
+    { "shieldsendmanyasync", 1, "amounts" },
+    { "shieldsendmanyasync", 2, "minconf" },
+    { "shieldsendmanyasync", 3, "fee" },
+    { "shieldsendmanyasync", 4, "subtract_fee_from" },
     { "signrawtransaction", 1, "prevtxs" },
     { "signrawtransaction", 2, "privkeys" },
     { "spork", 1, "value" },
@@ -0,0 +1,166 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <assert.h>
+
+void JSONWriter::KeyValues(const UniValue& obj)
+{
+    const std::vector<std::string>& keys = obj.getKeys();
+    const std::vector<UniValue>& values = obj.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        KeyValue(keys[i], values[i]);
+    }
+}
+
+void UniValueWriter::Push(const UniValue& value)
+{
+    if (vStack.empty()) {
+        result = value;
+    } else if (vStack.back().second.isObject()) {
+        // The keys are unique: skip the lookup of pushKV
+        vStack.back().second.__pushKV(strKey, value);
+    } else {
+        vStack.back().second.push_back(value);
+    }
+}
+
+void UniValueWriter::BeginObject()
+{
+    vStack.emplace_back(strKey, UniValue(UniValue::VOBJ));
+}
+
+void UniValueWriter::EndObject()
+{
+    assert(!vStack.empty() && vStack.back().second.isObject());
+    const UniValue value = std::move(vStack.back().second);
+    strKey = std::move(vStack.back().first);
+    vStack.pop_back();
+    Push(value);
+}
+
+void UniValueWriter::BeginArray()
+{
+    vStack.emplace_back(strKey, UniValue(UniValue::VARR));
+}
+
+void UniValueWriter::EndArray()
+{
+    assert(!vStack.empty() && vStack.back().second.isArray());
+    const UniValue value = std::move(vStack.back().second);
+    strKey = std::move(vStack.back().first);
+    vStack.pop_back();
+    Push(value);
+}
+
+void UniValueWriter::Key(const std::string& key)
+{
+    strKey = key;
+}
+
+void UniValueWriter::Value(const UniValue& value)
+{
+    Push(value);
+}
+
+JSONStreamWriter::JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn),
+    nChunkSize(nChunkSizeIn)
+{
+    strBuffer.reserve(nChunkSize);
+}
+
+void JSONStreamWriter::Separator()
+{
+    fEmpty = false;
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vFirst.empty()) {
+        if (!vFirst.back()) strBuffer += ',';
+        vFirst.back() = false;
+    }
+}
+
+void JSONStreamWriter::Written()
+{
+    if (strBuffer.size() >= nChunkSize) {
+        Send(false);
+    }
+}
+
+void JSONStreamWriter::Send(bool fWait)
+{
+    if (!strBuffer.empty()) {
+        fSentOutput = true;
+        fUnflushed = true;
+    }
+    if (fWait) fUnflushed = false;
+    std::string strChunk;
+    strChunk.reserve(nChunkSize);
+    strChunk.swap(strBuffer);
+    sink(std::move(strChunk), fWait);
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separator();
+    strBuffer += '{';
+    vFirst.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    strBuffer += '}';
+    vFirst.pop_back();
+    Written();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separator();
+    strBuffer += '[';
+    vFirst.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    strBuffer += ']';
+    vFirst.pop_back();
+    Written();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    Separator();
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separator();
+    strBuffer += value.write();
+    Written();
+}
+
+void JSONStreamWriter::Finish()
+{
+    if (!strBuffer.empty()) {
+        Send(false);
+    }
+}
+
+void JSONStreamWriter::Flush()
+{
+    // Small documents are left buffered, so that they can be sent in one go
+    if (strBuffer.size() >= nChunkSize || fUnflushed) {
+        Send(true);
+    }
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_RPC_JSONWRITER_H
+#define OASIS_RPC_JSONWRITER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Size of the chunks of output of JSONStreamWriter */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document token by token, so that large documents don't have to be
+ * built as a UniValue tree (see JSONStreamWriter). The values can be small UniValue
+ * trees themselves, such as the entries of a large array.
+ */
+class JSONWriter
+{
+public:
+    virtual ~JSONWriter() {}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+
+    //! Write the key of the next value of the current object
+    virtual void Key(const std::string& key) = 0;
+    //! Write a value: the whole document, an element of the current array, or the value of the last key
+    virtual void Value(const UniValue& value) = 0;
+
+    /**
+     * Let the output written so far be sent, waiting for the reader if it's behind.
+     * This is where the memory use is bounded: call it regularly, without holding
+     * any lock. Throws if the reader is gone.
+     */
+    virtual void Flush() {}
+
+    void KeyValue(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+
+    //! Write the members of the object obj into the current object
+    void KeyValues(const UniValue& obj);
+};
+
+/** JSONWriter building a UniValue, for the callers which need the whole document */
+class UniValueWriter : public JSONWriter
+{
+private:
+    UniValue result;
+    //! The open objects and arrays, with the key of each in its parent
+    std::vector<std::pair<std::string, UniValue>> vStack;
+    std::string strKey;
+
+    void Push(const UniValue& value);
+
+public:
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Value(const UniValue& value) override;
+
+    const UniValue& GetResult() const { return result; }
+};
+
+/**
+ * JSONWriter serializing the document (in the compact format of UniValue::write)
+ * and handing it to a sink in chunks of about nChunkSize bytes.
+ */
+class JSONStreamWriter : public JSONWriter
+{
+public:
+    /**
+     * Receives the chunks of output. fWait asks to wait until the reader has caught
+     * up with the output (strChunk may be empty then).
+     */
+    typedef std::function<void(std::string&& strChunk, bool fWait)> Sink;
+
+    explicit JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Value(const UniValue& value) override;
+    void Flush() override;
+
+    //! Hand the rest of the output to the sink, once the document is complete
+    virtual void Finish();
+
+    //! Whether nothing was written
+    bool IsEmpty() const { return fEmpty; }
+    //! Whether some output was handed to the sink
+    bool HasSentOutput() const { return fSentOutput; }
+
+protected:
+    //! The output not handed to the sink yet
+    std::string strBuffer;
+
+    void Send(bool fWait);
+
+private:
+    Sink sink;
+    const size_t nChunkSize;
+    //! Whether nothing was written yet in each of the open objects and arrays
+    std::vector<bool> vFirst;
+    bool fAfterKey{false};
+    bool fEmpty{true};
+    bool fSentOutput{false};
+    //! Whether some output was sent since the last wait for the reader
+    bool fUnflushed{false};
+
+    void Separator();
+    void Written();
+};
+
+#endif // OASIS_RPC_JSONWRITER_H
@@ -13,6 +13,7 @@
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "netbase.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
@@ -171,18 +172,21 @@ UniValue listmasternodes(const JSONRPCRequest& request)
 
 
     const std::string& strFilter = request.params.size() > 0 ? request.params[0].get_str() : "";
-    UniValue ret(UniValue::VARR);
 
     if (deterministicMNManager->LegacyMNObsolete()) {
         auto mnList = deterministicMNManager->GetListAtChainTip();
-        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
-            UniValue obj(UniValue::VOBJ);
-            dmn->ToJson(obj);
-            if (filterMasternode(obj, strFilter, !dmn->IsPoSeBanned())) {
-                ret.push_back(obj);
-            }
+        return WriteRPCResult(request, [&](JSONWriter& writer) {
+            writer.BeginArray();
+            mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+                UniValue obj(UniValue::VOBJ);
+                dmn->ToJson(obj);
+                if (filterMasternode(obj, strFilter, !dmn->IsPoSeBanned())) {
+                    writer.Value(obj);
+                    writer.Flush();
+                }
+            });
+            writer.EndArray();
         });
-        return ret;
     }
 
     // Legacy masternodes (!TODO: remove when transition to dmn is complete)
@@ -193,64 +197,68 @@ UniValue listmasternodes(const JSONRPCRequest& request)
 
     int count_enabled = mnodeman.CountEnabled();
     std::vector<std::pair<int64_t, MasternodeRef>> vMasternodeRanks = mnodeman.GetMasternodeRanks(nHeight);
-    for (int pos=0; pos < (int) vMasternodeRanks.size(); pos++) {
-        const auto& s = vMasternodeRanks[pos];
-        UniValue obj(UniValue::VOBJ);
-        const CMasternode& mn = *(s.second);
-
-        if (!mn.mnPayeeScript.empty()) {
-            // Deterministic masternode
-            auto dmn = mnList.GetMNByCollateral(mn.vin.prevout);
-            if (dmn) {
-                UniValue obj(UniValue::VOBJ);
-                dmn->ToJson(obj);
-                bool fEnabled = !dmn->IsPoSeBanned();
-                if (filterMasternode(obj, strFilter, fEnabled)) {
-                    // Added for backward compatibility with legacy masternodes
-                    obj.pushKV("type", "deterministic");
-                    obj.pushKV("txhash", obj["proTxHash"].get_str());
-                    obj.pushKV("addr", obj["dmnstate"]["payoutAddress"].get_str());
-                    obj.pushKV("status", fEnabled ? "ENABLED" : "POSE_BANNED");
-                    obj.pushKV("rank", fEnabled ? pos : 0);
-                    ret.push_back(obj);
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        writer.BeginArray();
+        for (int pos=0; pos < (int) vMasternodeRanks.size(); pos++) {
+            const auto& s = vMasternodeRanks[pos];
+            UniValue obj(UniValue::VOBJ);
+            const CMasternode& mn = *(s.second);
+
+            if (!mn.mnPayeeScript.empty()) {
+                // Deterministic masternode
+                auto dmn = mnList.GetMNByCollateral(mn.vin.prevout);
+                if (dmn) {
+                    UniValue obj(UniValue::VOBJ);
+                    dmn->ToJson(obj);
+                    bool fEnabled = !dmn->IsPoSeBanned();
+                    if (filterMasternode(obj, strFilter, fEnabled)) {
+                        // Added for backward compatibility with legacy masternodes
+                        obj.pushKV("type", "deterministic");
+                        obj.pushKV("txhash", obj["proTxHash"].get_str());
+                        obj.pushKV("addr", obj["dmnstate"]["payoutAddress"].get_str());
+                        obj.pushKV("status", fEnabled ? "ENABLED" : "POSE_BANNED");
+                        obj.pushKV("rank", fEnabled ? pos : 0);
+                        writer.Value(obj);
+                        writer.Flush();
+                    }
                 }
+                continue;
             }
-            continue;
-        }
-
-        std::string strVin = mn.vin.prevout.ToStringShort();
-        std::string strTxHash = mn.vin.prevout.hash.ToString();
-        uint32_t oIdx = mn.vin.prevout.n;
-
-        if (strFilter != "" && strTxHash.find(strFilter) == std::string::npos &&
-            mn.Status().find(strFilter) == std::string::npos &&
-            EncodeDestination(mn.pubKeyCollateralAddress.GetID()).find(strFilter) == std::string::npos) continue;
-
-        std::string strStatus = mn.Status();
-        std::string strHost;
-        int port;
-        SplitHostPort(mn.addr.ToString(), port, strHost);
-        CNetAddr node;
-        LookupHost(strHost.c_str(), node, false);
-        std::string strNetwork = GetNetworkName(node.GetNetwork());
-
-        obj.pushKV("rank", (strStatus == "ENABLED" ? pos : -1));
-        obj.pushKV("type", "legacy");
-        obj.pushKV("network", strNetwork);
-        obj.pushKV("txhash", strTxHash);
-        obj.pushKV("outidx", (uint64_t)oIdx);
-        obj.pushKV("pubkey", EncodeDestination(mn.pubKeyMasternode.GetID()));
-        obj.pushKV("status", strStatus);
-        obj.pushKV("addr", EncodeDestination(mn.pubKeyCollateralAddress.GetID()));
-        obj.pushKV("version", mn.protocolVersion);
-        obj.pushKV("lastseen", (int64_t)mn.lastPing.sigTime);
-        obj.pushKV("activetime", (int64_t)(mn.lastPing.sigTime - mn.sigTime));
-        obj.pushKV("lastpaid", (int64_t)mnodeman.GetLastPaid(s.second, count_enabled, chainTip));
 
-        ret.push_back(obj);
-    }
-
-    return ret;
+            std::string strVin = mn.vin.prevout.ToStringShort();
+            std::string strTxHash = mn.vin.prevout.hash.ToString();
+            uint32_t oIdx = mn.vin.prevout.n;
+
+            if (strFilter != "" && strTxHash.find(strFilter) == std::string::npos &&
+                mn.Status().find(strFilter) == std::string::npos &&
+                EncodeDestination(mn.pubKeyCollateralAddress.GetID()).find(strFilter) == std::string::npos) continue;
+
+            std::string strStatus = mn.Status();
+            std::string strHost;
+            int port;
+            SplitHostPort(mn.addr.ToString(), port, strHost);
+            CNetAddr node;
+            LookupHost(strHost.c_str(), node, false);
+            std::string strNetwork = GetNetworkName(node.GetNetwork());
+
+            obj.pushKV("rank", (strStatus == "ENABLED" ? pos : -1));
+            obj.pushKV("type", "legacy");
+            obj.pushKV("network", strNetwork);
+            obj.pushKV("txhash", strTxHash);
+            obj.pushKV("outidx", (uint64_t)oIdx);
+            obj.pushKV("pubkey", EncodeDestination(mn.pubKeyMasternode.GetID()));
+            obj.pushKV("status", strStatus);
+            obj.pushKV("addr", EncodeDestination(mn.pubKeyCollateralAddress.GetID()));
+            obj.pushKV("version", mn.protocolVersion);
+            obj.pushKV("lastseen", (int64_t)mn.lastPing.sigTime);
+            obj.pushKV("activetime", (int64_t)(mn.lastPing.sigTime - mn.sigTime));
+            obj.pushKV("lastpaid", (int64_t)mnodeman.GetLastPaid(s.second, count_enabled, chainTip));
+
+            writer.Value(obj);
+            writer.Flush();
+        }
+        writer.EndArray();
+    });
 }
 
 UniValue getmasternodecount (const JSONRPCRequest& request)
@@ -761,7 +761,7 @@ UniValue echo(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafe argNames
+{ //  category              name                      actor (function)         okSafe argNames, okParallel
   //  --------------------- ------------------------  -----------------------  ------ --------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {} },
@@ -771,14 +771,14 @@ static const CRPCCommand commands[] =
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "logging",                &logging,                true,  {"include", "exclude"} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"oasisaddress"} }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true,  {"oasisaddress","signature","message"} },
+    { "util",               "verifymessage",          &verifymessage,          true,  {"oasisaddress","signature","message"}, true },
 
     /* Forge */
     {"forge",               "listforgeitems",           &listforgeitems,            false,{}},
 
     /* Not shown in help */
-    { "hidden",             "echo",                   &echo,                   true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
-    { "hidden",             "echojson",               &echo,                   true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}},
+    { "hidden",             "echo",                   &echo,                   true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}, true },
+    { "hidden",             "echojson",               &echo,                   true,  {"arg0","arg1","arg2","arg3","arg4","arg5","arg6","arg7","arg8","arg9"}, true },
     { "hidden",             "setmocktime",            &setmocktime,            true,  {"timestamp"} },
 };
 
@@ -1036,11 +1036,40 @@ UniValue generateblskeypair(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue getmnlistcacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || !request.params.empty()) {
+        throw std::runtime_error(
+                "getmnlistcacheinfo\n"
+                "\nReturns the statistics of the cache of deterministic masternode lists.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"lists\": n,          (numeric) Number of lists in the cache\n"
+                "  \"hits\": n,           (numeric) Number of lookups of a cached list\n"
+                "  \"misses\": n,         (numeric) Number of lookups of a list built from a snapshot and diffs\n"
+                "  \"diffs_applied\": n,  (numeric) Number of diffs applied by the misses\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getmnlistcacheinfo", "")
+                + HelpExampleRpc("getmnlistcacheinfo", "")
+        );
+    }
+
+    const auto& stats = deterministicMNManager->GetListsCacheStats();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("lists", (uint64_t)stats.nLists);
+    ret.pushKV("hits", stats.nHits);
+    ret.pushKV("misses", stats.nMisses);
+    ret.pushKV("diffs_applied", stats.nDiffsApplied);
+    return ret;
+}
+
 
 static const CRPCCommand commands[] =
 { //  category       name                              actor (function)         okSafe argNames
   //  -------------- --------------------------------- ------------------------ ------ --------
     { "evo",         "generateblskeypair",             &generateblskeypair,     true,  {}  },
+    { "evo",         "getmnlistcacheinfo",             &getmnlistcacheinfo,     true,  {}  },
     { "evo",         "protx_list",                     &protx_list,             true,  {"detailed","wallet_only","valid_only","height"}  },
 #ifdef ENABLE_WALLET
     { "evo",         "protx_register",                 &protx_register,         true,  {"collateralHash","collateralIndex","ipAndPort","ownerAddress","operatorPubKey","votingAddress","payoutAddress","operatorReward","operatorPayoutAddress"} },
@@ -8,13 +8,16 @@
 
 #include "rpc/server.h"
 
+#include "ctpl.h"
 #include "fs.h"
 #include "key_io.h"
 #include "random.h"
+#include "rpc/jsonwriter.h"
 #include "shutdown.h"
 #include "sync.h"
 #include "guiinterface.h"
 #include "util/system.h"
+#include "util/threadnames.h"
 #include "utilstrencodings.h"
 
 #ifdef ENABLE_WALLET
@@ -24,6 +27,8 @@
 #include <boost/signals2/signal.hpp>
 #include <boost/thread.hpp>
 
+#include <deque>
+#include <future>
 #include <memory> // for unique_ptr
 #include <unordered_map>
 
@@ -37,6 +42,13 @@ static RPCTimerInterface* timerInterface = NULL;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase>> deadlineTimers;
 
+/* Pool executing the concurrent calls of the batches, shared by all the batches.
+ * It is created on first use, so that the nodes not serving batches don't start its threads. */
+static Mutex cs_rpcBatch;
+static std::shared_ptr<ctpl::thread_pool> rpcBatchPool GUARDED_BY(cs_rpcBatch);
+static int nRPCBatchThreads GUARDED_BY(cs_rpcBatch) = 0;
+static int nRPCBatchConcurrency GUARDED_BY(cs_rpcBatch) = 1;
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -316,6 +328,11 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
+    {
+        LOCK(cs_rpcBatch);
+        nRPCBatchThreads = std::max((int)gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 0);
+        nRPCBatchConcurrency = std::max((int)gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY), 1);
+    }
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -333,6 +350,12 @@ void StopRPC()
     LogPrint(BCLog::RPC, "Stopping RPC\n");
     deadlineTimers.clear();
     DeleteAuthCookie();
+    {
+        // The batches still running keep their reference, the threads exit after them
+        LOCK(cs_rpcBatch);
+        rpcBatchPool.reset();
+        nRPCBatchThreads = 0;
+    }
     g_rpcSignals.Stopped();
 }
 
@@ -392,6 +415,24 @@ void JSONRPCRequest::parse(const UniValue& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array or object");
 }
 
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter&)>& fn)
+{
+    if (request.replyWriter) {
+        // Same as JSONRPCReplyObj
+        JSONWriter& writer = *request.replyWriter;
+        writer.BeginObject();
+        writer.Key("result");
+        fn(writer);
+        writer.KeyValue("error", NullUniValue);
+        writer.KeyValue("id", request.id);
+        writer.EndObject();
+        return NullUniValue;
+    }
+    UniValueWriter writer;
+    fn(writer);
+    return writer.GetResult();
+}
+
 bool IsDeprecatedRPCEnabled(const std::string& method)
 {
     const std::vector<std::string> enabled_methods = gArgs.GetArgs("-deprecatedrpc");
@@ -419,12 +460,81 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsParallelCall(const UniValue& req)
+{
+    if (!req.isObject()) return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    if (!method.isStr()) return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->okParallel;
+}
+
+//! The pool executing the concurrent calls of the batches, or nullptr if they are executed sequentially
+static std::shared_ptr<ctpl::thread_pool> GetRPCBatchPool()
+{
+    LOCK(cs_rpcBatch);
+    if (!rpcBatchPool && nRPCBatchThreads > 0) {
+        rpcBatchPool = std::make_shared<ctpl::thread_pool>(nRPCBatchThreads);
+        RenameThreadPool(*rpcBatchPool, "oasis-rpcbatch");
+        LogPrint(BCLog::RPC, "Using %d threads for the JSON-RPC batches, at most %d calls per batch\n", nRPCBatchThreads, nRPCBatchConcurrency);
+    }
+    return rpcBatchPool;
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    std::shared_ptr<ctpl::thread_pool> pool;
+    const int nConcurrency = WITH_LOCK(cs_rpcBatch, return nRPCBatchConcurrency;);
+
+    // The calls in flight write to vResults and read vReq: wait for all of them
+    // before leaving, even if an exception is unwinding the stack.
+    struct InFlightCalls {
+        std::deque<std::future<void>> futures;
+        void WaitFront()
+        {
+            std::future<void> f = std::move(futures.front());
+            futures.pop_front();
+            f.get();
+        }
+        ~InFlightCalls()
+        {
+            for (auto& f : futures) {
+                if (f.valid()) f.wait();
+            }
+        }
+    };
+
+    // The calls marked okParallel are executed on the pool, at most nConcurrency at
+    // once, so that a single batch can't take all the threads. Any other call waits
+    // for the calls before it and runs alone, so the batch keeps its ordering.
+    std::vector<UniValue> vResults(vReq.size());
+    InFlightCalls inFlight;
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        const UniValue& req = vReq[reqIdx];
+        bool fParallel = IsParallelCall(req);
+        if (fParallel && !pool) {
+            pool = GetRPCBatchPool();
+            fParallel = pool != nullptr;
+        }
+        if (!fParallel) {
+            while (!inFlight.futures.empty()) {
+                inFlight.WaitFront();
+            }
+            vResults[reqIdx] = JSONRPCExecOne(req);
+            continue;
+        }
+        if ((int)inFlight.futures.size() >= nConcurrency) {
+            inFlight.WaitFront();
+        }
+        UniValue& result = vResults[reqIdx];
+        inFlight.futures.emplace_back(pool->push([&req, &result](int id) { result = JSONRPCExecOne(req); }));
+    }
+    while (!inFlight.futures.empty()) {
+        inFlight.WaitFront();
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(vResults);
     return ret.write() + "\n";
 }
 
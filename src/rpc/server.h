@@ -21,6 +21,12 @@
 
 class CRPCCommand;
 
+//! Number of threads executing the concurrent calls of JSON-RPC batches (0 to run them sequentially),
+//! started by the first batch that has such calls
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+//! Maximum number of calls of a single batch in flight at once
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
+
 namespace RPCServer
 {
     void OnStarted(std::function<void ()> slot);
@@ -30,6 +36,7 @@ namespace RPCServer
 
 class CBlockIndex;
 class CNetAddr;
+class JSONWriter;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
  * Used to denote don't care type. Only used by RPCTypeCheckObj */
@@ -49,11 +56,21 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    //! Writer of the reply, when the caller can stream it (see WriteRPCResult)
+    JSONWriter* replyWriter{nullptr};
 
     JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
     void parse(const UniValue& valRequest);
 };
 
+/**
+ * Produce the result of a RPC call with fn. If the request has a reply writer, the
+ * whole reply is written with it, so that large results don't have to be built in
+ * memory, and null is returned. Otherwise the result is built and returned.
+ * The arguments must be checked before: once streamed, the reply can't be an error.
+ */
+UniValue WriteRPCResult(const JSONRPCRequest& request, const std::function<void(JSONWriter&)>& fn);
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -139,6 +156,8 @@ public:
     rpcfn_type actor;
     bool okSafeMode;
     std::vector<std::string> argNames;
+    //! Whether the call only reads state under its own locks, so that the calls of a batch can run it concurrently
+    bool okParallel{false};
 };
 
 /**
@@ -133,6 +133,15 @@ extern "C" {
     /// `librustzcash_sapling_proving_ctx_init`.
     void librustzcash_sapling_proving_ctx_free(void *);
 
+    /// Adds the value commitments of the proofs made with the proving
+    /// context `other` to `ctx`, so that proofs of the same transaction
+    /// can be made with different contexts (on different threads) before
+    /// the binding signature is made with `ctx`.
+    void librustzcash_sapling_proving_ctx_add(
+        void *ctx,
+        const void *other
+    );
+
     /// Creates a Sapling verification context. Please free this
     /// when you're done.
     void * librustzcash_sapling_verification_ctx_init();
@@ -56,10 +56,10 @@ use zcash_primitives::{
     transaction::components::Amount,
     zip32, JUBJUB,
 };
-use zcash_proofs::{
-    load_parameters,
-    sapling::{SaplingProvingContext, SaplingVerificationContext},
-};
+use zcash_proofs::{load_parameters, sapling::SaplingVerificationContext};
+
+mod prover;
+use prover::SaplingProvingContext;
 
 #[cfg(test)]
 mod tests;
@@ -1146,6 +1146,14 @@ pub extern "system" fn librustzcash_sapling_proving_ctx_free(ctx: *mut SaplingPr
     drop(unsafe { Box::from_raw(ctx) });
 }
 
+#[no_mangle]
+pub extern "system" fn librustzcash_sapling_proving_ctx_add(
+    ctx: *mut SaplingProvingContext,
+    other: *const SaplingProvingContext,
+) {
+    unsafe { &mut *ctx }.add(unsafe { &*other }, &JUBJUB);
+}
+
 #[no_mangle]
 pub extern "system" fn librustzcash_zip32_xsk_master(
     seed: *const c_uchar,
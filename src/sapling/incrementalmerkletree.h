@@ -9,6 +9,7 @@
 #include "uint256.h"
 #include "optional.h"
 #include "serialize.h"
+#include "sync.h"
 
 #include "sapling/sapling.h"
 #include "sapling/sapling_util.h"
@@ -93,6 +94,19 @@ public:
     BOOST_STATIC_ASSERT(Depth >= 1);
 
     IncrementalMerkleTree() { }
+    IncrementalMerkleTree(const IncrementalMerkleTree& other) :
+        left(other.left), right(other.right), parents(other.parents), cached_root(other.GetCachedRoot()) { }
+    IncrementalMerkleTree& operator=(const IncrementalMerkleTree& other) {
+        if (this != &other) {
+            const Optional<Hash> other_root = other.GetCachedRoot();
+            left = other.left;
+            right = other.right;
+            parents = other.parents;
+            LOCK(cs_cached_root);
+            cached_root = other_root;
+        }
+        return *this;
+    }
 
     size_t DynamicMemoryUsage() const {
         return 32 + // left
@@ -103,8 +117,19 @@ public:
     size_t size() const;
 
     void append(Hash obj);
+    // Append the commitments of a whole block (or block template)
+    void append(const std::vector<uint256>& objs);
+    // The root is computed once per state of the tree: a tree is appended to once per
+    // block, but its root is asked for by block assembly, the anchor map and ConnectBlock.
+    // A tree can be read by several threads at once (appending still needs exclusive access).
     Hash root() const {
-        return root(Depth, std::deque<Hash>());
+        if (Optional<Hash> cached = GetCachedRoot()) {
+            return *cached;
+        }
+        const Hash new_root = root(Depth, std::deque<Hash>());
+        LOCK(cs_cached_root);
+        cached_root = new_root;
+        return new_root;
     }
     Hash last() const;
 
@@ -115,6 +140,7 @@ public:
     SERIALIZE_METHODS(IncrementalMerkleTree, obj)
     {
         READWRITE(obj.left, obj.right, obj.parents);
+        SER_READ(obj, obj.ResetCachedRoot());
         obj.wfcheck();
     }
 
@@ -133,6 +159,17 @@ private:
 
     // Collapsed "left" subtrees ordered toward the root of the tree.
     std::vector<Optional<Hash>> parents;
+    // Root of the tree, reset by append() (not serialized)
+    mutable Mutex cs_cached_root;
+    mutable Optional<Hash> cached_root GUARDED_BY(cs_cached_root);
+    Optional<Hash> GetCachedRoot() const {
+        LOCK(cs_cached_root);
+        return cached_root;
+    }
+    void ResetCachedRoot() {
+        LOCK(cs_cached_root);
+        cached_root = nullopt;
+    }
     MerklePath path(std::deque<Hash> filler_hashes = std::deque<Hash>()) const;
     Hash root(size_t depth, std::deque<Hash> filler_hashes = std::deque<Hash>()) const;
     bool is_complete(size_t depth = Depth) const;
@@ -176,6 +213,7 @@ public:
     }
 
     void append(Hash obj);
+    void append(const std::vector<uint256>& objs);
 
     SERIALIZE_METHODS(IncrementalWitness, obj)
     {
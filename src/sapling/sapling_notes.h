@@ -0,0 +1,21 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_SAPLING_NOTES_H
+#define OASIS_SAPLING_NOTES_H
+
+#include "keystore.h"
+#include "primitives/transaction.h"
+
+#include <map>
+#include <utility>
+
+class SaplingNoteData;
+
+typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
+
+//! Notes found in a tx, and the addresses (with their viewing key) they were sent to
+typedef std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> SaplingNotesFound;
+
+#endif // OASIS_SAPLING_NOTES_H
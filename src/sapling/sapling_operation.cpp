@@ -78,6 +78,12 @@ TxValues calculateTarget(const std::vector<SendManyRecipient>& recipients, const
 }
 
 OperationResult SaplingOperation::build()
+{
+    OperationResult res = prepare();
+    return (res) ? prove() : res;
+}
+
+OperationResult SaplingOperation::prepare()
 {
     bool isFromtAddress = false;
     bool isFromShielded = false;
@@ -243,7 +249,11 @@ OperationResult SaplingOperation::build()
     }
     // Done
     fee = nFeeRet;
+    return OperationResult(true);
+}
 
+OperationResult SaplingOperation::prove()
+{
     // Clear dummy signatures/proofs and add real ones
     txBuilder.ClearProofsAndSignatures();
     TransactionBuilderResult txResult = txBuilder.ProveAndSign();
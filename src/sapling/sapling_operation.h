@@ -86,6 +86,11 @@ public:
     ~SaplingOperation();
 
     OperationResult build();
+    // The two steps of build(): prepare() selects the inputs and computes the fee, with
+    // dummy proofs and signatures (needs cs_main and the wallet lock). prove() then makes
+    // the proofs and signatures, and does not need any lock.
+    OperationResult prepare();
+    OperationResult prove();
     OperationResult send(std::string& retTxHash);
     OperationResult buildAndSend(std::string& retTxHash);
 
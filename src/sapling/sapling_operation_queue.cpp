@@ -0,0 +1,257 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "sapling/sapling_operation_queue.h"
+
+#include "ctpl.h"
+#include "random.h"
+#include "rpc/protocol.h"
+#include "util/system.h"
+#include "util/threadnames.h"
+#include "utiltime.h"
+#include "validation.h"
+
+std::string AsyncOperationStatusToString(AsyncOperationStatus status)
+{
+    switch (status) {
+        case AsyncOperationStatus::QUEUED: return "queued";
+        case AsyncOperationStatus::EXECUTING: return "executing";
+        case AsyncOperationStatus::SUCCESS: return "success";
+        case AsyncOperationStatus::FAILED: return "failed";
+        case AsyncOperationStatus::CANCELLED: return "cancelled";
+    }
+    assert(false);
+}
+
+AsyncSaplingOperation::AsyncSaplingOperation(CWallet* _wallet,
+                                             std::unique_ptr<SaplingOperation> _operation,
+                                             const std::string& _method,
+                                             const UniValue& _params) :
+    id("opid-" + GetRandHash().GetHex().substr(0, 32)),
+    wallet(_wallet),
+    operation(std::move(_operation)),
+    method(_method),
+    params(_params),
+    nCreationTime(GetTime())
+{
+    assert(wallet != nullptr && operation != nullptr);
+}
+
+AsyncOperationStatus AsyncSaplingOperation::GetStatus() const
+{
+    LOCK(cs);
+    return status;
+}
+
+bool AsyncSaplingOperation::IsFinished() const
+{
+    const AsyncOperationStatus s = GetStatus();
+    return s != AsyncOperationStatus::QUEUED && s != AsyncOperationStatus::EXECUTING;
+}
+
+void AsyncSaplingOperation::SetStage(const std::string& stage)
+{
+    LOCK(cs);
+    strStage = stage;
+}
+
+bool AsyncSaplingOperation::Cancel()
+{
+    LOCK(cs);
+    if (status != AsyncOperationStatus::QUEUED) return false;
+    status = AsyncOperationStatus::CANCELLED;
+    return true;
+}
+
+void AsyncSaplingOperation::Run()
+{
+    {
+        LOCK(cs);
+        if (status != AsyncOperationStatus::QUEUED) return;
+        status = AsyncOperationStatus::EXECUTING;
+        strStage = "selecting inputs";
+        nStartTimeMillis = GetTimeMillis();
+    }
+
+    OperationResult res(false);
+    int nCode = RPC_WALLET_ERROR;
+    std::string txid;
+    try {
+        if (wallet->IsLocked()) {
+            res = errorOut("Error: Please enter the wallet passphrase with walletpassphrase first.");
+            nCode = RPC_WALLET_UNLOCK_NEEDED;
+        } else {
+            {
+                LOCK2(cs_main, wallet->cs_wallet);
+                res = operation->prepare();
+            }
+            // The proofs are made without holding any lock
+            if (res) {
+                SetStage("proving");
+                res = operation->prove();
+            }
+            if (res) {
+                SetStage("sending");
+                res = operation->send(txid);
+            }
+        }
+    } catch (const std::exception& e) {
+        res = errorOut(e.what());
+    }
+
+    LOCK(cs);
+    nEndTimeMillis = GetTimeMillis();
+    strStage.clear();
+    if (res) {
+        status = AsyncOperationStatus::SUCCESS;
+        strTxId = txid;
+        LogPrint(BCLog::SAPLING, "%s: %s sent %s in %d ms\n", __func__, id, txid, nEndTimeMillis - nStartTimeMillis);
+    } else {
+        status = AsyncOperationStatus::FAILED;
+        nErrorCode = nCode;
+        strError = res.getError();
+        LogPrint(BCLog::SAPLING, "%s: %s failed: %s\n", __func__, id, strError);
+    }
+}
+
+UniValue AsyncSaplingOperation::ToJSON() const
+{
+    LOCK(cs);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("id", id);
+    obj.pushKV("status", AsyncOperationStatusToString(status));
+    obj.pushKV("creation_time", nCreationTime);
+    obj.pushKV("method", method);
+    obj.pushKV("params", params);
+    if (status == AsyncOperationStatus::EXECUTING) {
+        obj.pushKV("stage", strStage);
+        obj.pushKV("execution_secs", (GetTimeMillis() - nStartTimeMillis) / 1000.0);
+    } else if (status == AsyncOperationStatus::SUCCESS || status == AsyncOperationStatus::FAILED) {
+        obj.pushKV("execution_secs", (nEndTimeMillis - nStartTimeMillis) / 1000.0);
+    }
+    if (status == AsyncOperationStatus::SUCCESS) {
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("txid", strTxId);
+        obj.pushKV("result", result);
+    } else if (status == AsyncOperationStatus::FAILED) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("code", nErrorCode);
+        error.pushKV("message", strError);
+        obj.pushKV("error", error);
+    }
+    return obj;
+}
+
+SaplingOperationQueue::SaplingOperationQueue(int nThreadsIn) :
+    nThreads(std::max(1, std::min(nThreadsIn, MAX_SHIELD_SEND_THREADS))),
+    workerPool(new ctpl::thread_pool(nThreads))
+{
+    RenameThreadPool(*workerPool, "oasis-zsend");
+}
+
+SaplingOperationQueue::~SaplingOperationQueue()
+{
+    Stop();
+}
+
+bool SaplingOperationQueue::Push(const AsyncSaplingOperationRef& op)
+{
+    LOCK(cs);
+    if (fStopped) return false;
+    size_t nPending = 0;
+    for (const auto& it : vOperations) {
+        if (!it->IsFinished()) nPending++;
+    }
+    if (nPending >= MAX_PENDING_SAPLING_OPERATIONS) return false;
+
+    // Forget the oldest finished operations, whose result was never read
+    for (auto it = vOperations.begin(); vOperations.size() >= MAX_SAPLING_OPERATIONS && it != vOperations.end();) {
+        it = (*it)->IsFinished() ? vOperations.erase(it) : std::next(it);
+    }
+
+    vOperations.emplace_back(op);
+    auto& walletQueue = mapWalletQueues[op->GetWallet()];
+    walletQueue.emplace_back(op);
+    if (walletQueue.size() == 1) {
+        Dispatch(op);
+    }
+    return true;
+}
+
+void SaplingOperationQueue::Dispatch(const AsyncSaplingOperationRef& op)
+{
+    AssertLockHeld(cs);
+    workerPool->push([this, op](int threadId) {
+        op->Run();
+        OnFinished(op->GetWallet());
+    });
+}
+
+void SaplingOperationQueue::OnFinished(const CWallet* pwallet)
+{
+    LOCK(cs);
+    auto it = mapWalletQueues.find(pwallet);
+    assert(it != mapWalletQueues.end() && !it->second.empty());
+    it->second.pop_front();
+    // Once stopped, the queued operations are cancelled and never executed
+    if (it->second.empty() || fStopped) {
+        mapWalletQueues.erase(it);
+        return;
+    }
+    Dispatch(it->second.front());
+}
+
+std::vector<AsyncSaplingOperationRef> SaplingOperationQueue::GetOperations(const CWallet* pwallet, const std::set<std::string>& ids) const
+{
+    LOCK(cs);
+    std::vector<AsyncSaplingOperationRef> vRet;
+    for (const auto& op : vOperations) {
+        if (op->GetWallet() == pwallet && (ids.empty() || ids.count(op->GetId()))) {
+            vRet.emplace_back(op);
+        }
+    }
+    return vRet;
+}
+
+void SaplingOperationQueue::Remove(const std::string& id)
+{
+    LOCK(cs);
+    vOperations.erase(std::remove_if(vOperations.begin(), vOperations.end(), [&id](const AsyncSaplingOperationRef& op) {
+        return op->GetId() == id && op->IsFinished();
+    }), vOperations.end());
+}
+
+void SaplingOperationQueue::Stop()
+{
+    {
+        LOCK(cs);
+        if (fStopped) return;
+        fStopped = true;
+        for (const auto& op : vOperations) {
+            op->Cancel();
+        }
+    }
+    // The cancelled operations return right away, wait for the executing ones
+    workerPool->stop(true);
+}
+
+static Mutex cs_saplingOperationQueue;
+static std::unique_ptr<SaplingOperationQueue> saplingOperationQueue GUARDED_BY(cs_saplingOperationQueue);
+
+SaplingOperationQueue* GetSaplingOperationQueue()
+{
+    LOCK(cs_saplingOperationQueue);
+    if (!saplingOperationQueue) {
+        saplingOperationQueue.reset(new SaplingOperationQueue(gArgs.GetArg("-shieldsendthreads", DEFAULT_SHIELD_SEND_THREADS)));
+    }
+    return saplingOperationQueue.get();
+}
+
+void StopSaplingOperationQueue()
+{
+    LOCK(cs_saplingOperationQueue);
+    if (saplingOperationQueue) {
+        saplingOperationQueue->Stop();
+    }
+}
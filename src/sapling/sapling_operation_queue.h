@@ -0,0 +1,136 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_SAPLING_OPERATION_QUEUE_H
+#define OASIS_SAPLING_OPERATION_QUEUE_H
+
+#include "sapling/sapling_operation.h"
+#include "sync.h"
+
+#include <univalue.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+//! Default number of shielded sends executed at the same time (-shieldsendthreads)
+static const int DEFAULT_SHIELD_SEND_THREADS = 1;
+//! Maximum number of shielded sends executed at the same time
+static const int MAX_SHIELD_SEND_THREADS = 8;
+//! Maximum number of shielded sends queued or executing
+static const size_t MAX_PENDING_SAPLING_OPERATIONS = 100;
+//! Maximum number of operations kept (the oldest finished ones are forgotten first)
+static const size_t MAX_SAPLING_OPERATIONS = 1000;
+
+namespace ctpl {
+    class thread_pool;
+}
+
+enum class AsyncOperationStatus {
+    QUEUED,
+    EXECUTING,
+    SUCCESS,
+    FAILED,
+    CANCELLED
+};
+
+std::string AsyncOperationStatusToString(AsyncOperationStatus status);
+
+/**
+ * A SaplingOperation queued by an RPC call. A worker of the SaplingOperationQueue selects
+ * its inputs, makes the proofs and commits the transaction, while the caller gets the
+ * operation id right away and polls its status.
+ */
+class AsyncSaplingOperation
+{
+public:
+    AsyncSaplingOperation(CWallet* _wallet,
+                          std::unique_ptr<SaplingOperation> _operation,
+                          const std::string& _method,
+                          const UniValue& _params);
+
+    const std::string& GetId() const { return id; }
+    const CWallet* GetWallet() const { return wallet; }
+    AsyncOperationStatus GetStatus() const;
+    bool IsFinished() const;
+    // id, status, current stage, times, and the txid or the error once finished
+    UniValue ToJSON() const;
+
+    // Select the inputs, prove, sign and commit the transaction (does nothing if cancelled)
+    void Run();
+    // Cancel the operation if it is still queued
+    bool Cancel();
+
+private:
+    const std::string id;
+    CWallet* const wallet;
+    const std::unique_ptr<SaplingOperation> operation;
+    const std::string method;
+    const UniValue params;
+    const int64_t nCreationTime;
+
+    mutable Mutex cs;
+    AsyncOperationStatus status GUARDED_BY(cs){AsyncOperationStatus::QUEUED};
+    std::string strStage GUARDED_BY(cs);
+    int64_t nStartTimeMillis GUARDED_BY(cs){0};
+    int64_t nEndTimeMillis GUARDED_BY(cs){0};
+    std::string strTxId GUARDED_BY(cs);
+    int nErrorCode GUARDED_BY(cs){0};
+    std::string strError GUARDED_BY(cs);
+
+    void SetStage(const std::string& stage);
+};
+
+typedef std::shared_ptr<AsyncSaplingOperation> AsyncSaplingOperationRef;
+
+/**
+ * Executes the queued shielded sends on a pool of worker threads, so that making the
+ * proofs doesn't hold an RPC worker. At most -shieldsendthreads operations execute at
+ * the same time, and at most MAX_PENDING_SAPLING_OPERATIONS are queued or executing.
+ * The operations of a wallet execute one at a time, in queue order: the wallet doesn't
+ * lock the notes selected by an operation until its transaction is committed. Each wallet
+ * has its own queue, and its next operation is handed to the pool only when the previous
+ * one finishes, so the operations of a wallet don't hold the threads the others need.
+ * The operations are kept, in creation order, until their result is read.
+ */
+class SaplingOperationQueue
+{
+public:
+    explicit SaplingOperationQueue(int nThreadsIn);
+    ~SaplingOperationQueue();
+
+    // Queue the operation, unless too many are pending or the queue is stopped
+    bool Push(const AsyncSaplingOperationRef& op);
+    // The operations of pwallet, or only the ones with the given ids
+    std::vector<AsyncSaplingOperationRef> GetOperations(const CWallet* pwallet, const std::set<std::string>& ids = {}) const;
+    // Forget a finished operation (after its result is read)
+    void Remove(const std::string& id);
+    // Cancel the queued operations and wait for the executing ones
+    void Stop();
+
+    int GetNumThreads() const { return nThreads; }
+
+private:
+    const int nThreads;
+    mutable Mutex cs;
+    std::vector<AsyncSaplingOperationRef> vOperations GUARDED_BY(cs);
+    bool fStopped GUARDED_BY(cs){false};
+    // The pending operations of each wallet, the first one is executing
+    std::map<const CWallet*, std::deque<AsyncSaplingOperationRef>> mapWalletQueues GUARDED_BY(cs);
+    std::unique_ptr<ctpl::thread_pool> workerPool;
+
+    // Hand the operation to the pool, and the next one of its wallet once it finishes
+    void Dispatch(const AsyncSaplingOperationRef& op) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void OnFinished(const CWallet* pwallet);
+};
+
+// The queue of the shielded sends, created on first use
+SaplingOperationQueue* GetSaplingOperationQueue();
+// Called at shutdown, before the wallets are flushed
+void StopSaplingOperationQueue();
+
+#endif // OASIS_SAPLING_OPERATION_QUEUE_H
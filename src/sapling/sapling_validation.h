@@ -7,10 +7,38 @@
 #define OASIS_SAPLING_VALIDATION_H
 
 #include "chainparams.h"
+#include "uint256.h"
+
+#include <vector>
 
 class CTransaction;
 class CValidationState;
 
+/**
+ * Closure representing the Sapling proofs and binding signature check of one transaction,
+ * so that they can be verified in parallel by a CCheckQueue.
+ */
+class CSaplingCheck
+{
+private:
+    const CTransaction* ptx;
+    uint256 dataToBeSigned;
+
+public:
+    CSaplingCheck() : ptx(nullptr) {}
+    CSaplingCheck(const CTransaction& txIn, const uint256& dataToBeSignedIn) :
+        ptx(&txIn),
+        dataToBeSigned(dataToBeSignedIn) {}
+
+    bool operator()();
+
+    void swap(CSaplingCheck& check)
+    {
+        std::swap(ptx, check.ptx);
+        std::swap(dataToBeSigned, check.dataToBeSigned);
+    }
+};
+
 namespace SaplingValidation {
 
 /** Context-independent validity checks */
@@ -21,9 +49,13 @@ bool CheckTransactionWithoutProofVerification(const CTransaction& tx, CValidatio
 
 /** Check a transaction contextually against a set of consensus rules */
 // Note: if v5 upgrade wasn't enforced, this method returns true without performing any check.
+// Note2: if pvChecks is not null, the proofs verification is appended to it instead of being performed.
 bool ContextualCheckTransaction(const CTransaction &tx, CValidationState &state,
                                 const CChainParams &chainparams, int nHeight, bool isMined,
-                                bool sInitBlockDownload);
+                                bool sInitBlockDownload, std::vector<CSaplingCheck>* pvChecks = nullptr);
+
+/** Verify the spend and output proofs and the binding signature of a shielded transaction */
+bool CheckProofs(const CTransaction& tx, const uint256& dataToBeSigned, CValidationState& state, int nDoSRelaxing);
 
 }; // End SaplingValidation namespace
 
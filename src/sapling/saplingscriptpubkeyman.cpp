@@ -6,6 +6,8 @@
 #include "sapling/saplingscriptpubkeyman.h"
 
 #include "chain.h" // for CBlockIndex
+#include "ctpl.h"
+#include "util/threadnames.h"
 #include "validation.h" // for ReadBlockFromDisk()
 
 void SaplingScriptPubKeyMan::AddToSaplingSpends(const uint256& nullifier, const uint256& wtxid)
@@ -109,31 +111,27 @@ void SaplingScriptPubKeyMan::UpdateNullifierNoteMapWithTx(const CWalletTx& wtx)
     }
 }
 
-template<typename NoteDataMap>
-void CopyPreviousWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
+void CopyPreviousWitness(SaplingNoteData* nd, int indexHeight, int64_t nWitnessCacheSize)
 {
-    for (auto& item : noteDataMap) {
-        auto* nd = &(item.second);
-        // skip externally sent notes
-        if (!nd->IsMyNote()) continue;
-        // Only increment witnesses that are behind the current height
-        if (nd->witnessHeight < indexHeight) {
-            // Check the validity of the cache
-            // The only time a note witnessed above the current height
-            // would be invalid here is during a reindex when blocks
-            // have been decremented, and we are incrementing the blocks
-            // immediately after.
-            assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
-            // Witnesses being incremented should always be either -1
-            // (never incremented or decremented) or one below indexHeight
-            assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight - 1));
-            // Copy the witness for the previous block if we have one
-            if (nd->witnesses.size() > 0) {
-                nd->witnesses.push_front(nd->witnesses.front());
-            }
-            if (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
-                nd->witnesses.pop_back();
-            }
+    // skip externally sent notes
+    if (!nd->IsMyNote()) return;
+    // Only increment witnesses that are behind the current height
+    if (nd->witnessHeight < indexHeight) {
+        // Check the validity of the cache
+        // The only time a note witnessed above the current height
+        // would be invalid here is during a reindex when blocks
+        // have been decremented, and we are incrementing the blocks
+        // immediately after.
+        assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+        // Witnesses being incremented should always be either -1
+        // (never incremented or decremented) or one below indexHeight
+        assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight - 1));
+        // Copy the witness for the previous block if we have one
+        if (nd->witnesses.size() > 0) {
+            nd->witnesses.push_front(nd->witnesses.front());
+        }
+        if (nd->witnesses.size() > WITNESS_CACHE_SIZE) {
+            nd->witnesses.pop_back();
         }
     }
 }
@@ -151,6 +149,17 @@ void AppendNoteCommitment(SaplingNoteData* nd, int indexHeight, int64_t nWitness
     }
 }
 
+void AppendNoteCommitments(SaplingNoteData* nd, int indexHeight, int64_t nWitnessCacheSize, const std::vector<uint256>& note_commitments)
+{
+    // skip externally sent notes
+    if (!nd->IsMyNote()) return;
+    // See AppendNoteCommitment
+    if (nd->witnessHeight < indexHeight && nd->witnesses.size() > 0) {
+        assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+        nd->witnesses.front().append(note_commitments);
+    }
+}
+
 template<typename Witness>
 void WitnessNoteIfMine(SaplingNoteData* nd,
                        int indexHeight,
@@ -183,18 +192,118 @@ void WitnessNoteIfMine(SaplingNoteData* nd,
     assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
 }
 
+void UpdateWitnessHeight(SaplingNoteData* nd, int indexHeight, int64_t nWitnessCacheSize)
+{
+    // skip externally sent notes
+    if (!nd->IsMyNote()) return;
+    if (nd->witnessHeight < indexHeight) {
+        nd->witnessHeight = indexHeight;
+        // Check the validity of the cache
+        // See comment in CopyPreviousWitness about validity.
+        assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+    }
+}
+
 template<typename NoteDataMap>
 void UpdateWitnessHeights(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
 {
     for (auto& item : noteDataMap) {
-        auto* nd = &(item.second);
-        // skip externally sent notes
-        if (!nd->IsMyNote()) continue;
-        if (nd->witnessHeight < indexHeight) {
-            nd->witnessHeight = indexHeight;
-            // Check the validity of the cache
-            // See comment in CopyPreviousWitnesses about validity.
-            assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+        UpdateWitnessHeight(&(item.second), indexHeight, nWitnessCacheSize);
+    }
+}
+
+SaplingNoteData* SaplingScriptPubKeyMan::GetWitnessedNoteData(const SaplingOutPoint& op)
+{
+    AssertLockHeld(wallet->cs_wallet);
+    auto it = wallet->mapWallet.find(op.hash);
+    if (it == wallet->mapWallet.end()) return nullptr;
+    auto ndIt = it->second.mapSaplingNoteData.find(op);
+    if (ndIt == it->second.mapSaplingNoteData.end() || !ndIt->second.IsMyNote()) return nullptr;
+    return &ndIt->second;
+}
+
+void RewindNoteWitnesses(SaplingNoteData* nd, int nSpendHeight, int64_t nWitnessCacheSize)
+{
+    // Witnesses past the spend height belong to blocks connected after it:
+    // the spend cannot be disconnected before them.
+    if (nd->witnessHeight > nSpendHeight) {
+        size_t nStale = nd->witnessHeight - nSpendHeight;
+        if (nStale >= nd->witnesses.size()) {
+            nd->witnesses.clear();
+            nd->witnessHeight = -1;
+            return;
+        }
+        for (size_t i = 0; i < nStale; i++) {
+            nd->witnesses.pop_front();
+        }
+        nd->witnessHeight = nSpendHeight;
+    }
+    while ((int64_t) nd->witnesses.size() > nWitnessCacheSize) {
+        nd->witnesses.pop_back();
+    }
+}
+
+void SaplingScriptPubKeyMan::RetireNote(const SaplingOutPoint& op, SaplingNoteData* nd, int nSpendHeight)
+{
+    AssertLockHeld(wallet->cs_wallet);
+    ::RewindNoteWitnesses(nd, nSpendHeight, nWitnessCacheSize);
+    if (mapRetiredNotes.emplace(op, nSpendHeight).second) {
+        mapRetiredNotesByHeight.emplace(nSpendHeight, op);
+    }
+    setWitnessedNotes.erase(op);
+}
+
+void SaplingScriptPubKeyMan::AddToWitnessedNotes(const CWalletTx& wtx)
+{
+    AssertLockHeld(wallet->cs_wallet);
+    for (const auto& item : wtx.mapSaplingNoteData) {
+        if (item.second.IsMyNote() && !mapRetiredNotes.count(item.first)) {
+            setWitnessedNotes.emplace(item.first);
+        }
+    }
+}
+
+void SaplingScriptPubKeyMan::RetireSpentNotes()
+{
+    LOCK(wallet->cs_wallet);
+    // Witnessed height of the notes that are still being updated
+    int nMaxWitnessHeight = -1;
+    for (auto it = setWitnessedNotes.begin(); it != setWitnessedNotes.end();) {
+        SaplingNoteData* nd = GetWitnessedNoteData(*it);
+        if (!nd) {
+            it = setWitnessedNotes.erase(it);
+            continue;
+        }
+        int nSpendHeight = -1;
+        if (nd->nullifier) {
+            auto range = mapTxSaplingNullifiers.equal_range(*nd->nullifier);
+            for (auto nit = range.first; nit != range.second; ++nit) {
+                auto mit = wallet->mapWallet.find(nit->second);
+                if (mit != wallet->mapWallet.end() && mit->second.isConfirmed()) {
+                    nSpendHeight = mit->second.m_confirm.block_height;
+                    break;
+                }
+            }
+        }
+        if (nSpendHeight >= 0) {
+            const SaplingOutPoint op = *it++;
+            RetireNote(op, nd, nSpendHeight);
+        } else {
+            nMaxWitnessHeight = std::max(nMaxWitnessHeight, nd->witnessHeight);
+            ++it;
+        }
+    }
+
+    // A note retired in a previous session whose spend was disconnected while the
+    // wallet was not running has a witness left behind the others: drop it, so
+    // it is witnessed again by a rescan instead of corrupting the cache.
+    for (const SaplingOutPoint& op : setWitnessedNotes) {
+        SaplingNoteData* nd = GetWitnessedNoteData(op);
+        if (nd->witnessHeight >= 0 && nd->witnessHeight < nMaxWitnessHeight) {
+            LogPrintf("%s: stale witness for note %s (height %d, expected %d), clearing it\n",
+                      __func__, op.ToString(), nd->witnessHeight, nMaxWitnessHeight);
+            nd->witnesses.clear();
+            nd->witnessHeight = -1;
         }
     }
 }
@@ -256,25 +365,37 @@ void SaplingScriptPubKeyMan::IncrementNoteWitnesses(const CBlockIndex* pindex,
         ::UpdateWitnessHeights(item.first->mapSaplingNoteData, chainHeight, nWitnessCacheSize);
     }
 
-    // 3) Loop over the shield txs in the wallet's map (excluding the wtx arriving in this block) and for each tx:
+    // 3) Loop over the unspent notes of the wallet (excluding the ones arriving in this block) and for each note:
     //    a) Copy the previous witness.
     //    b) Append all new notes commitments
     //    c) Update witness last processed height
-    for (auto& it : wallet->mapWallet) {
-        CWalletTx& wtx = it.second;
-        if (!wtx.mapSaplingNoteData.empty()) {
-            // Create copy of the previous witness (verifying pre-arriving block witness cache size)
-            ::CopyPreviousWitnesses(wtx.mapSaplingNoteData, chainHeight, prevWitCacheSize);
-
-            // Append new notes commitments.
-            for (auto& noteComm : noteCommitments) {
-                for (auto& item : wtx.mapSaplingNoteData) {
-                    AppendNoteCommitment(&(item.second), chainHeight, nWitnessCacheSize, noteComm);
-                }
-            }
+    for (auto it = setWitnessedNotes.begin(); it != setWitnessedNotes.end();) {
+        SaplingNoteData* nd = GetWitnessedNoteData(*it);
+        if (!nd) {
+            // tx removed from the wallet
+            it = setWitnessedNotes.erase(it);
+            continue;
+        }
+        // Create copy of the previous witness (verifying pre-arriving block witness cache size)
+        ::CopyPreviousWitness(nd, chainHeight, prevWitCacheSize);
+        // Append new notes commitments.
+        ::AppendNoteCommitments(nd, chainHeight, nWitnessCacheSize, noteCommitments);
+        // Set last processed height.
+        ::UpdateWitnessHeight(nd, chainHeight, nWitnessCacheSize);
+        ++it;
+    }
 
-            // Set last processed height.
-            ::UpdateWitnessHeights(wtx.mapSaplingNoteData, chainHeight, nWitnessCacheSize);
+    // 4) Retire the notes spent in this block: their witnesses are no longer
+    //    needed, unless the block is disconnected (see DecrementNoteWitnesses).
+    for (const auto& tx : pblock->vtx) {
+        if (!tx->IsShieldedTx()) continue;
+        for (const SpendDescription& spend : tx->sapData->vShieldedSpend) {
+            auto nit = mapSaplingNullifiersToNotes.find(spend.nullifier);
+            if (nit == mapSaplingNullifiersToNotes.end() || !setWitnessedNotes.count(nit->second)) continue;
+            SaplingNoteData* nd = GetWitnessedNoteData(nit->second);
+            if (nd) {
+                RetireNote(nit->second, nd, chainHeight);
+            }
         }
     }
 
@@ -283,53 +404,72 @@ void SaplingScriptPubKeyMan::IncrementNoteWitnesses(const CBlockIndex* pindex,
     // of the wallet.dat is maintained).
 }
 
-template<typename NoteDataMap>
-void DecrementNoteWitnesses(NoteDataMap& noteDataMap, int indexHeight, int64_t nWitnessCacheSize)
+void DecrementNoteWitness(SaplingNoteData* nd, int indexHeight, int64_t nWitnessCacheSize)
 {
-    for (auto& item : noteDataMap) {
-        auto* nd = &(item.second);
-        // skip externally sent notes
-        if (!nd->IsMyNote()) continue;
-        // Only decrement witnesses that are not above the current height
-        if (nd->witnessHeight <= indexHeight) {
-            // Check the validity of the cache
-            // See comment below (this would be invalid if there were a
-            // prior decrement).
-            assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
-            // Witnesses being decremented should always be either -1
-            // (never incremented or decremented) or equal to the height
-            // of the block being removed (indexHeight)
-            assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight));
-            if (nd->witnesses.size() > 0) {
-                nd->witnesses.pop_front();
-            }
-            // indexHeight is the height of the block being removed, so
-            // the new witness cache height is one below it.
-            nd->witnessHeight = indexHeight - 1;
-        }
+    // skip externally sent notes
+    if (!nd->IsMyNote()) return;
+    // Only decrement witnesses that are not above the current height
+    if (nd->witnessHeight <= indexHeight) {
         // Check the validity of the cache
-        // Technically if there are notes witnessed above the current
-        // height, their cache will now be invalid (relative to the new
-        // value of nWitnessCacheSize). However, this would only occur
-        // during a reindex, and by the time the reindex reaches the tip
-        // of the chain again, the existing witness caches will be valid
-        // again.
-        // We don't set nWitnessCacheSize to zero at the start of the
-        // reindex because the on-disk blocks had already resulted in a
-        // chain that didn't trigger the assertion below.
-        if (nd->witnessHeight < indexHeight) {
-            // Subtract 1 to compare to what nWitnessCacheSize will be after
-            // decrementing.
-            assert((nWitnessCacheSize - 1) >= (int64_t) nd->witnesses.size());
+        // See comment below (this would be invalid if there were a
+        // prior decrement).
+        assert(nWitnessCacheSize >= (int64_t) nd->witnesses.size());
+        // Witnesses being decremented should always be either -1
+        // (never incremented or decremented) or equal to the height
+        // of the block being removed (indexHeight)
+        assert((nd->witnessHeight == -1) || (nd->witnessHeight == indexHeight));
+        if (nd->witnesses.size() > 0) {
+            nd->witnesses.pop_front();
         }
+        // indexHeight is the height of the block being removed, so
+        // the new witness cache height is one below it.
+        nd->witnessHeight = indexHeight - 1;
+    }
+    // Check the validity of the cache
+    // Technically if there are notes witnessed above the current
+    // height, their cache will now be invalid (relative to the new
+    // value of nWitnessCacheSize). However, this would only occur
+    // during a reindex, and by the time the reindex reaches the tip
+    // of the chain again, the existing witness caches will be valid
+    // again.
+    // We don't set nWitnessCacheSize to zero at the start of the
+    // reindex because the on-disk blocks had already resulted in a
+    // chain that didn't trigger the assertion below.
+    if (nd->witnessHeight < indexHeight) {
+        // Subtract 1 to compare to what nWitnessCacheSize will be after
+        // decrementing.
+        assert((nWitnessCacheSize - 1) >= (int64_t) nd->witnesses.size());
     }
 }
 
 void SaplingScriptPubKeyMan::DecrementNoteWitnesses(int nChainHeight)
 {
     LOCK(wallet->cs_wallet);
-    for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
-        ::DecrementNoteWitnesses(wtxItem.second.mapSaplingNoteData, nChainHeight, nWitnessCacheSize);
+    // Notes spent in the block being disconnected are unspent again.
+    // Their witnesses were rewound to this height when they were retired, but
+    // the cache may hold more of them than the cache size after the previous
+    // decrements: drop the oldest ones.
+    auto range = mapRetiredNotesByHeight.equal_range(nChainHeight);
+    for (auto it = range.first; it != range.second; ++it) {
+        mapRetiredNotes.erase(it->second);
+        SaplingNoteData* nd = GetWitnessedNoteData(it->second);
+        if (nd) {
+            while ((int64_t) nd->witnesses.size() > nWitnessCacheSize) {
+                nd->witnesses.pop_back();
+            }
+            setWitnessedNotes.emplace(it->second);
+        }
+    }
+    mapRetiredNotesByHeight.erase(range.first, range.second);
+
+    for (auto it = setWitnessedNotes.begin(); it != setWitnessedNotes.end();) {
+        SaplingNoteData* nd = GetWitnessedNoteData(*it);
+        if (!nd) {
+            it = setWitnessedNotes.erase(it);
+            continue;
+        }
+        ::DecrementNoteWitness(nd, nChainHeight, nWitnessCacheSize);
+        ++it;
     }
     nWitnessCacheSize -= 1;
     nWitnessCacheNeedsUpdate = true;
@@ -351,33 +491,85 @@ void SaplingScriptPubKeyMan::DecrementNoteWitnesses(int nChainHeight)
  * the result of FindMySaplingNotes (for the addresses available at the time) will
  * already have been cached in CWalletTx.mapSaplingNoteData.
  */
-std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> SaplingScriptPubKeyMan::FindMySaplingNotes(const CTransaction &tx) const
+SaplingNotesFound SaplingScriptPubKeyMan::FindMySaplingNotes(const CTransaction &tx) const
 {
     // First check that this tx is a Shielded tx.
     if (!tx.IsShieldedTx()) {
         return {};
     }
 
+    return FindMySaplingNotes(SaplingNoteDecryptor::DecryptTx(tx, GetSaplingIncomingViewingKeys()));
+}
+
+SaplingNotesFound SaplingScriptPubKeyMan::FindMySaplingNotes(const SaplingNotesFound& decrypted) const
+{
+    LOCK(wallet->cs_KeyStore);
+    SaplingIncomingViewingKeyMap viewingKeysToAdd;
+    // Check if we already have the addresses.
+    for (const auto& it : decrypted.second) {
+        if (wallet->mapSaplingIncomingViewingKeys.count(it.first) == 0) {
+            viewingKeysToAdd.emplace(it);
+        }
+    }
+    return std::make_pair(decrypted.first, viewingKeysToAdd);
+}
+
+std::vector<libzcash::SaplingIncomingViewingKey> SaplingScriptPubKeyMan::GetSaplingIncomingViewingKeys() const
+{
     LOCK(wallet->cs_KeyStore);
-    const uint256& hash = tx.GetHash();
+    std::vector<libzcash::SaplingIncomingViewingKey> vIvks;
+    vIvks.reserve(wallet->mapSaplingFullViewingKeys.size());
+    for (const auto& it : wallet->mapSaplingFullViewingKeys) {
+        vIvks.emplace_back(it.first);
+    }
+    return vIvks;
+}
 
+SaplingNoteDecryptor* SaplingScriptPubKeyMan::GetNoteDecryptor()
+{
+    LOCK(cs_noteDecryptor);
+    if (!noteDecryptor) {
+        noteDecryptor.reset(new SaplingNoteDecryptor(std::min(GetNumCores(), MAX_SAPLING_DECRYPT_THREADS)));
+    }
+    return noteDecryptor.get();
+}
+
+SaplingNoteDecryptor::SaplingNoteDecryptor(int nThreadsIn) : nThreads(std::max(1, nThreadsIn)) {}
+
+SaplingNoteDecryptor::~SaplingNoteDecryptor() {}
+
+ctpl::thread_pool& SaplingNoteDecryptor::GetPool()
+{
+    LOCK(cs_pool);
+    if (!workerPool) {
+        workerPool.reset(new ctpl::thread_pool(nThreads));
+        RenameThreadPool(*workerPool, "oasis-zdecrypt");
+    }
+    return *workerPool;
+}
+
+SaplingNotesFound SaplingNoteDecryptor::DecryptTx(const CTransaction& tx, const std::vector<libzcash::SaplingIncomingViewingKey>& vIvks)
+{
+    if (!tx.IsShieldedTx()) {
+        return {};
+    }
+
+    const uint256& hash = tx.GetHash();
     mapSaplingNoteData_t noteData;
-    SaplingIncomingViewingKeyMap viewingKeysToAdd;
+    SaplingIncomingViewingKeyMap viewingKeys;
 
     // Protocol Spec: 4.19 Block Chain Scanning (Sapling)
     for (uint32_t i = 0; i < tx.sapData->vShieldedOutput.size(); ++i) {
-        const OutputDescription output = tx.sapData->vShieldedOutput[i];
-        for (auto it = wallet->mapSaplingFullViewingKeys.begin(); it != wallet->mapSaplingFullViewingKeys.end(); ++it) {
-            libzcash::SaplingIncomingViewingKey ivk = it->first;
+        const OutputDescription& output = tx.sapData->vShieldedOutput[i];
+        for (const libzcash::SaplingIncomingViewingKey& ivk : vIvks) {
             auto result = libzcash::SaplingNotePlaintext::decrypt(output.encCiphertext, ivk, output.ephemeralKey, output.cmu);
             if (!result) {
                 continue;
             }
 
-            // Check if we already have it.
             Optional<libzcash::SaplingPaymentAddress> address = ivk.address(result.get().d);
-            if (address && wallet->mapSaplingIncomingViewingKeys.count(address.get()) == 0) {
-                viewingKeysToAdd[address.get()] = ivk;
+            if (address) {
+                viewingKeys[address.get()] = ivk;
             }
             // We don't cache the nullifier here as computing it requires knowledge of the note position
             // in the commitment tree, which can only be determined when the transaction has been mined.
@@ -396,7 +588,79 @@ std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> SaplingScriptPubKe
         }
     }
 
-    return std::make_pair(noteData, viewingKeysToAdd);
+    return std::make_pair(noteData, viewingKeys);
+}
+
+std::map<uint256, SaplingNotesFound> SaplingNoteDecryptor::DecryptBlock(const CBlock& block,
+                                                                        const std::vector<libzcash::SaplingIncomingViewingKey>& vIvks,
+                                                                        size_t& nOutputs,
+                                                                        bool fParallel)
+{
+    std::vector<const CTransaction*> vShieldedTxes;
+    nOutputs = 0;
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsShieldedTx()) continue;
+        vShieldedTxes.emplace_back(tx.get());
+        nOutputs += tx->sapData->vShieldedOutput.size();
+    }
+
+    std::map<uint256, SaplingNotesFound> mapFound;
+    if (nOutputs == 0 || vIvks.empty()) {
+        return mapFound;
+    }
+
+    // Split the txes in batches of about the same number of outputs
+    std::vector<std::pair<size_t, size_t>> vBatches;
+    if (fParallel && nThreads > 1 && nOutputs * vIvks.size() >= MIN_PARALLEL_TRIALS) {
+        const size_t nBatchOutputs = (nOutputs + nThreads - 1) / nThreads;
+        size_t begin = 0, nBatch = 0;
+        for (size_t i = 0; i < vShieldedTxes.size(); i++) {
+            nBatch += vShieldedTxes[i]->sapData->vShieldedOutput.size();
+            if (nBatch >= nBatchOutputs) {
+                vBatches.emplace_back(begin, i + 1);
+                begin = i + 1;
+                nBatch = 0;
+            }
+        }
+        if (begin < vShieldedTxes.size()) vBatches.emplace_back(begin, vShieldedTxes.size());
+    } else {
+        vBatches.emplace_back(0, vShieldedTxes.size());
+    }
+
+    auto decryptRange = [&vShieldedTxes, &vIvks](size_t begin, size_t end) {
+        std::vector<SaplingNotesFound> vFound;
+        for (size_t i = begin; i < end; i++) {
+            vFound.emplace_back(DecryptTx(*vShieldedTxes[i], vIvks));
+        }
+        return vFound;
+    };
+
+    std::vector<std::vector<SaplingNotesFound>> vResults;
+    if (vBatches.size() == 1) {
+        vResults.emplace_back(decryptRange(0, vShieldedTxes.size()));
+    } else {
+        std::vector<std::future<std::vector<SaplingNotesFound>>> futures;
+        for (const auto& batch : vBatches) {
+            const size_t begin = batch.first, end = batch.second;
+            futures.emplace_back(GetPool().push([&decryptRange, begin, end](int threadId) {
+                return decryptRange(begin, end);
+            }));
+        }
+        for (auto& f : futures) {
+            vResults.emplace_back(f.get());
+        }
+    }
+
+    size_t i = 0;
+    for (const auto& vFound : vResults) {
+        for (const SaplingNotesFound& found : vFound) {
+            if (!found.first.empty()) {
+                mapFound.emplace(vShieldedTxes[i]->GetHash(), found);
+            }
+            i++;
+        }
+    }
+    return mapFound;
 }
 
 std::vector<libzcash::SaplingPaymentAddress> SaplingScriptPubKeyMan::FindMySaplingAddresses(const CTransaction& tx) const
@@ -863,11 +1127,14 @@ bool SaplingScriptPubKeyMan::UpdatedNoteData(const CWalletTx& wtxIn, CWalletTx&
 void SaplingScriptPubKeyMan::ClearNoteWitnessCache()
 {
     LOCK(wallet->cs_wallet);
+    mapRetiredNotes.clear();
+    mapRetiredNotesByHeight.clear();
     for (std::pair<const uint256, CWalletTx>& wtxItem : wallet->mapWallet) {
         for (mapSaplingNoteData_t::value_type& item : wtxItem.second.mapSaplingNoteData) {
             item.second.witnesses.clear();
             item.second.witnessHeight = -1;
         }
+        AddToWitnessedNotes(wtxItem.second);
     }
     nWitnessCacheSize = 0;
     nWitnessCacheNeedsUpdate = true;
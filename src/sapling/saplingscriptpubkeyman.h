@@ -7,6 +7,7 @@
 
 #include "consensus/consensus.h"
 #include "sapling/note.h"
+#include "sapling/sapling_notes.h"
 #include "wallet/hdchain.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
@@ -17,6 +18,9 @@
 //  unless there is some exceptional network disruption.
 static const unsigned int WITNESS_CACHE_SIZE = DEFAULT_MAX_REORG_DEPTH + 1;
 
+//! Maximum number of threads used to trial-decrypt shielded outputs
+static const int MAX_SAPLING_DECRYPT_THREADS = 8;
+
 class CBlock;
 class CBlockIndex;
 
@@ -129,7 +133,43 @@ enum KeyAddResult {
     KeyNotAdded,
 };
 
-typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
+namespace ctpl {
+    class thread_pool;
+}
+
+/**
+ * Trial-decrypts the shielded outputs of blocks with the incoming viewing keys of
+ * a wallet, on a pool of worker threads. The decryption doesn't access the wallet,
+ * so it runs without holding cs_wallet (the viewing keys are a snapshot taken by
+ * the caller).
+ */
+class SaplingNoteDecryptor
+{
+public:
+    explicit SaplingNoteDecryptor(int nThreadsIn);
+    ~SaplingNoteDecryptor();
+
+    // Trial-decrypt the outputs of tx with vIvks (addresses are not filtered against the keystore)
+    static SaplingNotesFound DecryptTx(const CTransaction& tx, const std::vector<libzcash::SaplingIncomingViewingKey>& vIvks);
+    // Trial-decrypt the outputs of all the shielded txes of block, splitting the work among the workers
+    // (unless fParallel is false, e.g. when called from a worker).
+    // Returns the txes with at least one note found, and in nOutputs the number of outputs tried.
+    std::map<uint256, SaplingNotesFound> DecryptBlock(const CBlock& block,
+                                                      const std::vector<libzcash::SaplingIncomingViewingKey>& vIvks,
+                                                      size_t& nOutputs,
+                                                      bool fParallel = true);
+    // Workers, also used to read and decrypt blocks ahead during a rescan
+    ctpl::thread_pool& GetPool();
+    int GetNumThreads() const { return nThreads; }
+
+private:
+    // Below this number of trial decryptions (outputs * keys) a block is decrypted on the calling thread
+    static const size_t MIN_PARALLEL_TRIALS = 64;
+    int nThreads;
+    // The pool is created on first use, by any of the callers
+    Mutex cs_pool;
+    std::unique_ptr<ctpl::thread_pool> workerPool GUARDED_BY(cs_pool);
+};
 
 /*
  * Sapling keys manager
@@ -164,6 +204,18 @@ public:
      */
     void DecrementNoteWitnesses(int nChainHeight);
 
+    /**
+     * Add the own notes of this tx to the set of notes whose witnesses are
+     * updated at every block (unless they were already spent in a block).
+     */
+    void AddToWitnessedNotes(const CWalletTx& wtx);
+
+    /**
+     * Move the notes spent in a block out of the witnessed set.
+     * Called once the wallet txes are loaded.
+     */
+    void RetireSpentNotes();
+
     /**
      * Update mapSaplingNullifiersToNotes
      * with the cached nullifiers in this tx.
@@ -268,7 +320,14 @@ public:
 
     //! Finds all output notes in the given tx that have been sent to a
     //! SaplingPaymentAddress in this wallet
-    std::pair<mapSaplingNoteData_t, SaplingIncomingViewingKeyMap> FindMySaplingNotes(const CTransaction& tx) const;
+    SaplingNotesFound FindMySaplingNotes(const CTransaction& tx) const;
+    //! Same as above, from the result of a trial decryption done in advance (see SaplingNoteDecryptor)
+    SaplingNotesFound FindMySaplingNotes(const SaplingNotesFound& decrypted) const;
+
+    //! Snapshot of the incoming viewing keys of the wallet, for SaplingNoteDecryptor
+    std::vector<libzcash::SaplingIncomingViewingKey> GetSaplingIncomingViewingKeys() const;
+    //! Worker threads used to trial-decrypt blocks (created on first use)
+    SaplingNoteDecryptor* GetNoteDecryptor();
 
     //! Find all of the addresses in the given tx that have been sent to a SaplingPaymentAddress in this wallet.
     std::vector<libzcash::SaplingPaymentAddress> FindMySaplingAddresses(const CTransaction& tx) const;
@@ -353,6 +412,19 @@ public:
     int64_t nWitnessCacheSize{0};
     bool nWitnessCacheNeedsUpdate{false};
 
+    /*
+     * Own notes whose witnesses are updated by Increment/DecrementNoteWitnesses,
+     * so that the cost per block depends on the unspent notes and not on the
+     * whole wallet history.
+     * A note spent in a block is moved to mapRetiredNotes (with the spend height)
+     * and its witnesses are rewound to that height. It is put back in the
+     * witnessed set if the block is disconnected (found through
+     * mapRetiredNotesByHeight, without walking all the retired notes).
+     */
+    std::set<SaplingOutPoint> setWitnessedNotes;
+    std::map<SaplingOutPoint, int> mapRetiredNotes;
+    std::multimap<int, SaplingOutPoint> mapRetiredNotesByHeight;
+
     /**
      * The reverse mapping of nullifiers to notes.
      *
@@ -413,6 +485,15 @@ private:
     Optional<uint256> commonOVK;
     uint256 getCommonOVKFromSeed() const;
 
+    // Created on first use, by the rescan or by BlockConnected
+    Mutex cs_noteDecryptor;
+    std::unique_ptr<SaplingNoteDecryptor> noteDecryptor GUARDED_BY(cs_noteDecryptor);
+
+    //! Own note data of a witnessed note, or nullptr if it is no longer in the wallet
+    SaplingNoteData* GetWitnessedNoteData(const SaplingOutPoint& op);
+    //! Move a note spent at nSpendHeight from the witnessed set to the retired ones
+    void RetireNote(const SaplingOutPoint& op, SaplingNoteData* nd, int nSpendHeight);
+
 
     /**
      * Used to keep track of spent Notes, and
@@ -5,14 +5,30 @@
 
 #include "sapling/transaction_builder.h"
 
+#include "ctpl.h"
 #include "script/sign.h"
 #include "utilmoneystr.h"
 #include "consensus/upgrades.h"
 #include "policy/policy.h"
+#include "util/system.h"
+#include "util/threadnames.h"
 #include "validation.h"
 
+#include <atomic>
 #include <librustzcash.h>
 
+// Threads making the Sapling proofs, shared by every builder.
+// Sized for the largest SetProvingThreads, the default still uses one per core.
+static ctpl::thread_pool& GetProvingPool()
+{
+    static ctpl::thread_pool* provingPool = []() {
+        auto pool = new ctpl::thread_pool(MAX_SAPLING_PROVING_THREADS);
+        RenameThreadPool(*pool, "oasis-zprover");
+        return pool;
+    }();
+    return *provingPool;
+}
+
 SpendDescriptionInfo::SpendDescriptionInfo(const libzcash::SaplingExpandedSpendingKey& _expsk,
                                            const libzcash::SaplingNote& _note,
                                            const uint256& _anchor,
@@ -71,6 +87,34 @@ Optional<OutputDescription> OutputDescriptionInfo::Build(void* ctx) {
     return odesc;
 }
 
+Optional<SpendDescription> SpendDescriptionInfo::Build(void* ctx, const uint256& nullifier) const
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << witness.path();
+    std::vector<unsigned char> witnessBytes(ss.begin(), ss.end());
+
+    SpendDescription sdesc;
+    if (!librustzcash_sapling_spend_proof(
+            ctx,
+            expsk.full_viewing_key().ak.begin(),
+            expsk.nsk.begin(),
+            note.d.data(),
+            note.r.begin(),
+            alpha.begin(),
+            note.value(),
+            anchor.begin(),
+            witnessBytes.data(),
+            sdesc.cv.begin(),
+            sdesc.rk.begin(),
+            sdesc.zkproof.data())) {
+        return nullopt;
+    }
+
+    sdesc.anchor = anchor;
+    sdesc.nullifier = nullifier;
+    return sdesc;
+}
+
 // Dummy constants used during fee-calculation loop
 static OutputDescription CreateDummyOD()
 {
@@ -215,6 +259,17 @@ void TransactionBuilder::SetFee(CAmount _fee)
     this->fee = _fee;
 }
 
+void TransactionBuilder::SetProvingThreads(int nThreads)
+{
+    nProvingThreads = std::max(0, nThreads);
+}
+
+int TransactionBuilder::GetProvingThreads() const
+{
+    const int nThreads = nProvingThreads > 0 ? nProvingThreads : GetNumCores();
+    return std::max(1, std::min(nThreads, MAX_SAPLING_PROVING_THREADS));
+}
+
 void TransactionBuilder::SendChangeTo(const libzcash::SaplingPaymentAddress& changeAddr, const uint256& ovk)
 {
     saplingChangeAddr = std::make_pair(ovk, changeAddr);
@@ -238,60 +293,80 @@ TransactionBuilderResult TransactionBuilder::ProveAndSign()
     //
     if (!spends.empty() || !outputs.empty()) {
 
-        auto ctx = librustzcash_sapling_proving_ctx_init();
-
-        // Create Sapling OutputDescriptions
-        for (auto output : outputs) {
-            // Check this out here as well to provide better logging.
+        // Check the notes here to provide better logging, before making any proof.
+        for (const auto& output : outputs) {
             if (!output.note.cmu()) {
-                librustzcash_sapling_proving_ctx_free(ctx);
                 return TransactionBuilderResult("Output is invalid");
             }
-
-            auto odesc = output.Build(ctx);
-            if (!odesc) {
-                librustzcash_sapling_proving_ctx_free(ctx);
-                return TransactionBuilderResult("Failed to create output description");
-            }
-
-            mtx.sapData->vShieldedOutput.push_back(odesc.get());
         }
-
-        // Create Sapling SpendDescriptions
-        for (auto spend : spends) {
+        std::vector<uint256> vNullifiers;
+        for (const auto& spend : spends) {
             auto cm = spend.note.cmu();
             auto nf = spend.note.nullifier(
                     spend.expsk.full_viewing_key(), spend.witness.position());
             if (!cm || !nf) {
-                librustzcash_sapling_proving_ctx_free(ctx);
                 return TransactionBuilderResult("Spend is invalid");
             }
+            vNullifiers.emplace_back(*nf);
+        }
+
+        // Create the Sapling OutputDescriptions and SpendDescriptions, in parallel. The
+        // descriptions keep the order of the outputs and spends, whatever the worker making
+        // them. Each worker has its own proving context; they are added up into ctx for the
+        // binding signature.
+        auto ctx = librustzcash_sapling_proving_ctx_init();
+        std::vector<Optional<OutputDescription>> vOutputs(outputs.size());
+        std::vector<Optional<SpendDescription>> vSpends(spends.size());
+        const size_t nProofs = outputs.size() + spends.size();
+        std::atomic<size_t> nNextProof{0};
+        std::atomic<bool> fFailed{false};
+        auto makeProofs = [&](void* workerCtx) {
+            size_t i;
+            while (!fFailed && (i = nNextProof++) < nProofs) {
+                if (i < outputs.size()) {
+                    vOutputs[i] = outputs[i].Build(workerCtx);
+                    if (!vOutputs[i]) fFailed = true;
+                } else {
+                    const size_t j = i - outputs.size();
+                    vSpends[j] = spends[j].Build(workerCtx, vNullifiers[j]);
+                    if (!vSpends[j]) fFailed = true;
+                }
+            }
+        };
 
-            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-            ss << spend.witness.path();
-            std::vector<unsigned char> witness(ss.begin(), ss.end());
-
-            SpendDescription sdesc;
-            if (!librustzcash_sapling_spend_proof(
-                    ctx,
-                    spend.expsk.full_viewing_key().ak.begin(),
-                    spend.expsk.nsk.begin(),
-                    spend.note.d.data(),
-                    spend.note.r.begin(),
-                    spend.alpha.begin(),
-                    spend.note.value(),
-                    spend.anchor.begin(),
-                    witness.data(),
-                    sdesc.cv.begin(),
-                    sdesc.rk.begin(),
-                    sdesc.zkproof.data())) {
+        ctpl::thread_pool& pool = GetProvingPool();
+        const int nWorkers = std::min({(int) nProofs, GetProvingThreads(), pool.size()});
+        if (nWorkers <= 1) {
+            makeProofs(ctx);
+        } else {
+            std::vector<std::future<void*>> futures;
+            for (int k = 0; k < nWorkers; k++) {
+                futures.emplace_back(pool.push([&makeProofs](int threadId) {
+                    void* workerCtx = librustzcash_sapling_proving_ctx_init();
+                    makeProofs(workerCtx);
+                    return workerCtx;
+                }));
+            }
+            for (auto& f : futures) {
+                void* workerCtx = f.get();
+                librustzcash_sapling_proving_ctx_add(ctx, workerCtx);
+                librustzcash_sapling_proving_ctx_free(workerCtx);
+            }
+        }
+
+        for (auto& odesc : vOutputs) {
+            if (!odesc) {
+                librustzcash_sapling_proving_ctx_free(ctx);
+                return TransactionBuilderResult("Failed to create output description");
+            }
+            mtx.sapData->vShieldedOutput.push_back(*odesc);
+        }
+        for (auto& sdesc : vSpends) {
+            if (!sdesc) {
                 librustzcash_sapling_proving_ctx_free(ctx);
                 return TransactionBuilderResult("Spend proof failed");
             }
-
-            sdesc.anchor = spend.anchor;
-            sdesc.nullifier = *nf;
-            mtx.sapData->vShieldedSpend.push_back(sdesc);
+            mtx.sapData->vShieldedSpend.push_back(*sdesc);
         }
 
         //
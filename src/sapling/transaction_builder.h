@@ -19,6 +19,9 @@
 #include "sapling/note.h"
 #include "sapling/noteencryption.h"
 
+//! Maximum number of threads used to make the Sapling proofs of a transaction
+static const int MAX_SAPLING_PROVING_THREADS = 8;
+
 struct SpendDescriptionInfo {
     libzcash::SaplingExpandedSpendingKey expsk;
     libzcash::SaplingNote note;
@@ -31,6 +34,8 @@ struct SpendDescriptionInfo {
         const libzcash::SaplingNote& _note,
         const uint256& _anchor,
         const SaplingWitness& _witness);
+
+    Optional<SpendDescription> Build(void* ctx, const uint256& nullifier) const;
 };
 
 struct OutputDescriptionInfo {
@@ -87,6 +92,7 @@ private:
     const CKeyStore* keystore;
     CMutableTransaction mtx;
     CAmount fee = -1;   // Verified in Build(). Must be set before.
+    int nProvingThreads = 0;    // 0: one per core, up to MAX_SAPLING_PROVING_THREADS
 
     std::vector<SpendDescriptionInfo> spends;
     std::vector<OutputDescriptionInfo> outputs;
@@ -104,6 +110,10 @@ public:
 
     void SetFee(CAmount _fee);
 
+    // Number of threads making the Sapling proofs in ProveAndSign (0: one per core)
+    void SetProvingThreads(int nThreads);
+    int GetProvingThreads() const;
+
     // Throws if the anchor does not match the anchor used by
     // previously-added Sapling spends.
     void AddSaplingSpend(
@@ -0,0 +1,158 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "socketevents.h"
+
+#include "netbase.h"
+#include "util/system.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+//! Maximum number of events returned by a single epoll_wait() call
+static const int MAX_EPOLL_EVENTS = 256;
+
+bool SocketEventsModeFromString(const std::string& str, SocketEventsMode& mode)
+{
+    if (str == "select") {
+        mode = SocketEventsMode::SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (str == "epoll") {
+        mode = SocketEventsMode::EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string SocketEventsModeToString(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SocketEventsMode::SELECT: return "select";
+    case SocketEventsMode::EPOLL: return "epoll";
+    }
+    assert(false);
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+#ifdef USE_EPOLL
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
+
+CSocketEvents::CSocketEvents(SocketEventsMode modeIn) : mode(modeIn) {}
+
+CSocketEvents::~CSocketEvents()
+{
+#ifdef USE_EPOLL
+    if (epollfd != -1) close(epollfd);
+#endif
+}
+
+bool CSocketEvents::Init(std::string& strError)
+{
+    if (mode == SocketEventsMode::SELECT) return true;
+#ifdef USE_EPOLL
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        strError = strprintf("epoll_create1 failed: %s", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    return true;
+#else
+    strError = "epoll is not supported by this build";
+    return false;
+#endif
+}
+
+bool CSocketEvents::Add(SOCKET hSocket, uint64_t nTag, bool fListen)
+{
+#ifdef USE_EPOLL
+    if (mode == SocketEventsMode::EPOLL) {
+        struct epoll_event event;
+        event.data.u64 = nTag;
+        event.events = fListen ? EPOLLIN : (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+            LogPrintf("%s: epoll_ctl failed: %s\n", __func__, NetworkErrorString(WSAGetLastError()));
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+bool CSocketEvents::Wait(const std::vector<SocketInterest>& vInterest, int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents)
+{
+    vEvents.clear();
+#ifdef USE_EPOLL
+    if (mode == SocketEventsMode::EPOLL) return WaitEpoll(nTimeoutMs, vEvents);
+#endif
+    return WaitSelect(vInterest, nTimeoutMs, vEvents);
+}
+
+bool CSocketEvents::WaitSelect(const std::vector<SocketInterest>& vInterest, int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents)
+{
+    struct timeval timeout = MillisToTimeval(nTimeoutMs);
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (const SocketInterest& interest : vInterest) {
+        FD_SET(interest.hSocket, &fdsetError);
+        if (interest.fRecv) FD_SET(interest.hSocket, &fdsetRecv);
+        if (interest.fSend) FD_SET(interest.hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, interest.hSocket);
+    }
+
+    int nSelect = select(vInterest.empty() ? 0 : hSocketMax + 1, &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (nSelect == SOCKET_ERROR) {
+        if (vInterest.empty()) return true;
+        LogPrintf("socket select error %s\n", NetworkErrorString(WSAGetLastError()));
+        for (const SocketInterest& interest : vInterest) {
+            vEvents.push_back({interest.nTag, true, false, false});
+        }
+        return false;
+    }
+
+    for (const SocketInterest& interest : vInterest) {
+        SocketEvent event{interest.nTag,
+                          FD_ISSET(interest.hSocket, &fdsetRecv) != 0,
+                          FD_ISSET(interest.hSocket, &fdsetSend) != 0,
+                          FD_ISSET(interest.hSocket, &fdsetError) != 0};
+        if (event.fRecv || event.fSend || event.fError) vEvents.push_back(event);
+    }
+    return true;
+}
+
+#ifdef USE_EPOLL
+bool CSocketEvents::WaitEpoll(int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents)
+{
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, (int)nTimeoutMs);
+    if (nEvents < 0) {
+        if (errno == EINTR) return true;
+        LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    for (int i = 0; i < nEvents; i++) {
+        const uint32_t e = events[i].events;
+        vEvents.push_back({events[i].data.u64,
+                           (e & (EPOLLIN | EPOLLRDHUP)) != 0,
+                           (e & EPOLLOUT) != 0,
+                           (e & (EPOLLERR | EPOLLHUP)) != 0});
+    }
+    return true;
+}
+#endif
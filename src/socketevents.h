@@ -0,0 +1,103 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_SOCKETEVENTS_H
+#define OASIS_SOCKETEVENTS_H
+
+#if defined(HAVE_CONFIG_H)
+#include "config/oasis-config.h"
+#endif
+
+#include "compat.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_SYS_EPOLL_H) && !defined(WIN32)
+#define USE_EPOLL
+#endif
+
+/** Readiness notification mechanism used by the socket handler threads */
+enum class SocketEventsMode {
+    SELECT,
+    EPOLL,
+};
+
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SocketEventsMode::EPOLL;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SocketEventsMode::SELECT;
+#endif
+
+bool SocketEventsModeFromString(const std::string& str, SocketEventsMode& mode);
+std::string SocketEventsModeToString(SocketEventsMode mode);
+//! Comma separated list of the modes available in this build
+std::string GetSupportedSocketEventsModes();
+
+/** A socket to watch in the next CSocketEvents::Wait() call (select mode) */
+struct SocketInterest
+{
+    SOCKET hSocket;
+    uint64_t nTag;
+    bool fRecv;
+    bool fSend;
+
+    SocketInterest(SOCKET hSocketIn, uint64_t nTagIn, bool fRecvIn, bool fSendIn) :
+        hSocket(hSocketIn), nTag(nTagIn), fRecv(fRecvIn), fSend(fSendIn) {}
+};
+
+/** Readiness of a socket, as reported by CSocketEvents::Wait() */
+struct SocketEvent
+{
+    uint64_t nTag;
+    bool fRecv;
+    bool fSend;
+    bool fError;
+};
+
+/**
+ * Waits for readiness on a set of sockets, identified by an opaque tag.
+ *
+ * In select mode the sockets to watch, and in which direction, are passed to every Wait() call
+ * (level-triggered). In epoll mode sockets are registered once with Add(), and stay registered until
+ * they are closed. Peer sockets are edge-triggered: an event is reported when the socket becomes
+ * readable or writable, so the caller has to remember the readiness until it has drained the socket.
+ */
+class CSocketEvents
+{
+public:
+    explicit CSocketEvents(SocketEventsMode modeIn);
+    ~CSocketEvents();
+
+    CSocketEvents(const CSocketEvents&) = delete;
+    CSocketEvents& operator=(const CSocketEvents&) = delete;
+
+    bool Init(std::string& strError);
+    SocketEventsMode GetMode() const { return mode; }
+    bool IsEdgeTriggered() const { return mode == SocketEventsMode::EPOLL; }
+
+    //! Register a socket (epoll only). Listening sockets are level-triggered.
+    bool Add(SOCKET hSocket, uint64_t nTag, bool fListen = false);
+
+    /**
+     * Wait up to nTimeoutMs for readiness and return the ready sockets in vEvents.
+     * vInterest is only used in select mode. On failure, select mode reports every
+     * socket of vInterest as readable, so that the error surfaces on recv().
+     */
+    bool Wait(const std::vector<SocketInterest>& vInterest, int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents);
+
+private:
+    const SocketEventsMode mode;
+#ifdef USE_EPOLL
+    int epollfd{-1};
+#endif
+
+    bool WaitSelect(const std::vector<SocketInterest>& vInterest, int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents);
+#ifdef USE_EPOLL
+    bool WaitEpoll(int64_t nTimeoutMs, std::vector<SocketEvent>& vEvents);
+#endif
+};
+
+#endif // OASIS_SOCKETEVENTS_H
@@ -0,0 +1,244 @@
+// Copyright (c) 2011-2020 The Bitcoin Core developers
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_oasis.h"
+
+#include "blockencodings.h"
+#include "consensus/merkle.h"
+#include "policy/feerate.h"
+#include "streams.h"
+#include "txmempool.h"
+
+#include <boost/test/unit_test.hpp>
+
+std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+
+BOOST_FIXTURE_TEST_SUITE(blockencodings_tests, BasicTestingSetup)
+
+static CMutableTransaction SpendingTx(const uint256& prevHash, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prevHash, 0);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = nValue;
+    return tx;
+}
+
+// A block with a coinbase and three transactions, the third one spending the second one.
+// With fProofOfStake, the first of them is a coinstake and the block is signed.
+static CBlock BuildBlockTestCase(bool fProofOfStake)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_1;
+    coinbase.vout.resize(1);
+    if (fProofOfStake) {
+        coinbase.vout[0].SetEmpty();
+    } else {
+        coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        coinbase.vout[0].nValue = 250 * COIN;
+    }
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    CMutableTransaction tx1 = SpendingTx(InsecureRand256(), 42);
+    if (fProofOfStake) {
+        // Empty first output: a coinstake
+        CTxOut empty;
+        empty.SetEmpty();
+        tx1.vout.insert(tx1.vout.begin(), empty);
+    }
+    block.vtx.push_back(MakeTransactionRef(tx1));
+    CMutableTransaction tx2 = SpendingTx(InsecureRand256(), 43);
+    block.vtx.push_back(MakeTransactionRef(tx2));
+    block.vtx.push_back(MakeTransactionRef(SpendingTx(tx2.GetHash(), 42)));
+    if (fProofOfStake) {
+        block.vchBlockSig = std::vector<unsigned char>(72, 0x5a);
+    }
+
+    block.nVersion = 8;
+    block.hashPrevBlock = InsecureRand256();
+    block.nBits = 0x207fffff;
+    block.nTime = 1600000000;
+    block.nNonce = 1;
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    block.hashFinalSaplingRoot = InsecureRand256();
+    BOOST_CHECK_EQUAL(block.IsProofOfStake(), fProofOfStake);
+    return block;
+}
+
+static CBlockHeaderAndShortTxIDs RoundTrip(const CBlockHeaderAndShortTxIDs& shortIDs)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << shortIDs;
+    CBlockHeaderAndShortTxIDs shortIDs2;
+    stream >> shortIDs2;
+    return shortIDs2;
+}
+
+static void CheckReconstruction(bool fProofOfStake)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase(fProofOfStake));
+
+    // Only the last two transactions are in the mempool
+    LOCK(pool.cs);
+    pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(*block.vtx[2]));
+    pool.addUnchecked(block.vtx[3]->GetHash(), entry.FromTx(*block.vtx[3]));
+
+    CBlockHeaderAndShortTxIDs shortIDs2 = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(shortIDs2.BlockTxCount(), block.vtx.size());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    // The coinstake is always sent along
+    BOOST_CHECK_EQUAL(partialBlock.IsTxAvailable(1), fProofOfStake);
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    BOOST_CHECK(partialBlock.IsTxAvailable(3));
+
+    std::vector<CTransactionRef> vtx_missing;
+    if (!fProofOfStake) vtx_missing.push_back(block.vtx[1]);
+
+    // A wrong transaction gives a different merkle root
+    PartiallyDownloadedBlock partialBlockCopy = partialBlock;
+    CBlock block2;
+    if (!fProofOfStake) {
+        BOOST_CHECK(partialBlockCopy.FillBlock(block2, {block.vtx[2]}) == READ_STATUS_FAILED);
+    } else {
+        BOOST_CHECK(partialBlockCopy.FillBlock(block2, {block.vtx[2]}) == READ_STATUS_INVALID);
+    }
+
+    CBlock block3;
+    BOOST_CHECK(partialBlock.FillBlock(block3, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block3.GetHash().ToString());
+    BOOST_CHECK(block3.vchBlockSig == block.vchBlockSig);
+    bool mutated;
+    BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), BlockMerkleRoot(block3, &mutated).ToString());
+    BOOST_CHECK(!mutated);
+
+    // The reconstructed block serializes exactly like the original one
+    CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss3(SER_NETWORK, PROTOCOL_VERSION);
+    ss1 << block;
+    ss3 << block3;
+    BOOST_CHECK(ss1.str() == ss3.str());
+}
+
+BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
+{
+    CheckReconstruction(false);
+}
+
+BOOST_AUTO_TEST_CASE(ProofOfStakeRoundTripTest)
+{
+    CheckReconstruction(true);
+}
+
+BOOST_AUTO_TEST_CASE(CompactBlockSizeTest)
+{
+    CBlock block(BuildBlockTestCase(true));
+    CBlockHeaderAndShortTxIDs shortIDs(block);
+    // The transactions that are not prefilled take 6 bytes each
+    const size_t nShortIdsSize = GetSerializeSize(shortIDs, PROTOCOL_VERSION);
+    const size_t nBlockSize = GetSerializeSize(block, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(nBlockSize - nShortIdsSize,
+                      GetSerializeSize(*block.vtx[2], PROTOCOL_VERSION) + GetSerializeSize(*block.vtx[3], PROTOCOL_VERSION) -
+                      2 * CBlockHeaderAndShortTxIDs::SHORTTXIDS_LENGTH - 8 /* nonce */ - 2 /* prefilled indexes */ - 1 /* one more vector size */);
+}
+
+BOOST_AUTO_TEST_CASE(ExtraTxnTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase(false));
+
+    // The missing transactions are found in the extra pool (the orphans)
+    std::vector<std::pair<uint256, CTransactionRef>> extra;
+    extra.emplace_back(block.vtx[1]->GetHash(), block.vtx[1]);
+    extra.emplace_back(block.vtx[3]->GetHash(), block.vtx[3]);
+
+    CBlockHeaderAndShortTxIDs shortIDs = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs, extra) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+    BOOST_CHECK(partialBlock.IsTxAvailable(3));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_INVALID);
+    PartiallyDownloadedBlock partialBlock2(&pool);
+    BOOST_CHECK(partialBlock2.InitData(shortIDs, extra) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock2.FillBlock(block2, {block.vtx[2]}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase(false));
+    block.vtx.resize(1);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    CBlockHeaderAndShortTxIDs shortIDs2 = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest)
+{
+    BlockTransactionsRequest req1;
+    req1.blockhash = InsecureRand256();
+    req1.indexes.resize(4);
+    req1.indexes[0] = 0;
+    req1.indexes[1] = 1;
+    req1.indexes[2] = 3;
+    req1.indexes[3] = 4;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req1;
+
+    BlockTransactionsRequest req2;
+    stream >> req2;
+
+    BOOST_CHECK_EQUAL(req1.blockhash.ToString(), req2.blockhash.ToString());
+    BOOST_CHECK(req1.indexes == req2.indexes);
+}
+
+BOOST_AUTO_TEST_CASE(TransactionsRequestDeserializationOverflowTest)
+{
+    // Check that the differential encoding of the indexes can't overflow their 16 bits
+    BlockTransactionsRequest req0;
+    req0.blockhash = InsecureRand256();
+    req0.indexes.resize(2);
+    req0.indexes[0] = 0x7000;
+    req0.indexes[1] = 0x10000 - 0x7000 - 2;
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req0.blockhash;
+    WriteCompactSize(stream, req0.indexes.size());
+    WriteCompactSize(stream, req0.indexes[0]);
+    WriteCompactSize(stream, req0.indexes[1]);
+
+    BlockTransactionsRequest req1;
+    stream >> req1;
+    BOOST_CHECK_EQUAL(req1.indexes[1], 0xffff);
+
+    CDataStream stream2(SER_NETWORK, PROTOCOL_VERSION);
+    stream2 << req0.blockhash;
+    WriteCompactSize(stream2, req0.indexes.size());
+    WriteCompactSize(stream2, req0.indexes[0]);
+    WriteCompactSize(stream2, req0.indexes[1] + 1);
+    BlockTransactionsRequest req2;
+    BOOST_CHECK_THROW(stream2 >> req2, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
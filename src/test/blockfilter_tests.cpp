@@ -0,0 +1,100 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "key.h"
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "test/test_oasis.h"
+#include "undo.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(std::move(element1));
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(std::move(element2));
+    }
+
+    GCSFilter filter({0, 0, 10, 1 << 10}, included_elements);
+    for (const auto& element : included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        auto insertion = excluded_elements.insert(element);
+        BOOST_CHECK(filter.MatchAny(excluded_elements));
+        excluded_elements.erase(insertion.first);
+    }
+
+    // Round trip through the encoding
+    GCSFilter filter2(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(filter2.GetN(), 100U);
+    for (const auto& element : included_elements) {
+        BOOST_CHECK(filter2.Match(element));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    GCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1U);
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(32)));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CKey key1, key2, key3, key4;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    key3.MakeNewKey(true);
+    key4.MakeNewKey(true);
+    const CKeyID id1 = key1.GetPubKey().GetID();
+    const CKeyID id2 = key2.GetPubKey().GetID();
+    const CKeyID id3 = key3.GetPubKey().GetID();
+    const CKeyID id4 = key4.GetPubKey().GetID();
+
+    CMutableTransaction tx_1;
+    tx_1.vout.emplace_back(100, GetScriptForDestination(id1));
+    tx_1.vout.emplace_back(200, GetScriptForStakeDelegation(id2, id3));
+    tx_1.vout.emplace_back(0, CScript() << OP_RETURN << 4 << OP_ADD << 8 << OP_EQUAL);
+
+    CBlock block;
+    block.vtx.emplace_back(MakeTransactionRef(tx_1));
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.emplace_back();
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(300, GetScriptForDestination(id4)), 1000, true, false);
+
+    BlockFilter block_filter(block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+
+    // The destinations of the outputs (both keys of the cold staking script) and of the spent coins
+    BOOST_CHECK(filter.Match(GCSFilter::Element(id1.begin(), id1.end())));
+    BOOST_CHECK(filter.Match(GCSFilter::Element(id2.begin(), id2.end())));
+    BOOST_CHECK(filter.Match(GCSFilter::Element(id3.begin(), id3.end())));
+    BOOST_CHECK(filter.Match(GCSFilter::Element(id4.begin(), id4.end())));
+    BOOST_CHECK_EQUAL(filter.GetN(), 4U);
+    BOOST_CHECK(!filter.Match(SHIELDED_TX_ELEMENT));
+
+    // Serialization round trip
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    BlockFilter block_filter2;
+    stream >> block_filter2;
+    BOOST_CHECK(block_filter2.GetBlockHash() == block_filter.GetBlockHash());
+    BOOST_CHECK(block_filter2.GetEncodedFilter() == block_filter.GetEncodedFilter());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include "test/test_oasis.h"
 
 #include "blockassembler.h"
+#include "bls/bls_worker.h"
 #include "consensus/merkle.h"
 #include "evo/specialtx.h"
 #include "evo/deterministicmns.h"
@@ -490,6 +491,55 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChain400Setup)
     // 30 blocks, 15 masternodes. Must have been paid exactly 2 times each.
     CheckPayments(mapPayments, 15, 2);
 
+    // The list of the tip is cached, the older lists are built from the cached checkpoints
+    {
+        auto stats = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(deterministicMNManager->GetListForBlock(chainTip).GetHeight(), chainTip->nHeight);
+        BOOST_CHECK_EQUAL(deterministicMNManager->GetListsCacheStats().nHits, stats.nHits + 1);
+        const CBlockIndex* pindexOld = chainTip->GetAncestor(chainTip->nHeight - 20);
+        auto oldList = deterministicMNManager->GetListForBlock(pindexOld);
+        BOOST_CHECK(oldList.GetBlockHash() == pindexOld->GetBlockHash());
+        BOOST_CHECK_EQUAL(oldList.GetHeight(), pindexOld->nHeight);
+        BOOST_CHECK_EQUAL(oldList.GetAllMNsCount(), 15U);
+
+        // Near the tip, the lists at the multiples of the min stride are kept as checkpoints
+        const int nStride = CDeterministicMNManager::LIST_CHECKPOINT_MIN_STRIDE;
+        const int nCheckpointHeight = chainTip->nHeight - (chainTip->nHeight % nStride) - nStride;
+        BOOST_REQUIRE(deterministicMNManager->IsDIP3Enforced(nCheckpointHeight));
+        const CBlockIndex* pindexCheckpoint = chainTip->GetAncestor(nCheckpointHeight);
+        stats = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(deterministicMNManager->GetListForBlock(pindexCheckpoint).GetHeight(), nCheckpointHeight);
+        auto stats2 = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(stats2.nHits, stats.nHits + 1);
+        BOOST_CHECK_EQUAL(stats2.nDiffsApplied, stats.nDiffsApplied);
+
+        // A list past it is built from the checkpoint, not from the last disk snapshot
+        const CBlockIndex* pindexNear = chainTip->GetAncestor(nCheckpointHeight + 5);
+        BOOST_CHECK(deterministicMNManager->GetListForBlock(pindexNear).GetBlockHash() == pindexNear->GetBlockHash());
+        stats = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(stats.nMisses, stats2.nMisses + 1);
+        BOOST_CHECK_EQUAL(stats.nDiffsApplied - stats2.nDiffsApplied, 5U);
+
+        // Query every list down to the enforcement: no list is more than a stride (at its distance
+        // from the tip) away from a checkpoint, the cache stays bounded and keeps the tip list
+        for (const CBlockIndex* pindex = chainTip; deterministicMNManager->IsDIP3Enforced(pindex->nHeight); pindex = pindex->pprev) {
+            int nMaxDiffs = nStride;
+            while (chainTip->nHeight - pindex->nHeight > nMaxDiffs * CDeterministicMNManager::LIST_CHECKPOINTS_PER_STRIDE) {
+                nMaxDiffs *= 2;
+            }
+            stats = deterministicMNManager->GetListsCacheStats();
+            BOOST_CHECK(deterministicMNManager->GetListForBlock(pindex).GetBlockHash() == pindex->GetBlockHash());
+            stats2 = deterministicMNManager->GetListsCacheStats();
+            BOOST_CHECK(stats2.nDiffsApplied - stats.nDiffsApplied <= (uint64_t)nMaxDiffs);
+            BOOST_CHECK(stats2.nLists <= CDeterministicMNManager::MAX_LISTS_CACHE_SIZE);
+        }
+        stats = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(deterministicMNManager->GetListAtChainTip().GetHeight(), chainTip->nHeight);
+        stats2 = deterministicMNManager->GetListsCacheStats();
+        BOOST_CHECK_EQUAL(stats2.nHits, stats.nHits + 1);
+        BOOST_CHECK_EQUAL(stats2.nDiffsApplied, stats.nDiffsApplied);
+    }
+
     // Check that the prev DMN winner is different that the tip one
     std::vector<CTxOut> vecMnOutsPrev;
     BOOST_CHECK(masternodePayments.GetMasternodeTxOuts(chainTip->pprev, vecMnOutsPrev));
@@ -529,6 +579,39 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChain400Setup)
         BOOST_CHECK(!CheckSpecialTx(tx2, chainTip, dummyState));
         BOOST_CHECK_EQUAL(dummyState.GetRejectReason(), "bad-protx-sig");
 
+        // the same, with the signatures verified in batches by a BLS worker
+        CBLSWorker worker;
+        worker.Start();
+        {
+            CSpecialTxSigBatch sigBatch(worker);
+            CValidationState batchState;
+            BOOST_CHECK(CheckSpecialTx(tx, chainTip, batchState, &sigBatch));
+            BOOST_CHECK(sigBatch.Verify(batchState));
+            BOOST_CHECK(CheckSpecialTx(tx, chainTip, batchState, &sigBatch));
+            BOOST_CHECK(CheckSpecialTx(tx2, chainTip, batchState, &sigBatch));
+            BOOST_CHECK(!sigBatch.Verify(batchState));
+            BOOST_CHECK_EQUAL(batchState.GetRejectReason(), "bad-protx-sig");
+        }
+        // an all-zero signature is rejected right away, it can't be aggregated with the others
+        {
+            ProUpServPL pl;
+            GetTxPayload(tx, pl);
+            pl.sig = CBLSSignature();
+            CMutableTransaction tx3 = tx;
+            SetTxPayload(tx3, pl);
+            BOOST_CHECK(!CheckSpecialTx(tx3, chainTip, dummyState));
+            BOOST_CHECK_EQUAL(dummyState.GetRejectReason(), "bad-protx-sig");
+
+            CSpecialTxSigBatch sigBatch(worker);
+            CValidationState batchState;
+            BOOST_CHECK(CheckSpecialTx(tx, chainTip, batchState, &sigBatch));
+            BOOST_CHECK(CheckSpecialTx(tx, chainTip, batchState, &sigBatch));
+            BOOST_CHECK(!CheckSpecialTx(tx3, chainTip, batchState, &sigBatch));
+            BOOST_CHECK_EQUAL(batchState.GetRejectReason(), "bad-protx-sig");
+            CValidationState batchState2;
+            BOOST_CHECK(sigBatch.Verify(batchState2));
+        }
+
         CreateAndProcessBlock({tx}, coinbaseKey);
         chainTip = chainActive.Tip();
         BOOST_CHECK_EQUAL(chainTip->nHeight, nHeight + 1);
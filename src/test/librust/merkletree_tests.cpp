@@ -134,6 +134,53 @@ BOOST_AUTO_TEST_CASE(SaplingVectors) {
     );
 }
 
+BOOST_AUTO_TEST_CASE(SaplingBatchAppend) {
+    UniValue commitment_tests = read_json(MAKE_STRING(json_tests::merkle_commitments_sapling));
+    std::vector<uint256> commitments;
+    for (size_t i = 0; i < 16; i++) {
+        commitments.emplace_back(uint256S(commitment_tests[i].get_str()));
+    }
+
+    // Append the commitments in batches of 1, 2, 3, ... to a tree and to a witness
+    // of its first element, and one at a time to the reference ones.
+    SaplingTestingMerkleTree tree, ref_tree;
+    tree.append(commitments[0]);
+    ref_tree.append(commitments[0]);
+    SaplingTestingWitness witness = tree.witness(), ref_witness = ref_tree.witness();
+    size_t pos = 1;
+    for (size_t batch = 1; pos < commitments.size(); batch++) {
+        // Ask for the root before appending: the cached one must be reset
+        BOOST_CHECK(tree.root() == ref_tree.root());
+        std::vector<uint256> objs(commitments.begin() + pos, commitments.begin() + std::min(pos + batch, commitments.size()));
+        tree.append(objs);
+        witness.append(objs);
+        for (const uint256& obj : objs) {
+            ref_tree.append(obj);
+            ref_witness.append(obj);
+        }
+        pos += objs.size();
+
+        BOOST_CHECK(tree == ref_tree);
+        BOOST_CHECK(tree.root() == ref_tree.root());
+        BOOST_CHECK(witness == ref_witness);
+        BOOST_CHECK(witness.root() == tree.root());
+    }
+    BOOST_CHECK_EQUAL(tree.size(), commitments.size());
+
+    // The cached root is not serialized, and it is reset on deserialization
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tree;
+    SaplingTestingMerkleTree tree2;
+    tree2.append(commitments[0]);
+    BOOST_CHECK(tree2.root() != tree.root());
+    ss >> tree2;
+    BOOST_CHECK(tree2.root() == tree.root());
+
+    // The tree is full
+    BOOST_CHECK_THROW(tree.append(std::vector<uint256>{uint256()}), std::runtime_error);
+    BOOST_CHECK_THROW(witness.append(std::vector<uint256>{uint256()}), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(emptyroots) {
     libzcash::EmptyMerkleRoots<64, libzcash::SHA256Compress> emptyroots;
     std::array<libzcash::SHA256Compress, 65> computed;
@@ -174,6 +174,57 @@ BOOST_AUTO_TEST_CASE(FindMySaplingNotes)
     BOOST_CHECK_EQUAL(2, noteMap.size());
 }
 
+BOOST_AUTO_TEST_CASE(DecryptSaplingBlock)
+{
+    auto consensusParams = Params().GetConsensus();
+
+    CWallet& wallet = m_wallet;
+    LOCK(wallet.cs_wallet);
+    wallet.SetupSPKM(false);
+
+    auto sk = GetTestMasterSaplingSpendingKey();
+    auto expsk = sk.expsk;
+    auto extfvk = sk.ToXFVK();
+    auto pa = sk.DefaultAddress();
+    BOOST_CHECK(wallet.AddSaplingZKey(sk));
+
+    // Block with four shielded txes, two outputs each
+    CBlock block;
+    for (int i = 0; i < 4; i++) {
+        auto testNote = GetTestSaplingNote(pa, 50000000);
+        auto builder = TransactionBuilder(consensusParams);
+        builder.AddSaplingSpend(expsk, testNote.note, testNote.tree.root(), testNote.tree.witness());
+        builder.AddSaplingOutput(extfvk.fvk.ovk, pa, 25000000, {});
+        builder.SetFee(10000000);
+        block.vtx.emplace_back(MakeTransactionRef(builder.Build().GetTxOrThrow()));
+    }
+
+    // Enough keys to split the trial decryptions among the workers
+    auto vIvks = wallet.GetSaplingScriptPubKeyMan()->GetSaplingIncomingViewingKeys();
+    BOOST_CHECK_EQUAL(vIvks.size(), 1);
+    for (int i = 0; i < 8; i++) {
+        vIvks.insert(vIvks.begin(), libzcash::SaplingSpendingKey::random().full_viewing_key().in_viewing_key());
+    }
+
+    SaplingNoteDecryptor decryptor(4);
+    size_t nOutputs = 0;
+    const auto& mapParallel = decryptor.DecryptBlock(block, vIvks, nOutputs);
+    BOOST_CHECK_EQUAL(nOutputs, 8);
+    const auto& mapSerial = decryptor.DecryptBlock(block, vIvks, nOutputs, false);
+    BOOST_CHECK_EQUAL(mapParallel.size(), 4);
+    BOOST_CHECK_EQUAL(mapSerial.size(), 4);
+    for (const auto& tx : block.vtx) {
+        const auto& found = mapParallel.at(tx->GetHash());
+        BOOST_CHECK(found.first == mapSerial.at(tx->GetHash()).first);
+        BOOST_CHECK(found.first == wallet.GetSaplingScriptPubKeyMan()->FindMySaplingNotes(*tx).first);
+        BOOST_CHECK_EQUAL(found.first.size(), 2);
+        BOOST_CHECK_EQUAL(found.second.size(), 1);
+    }
+
+    // No keys, no notes
+    BOOST_CHECK(decryptor.DecryptBlock(block, {}, nOutputs).empty());
+}
+
 // Generate note A and spend to create note B, from which we spend to create two conflicting transactions
 BOOST_AUTO_TEST_CASE(GetConflictedSaplingNotes)
 {
@@ -783,6 +834,77 @@ BOOST_AUTO_TEST_CASE(CachedWitnessesDecrementFirst)
     }
 }
 
+BOOST_AUTO_TEST_CASE(CachedWitnessesRetireSpentNotes)
+{
+    libzcash::SaplingExtendedSpendingKey sk = GetTestMasterSaplingSpendingKey();
+    CWallet& wallet = m_wallet;
+    {
+        LOCK(wallet.cs_wallet);
+        setupWallet(wallet);
+        BOOST_CHECK(wallet.AddSaplingZKey(sk));
+    }
+    SaplingScriptPubKeyMan* sspkm = wallet.GetSaplingScriptPubKeyMan();
+
+    // First block, receiving the note
+    SaplingMerkleTree saplingTree;
+    CBlock block1;
+    CBlockIndex index1(block1);
+    index1.nHeight = 1;
+    SaplingOutPoint op = CreateValidBlock(wallet, sk, index1, block1, saplingTree);
+    BOOST_CHECK(sspkm->setWitnessedNotes.count(op));
+    const SaplingNoteData& nd = wallet.mapWallet.at(op.hash).mapSaplingNoteData.at(op);
+
+    // Second block, spending the note (only the nullifier matters here)
+    const uint256 nf = GetRandHash();
+    {
+        LOCK(wallet.cs_wallet);
+        sspkm->UpdateSaplingNullifierNoteMap(wallet.mapWallet.at(op.hash).mapSaplingNoteData.at(op), op, nf);
+    }
+    CMutableTransaction mtx;
+    mtx.nVersion = CTransaction::TxVersion::SAPLING;
+    mtx.sapData->vShieldedSpend.emplace_back();
+    mtx.sapData->vShieldedSpend[0].nullifier = nf;
+    CBlock block2;
+    block2.vtx.emplace_back(MakeTransactionRef(mtx));
+    CBlockIndex index2(block2);
+    index2.nHeight = 2;
+    wallet.IncrementNoteWitnesses(&index2, &block2, saplingTree);
+
+    // The note is retired, with the witnesses of the spend height
+    BOOST_CHECK(!sspkm->setWitnessedNotes.count(op));
+    BOOST_CHECK_EQUAL(sspkm->mapRetiredNotes.at(op), 2);
+    BOOST_CHECK_EQUAL(nd.witnessHeight, 2);
+    BOOST_CHECK_EQUAL(nd.witnesses.size(), 2);
+    const uint256 spentRoot = nd.witnesses.front().root();
+
+    // Third block: the retired note is not updated anymore
+    CBlock block3;
+    CBlockIndex index3(block3);
+    index3.nHeight = 3;
+    SaplingOutPoint op3 = CreateValidBlock(wallet, sk, index3, block3, saplingTree);
+    BOOST_CHECK(sspkm->setWitnessedNotes.count(op3));
+    BOOST_CHECK_EQUAL(nd.witnessHeight, 2);
+    BOOST_CHECK_EQUAL(nd.witnesses.size(), 2);
+    BOOST_CHECK(nd.witnesses.front().root() == spentRoot);
+
+    // Disconnecting the third block doesn't touch it either
+    wallet.DecrementNoteWitnesses(&index3);
+    BOOST_CHECK_EQUAL(nd.witnessHeight, 2);
+    BOOST_CHECK(!sspkm->setWitnessedNotes.count(op));
+
+    // Disconnecting the spend makes the note unspent again
+    wallet.DecrementNoteWitnesses(&index2);
+    BOOST_CHECK(sspkm->setWitnessedNotes.count(op));
+    BOOST_CHECK(sspkm->mapRetiredNotes.empty());
+    BOOST_CHECK_EQUAL(nd.witnessHeight, 1);
+    BOOST_CHECK_EQUAL(nd.witnesses.size(), 1);
+
+    // Reconnecting it retires the note again
+    wallet.IncrementNoteWitnesses(&index2, &block2, saplingTree);
+    BOOST_CHECK(!sspkm->setWitnessedNotes.count(op));
+    BOOST_CHECK_EQUAL(nd.witnessHeight, 2);
+}
+
 BOOST_AUTO_TEST_CASE(CachedWitnessesCleanIndex)
 {
     auto consensusParams = Params().GetConsensus();
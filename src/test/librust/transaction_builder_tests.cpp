@@ -6,6 +6,7 @@
 #include "test/librust/sapling_test_fixture.h"
 #include "test/librust/utiltest.h"
 
+#include "checkqueue.h"
 #include "sapling/sapling.h"
 #include "sapling/transaction_builder.h"
 #include "sapling/sapling_validation.h"
@@ -306,4 +307,115 @@ BOOST_AUTO_TEST_CASE(CheckSaplingTxVersion)
 }
 
 
+BOOST_AUTO_TEST_CASE(SaplingToSaplingParallelProofs)
+{
+    auto consensusParams = Params().GetConsensus();
+
+    auto sk = libzcash::SaplingSpendingKey::random();
+    auto expsk = sk.expanded_spending_key();
+    auto fvk = sk.full_viewing_key();
+    auto pa = sk.default_address();
+
+    // Spend several notes of the same tree, so they share the anchor
+    const int nSpends = 3;
+    std::vector<libzcash::SaplingNote> notes;
+    std::vector<SaplingWitness> witnesses;
+    SaplingMerkleTree tree;
+    for (int i = 0; i < nSpends; i++) {
+        libzcash::SaplingNote note(pa, 50000000);
+        uint256 cm = note.cmu().get();
+        tree.append(cm);
+        for (auto& w : witnesses) {
+            w.append(cm);
+        }
+        witnesses.push_back(tree.witness());
+        notes.push_back(note);
+    }
+
+    // --- 1.5 shielded-XOS in, 4 x 0.3 shielded-XOS out, 0.1 shielded-XOS fee, 0.2 shielded-XOS change
+    auto builder = TransactionBuilder(consensusParams);
+    builder.SetProvingThreads(4);
+    BOOST_CHECK_EQUAL(builder.GetProvingThreads(), 4);
+    for (int i = 0; i < nSpends; i++) {
+        builder.AddSaplingSpend(expsk, notes[i], tree.root(), witnesses[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        builder.AddSaplingOutput(fvk.ovk, pa, 30000000, {});
+    }
+    builder.SetFee(10000000);
+    auto tx = builder.Build().GetTxOrThrow();
+
+    BOOST_CHECK_EQUAL(tx.vin.size(), 0);
+    BOOST_CHECK_EQUAL(tx.vout.size(), 0);
+    BOOST_CHECK_EQUAL(tx.sapData->vShieldedSpend.size(), nSpends);
+    BOOST_CHECK_EQUAL(tx.sapData->vShieldedOutput.size(), 5);
+    BOOST_CHECK_EQUAL(tx.sapData->valueBalance, 10000000);
+
+    // The proofs made by the workers, and the binding signature over their merged contexts, are valid
+    CValidationState state;
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx, state, Params(), 3, true, false));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "");
+
+    // Same through the queued checks
+    std::vector<CSaplingCheck> vChecks;
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx, state, Params(), 3, true, false, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK(vChecks[0]());
+}
+
+BOOST_AUTO_TEST_CASE(SaplingProofsCheckQueue)
+{
+    auto consensusParams = Params().GetConsensus();
+
+    auto sk = libzcash::SaplingSpendingKey::random();
+    auto expsk = sk.expanded_spending_key();
+    auto fvk = sk.full_viewing_key();
+    auto pa = sk.default_address();
+
+    auto testNote = GetTestSaplingNote(pa, 40000000);
+    auto builder = TransactionBuilder(consensusParams);
+    builder.AddSaplingSpend(expsk, testNote.note, testNote.tree.root(), testNote.tree.witness());
+    builder.SetFee(10000000);
+    builder.AddSaplingOutput(fvk.ovk, pa, 29900000, {});
+    auto tx = builder.Build().GetTxOrThrow();
+
+    // Same transaction with a tampered value balance: the binding signature is no longer valid
+    CMutableTransaction mtx(tx);
+    mtx.sapData->valueBalance -= 1;
+    CTransaction badTx(mtx);
+
+    // With pvChecks, the proofs are not verified but queued
+    std::vector<CSaplingCheck> vChecks;
+    CValidationState state;
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx, state, Params(), 3, true, false, &vChecks));
+    BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(badTx, state, Params(), 3, true, false, &vChecks));
+    BOOST_CHECK(state.IsValid());
+    BOOST_CHECK_EQUAL(vChecks.size(), 2);
+    BOOST_CHECK(vChecks[0]());
+    BOOST_CHECK(!vChecks[1]());
+
+    // Serially, the failure reason is reported
+    BOOST_CHECK(!SaplingValidation::ContextualCheckTransaction(badTx, state, Params(), 3, true, false));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-sapling-binding-signature-invalid");
+
+    // Through the check queue (no worker threads: the master does the work)
+    state = CValidationState();
+    CCheckQueue<CSaplingCheck> queue(16);
+    {
+        CCheckQueueControl<CSaplingCheck> control(&queue);
+        std::vector<CSaplingCheck> vGood;
+        BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx, state, Params(), 3, true, false, &vGood));
+        control.Add(vGood);
+        BOOST_CHECK(control.Wait());
+    }
+    {
+        CCheckQueueControl<CSaplingCheck> control(&queue);
+        std::vector<CSaplingCheck> vMixed;
+        BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(tx, state, Params(), 3, true, false, &vMixed));
+        BOOST_CHECK(SaplingValidation::ContextualCheckTransaction(badTx, state, Params(), 3, true, false, &vMixed));
+        control.Add(vMixed);
+        BOOST_CHECK(!control.Wait());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
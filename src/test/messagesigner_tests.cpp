@@ -0,0 +1,91 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_oasis.h"
+#include "bls/bls_wrapper.h"
+#include "messagesigner.h"
+#include "random.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(messagesigner_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(hashsig_cache)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyID keyID = key.GetPubKey().GetID();
+    const uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(CHashSigner::SignHash(hash, key, vchSig));
+
+    // The key is recovered once, then taken from the cache
+    BOOST_CHECK(!CHashSigner::IsHashSigCached(hash, vchSig));
+    CKeyID keyIDRet;
+    BOOST_CHECK(CHashSigner::PreVerifyHash(hash, vchSig, keyIDRet));
+    BOOST_CHECK(keyIDRet == keyID);
+    BOOST_CHECK(CHashSigner::IsHashSigCached(hash, vchSig));
+    CKeyID keyIDCached;
+    BOOST_CHECK(CHashSigner::PreVerifyHash(hash, vchSig, keyIDCached));
+    BOOST_CHECK(keyIDCached == keyID);
+    std::string strError;
+    BOOST_CHECK(CHashSigner::VerifyHash(hash, keyID, vchSig, strError));
+
+    // The cached signature is still checked against the key
+    CKey key2;
+    key2.MakeNewKey(true);
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash, key2.GetPubKey().GetID(), vchSig, strError));
+
+    // and against the hash
+    const uint256 hash2 = GetRandHash();
+    BOOST_CHECK(!CHashSigner::IsHashSigCached(hash2, vchSig));
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash2, keyID, vchSig, strError));
+}
+
+BOOST_AUTO_TEST_CASE(hashsig_cache_invalid)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyID keyID = key.GetPubKey().GetID();
+    const uint256 hash = GetRandHash();
+
+    // No key can be recovered from this signature: the failure is cached too
+    const std::vector<unsigned char> vchSig(65, 0);
+    CKeyID keyIDRet;
+    BOOST_CHECK(!CHashSigner::PreVerifyHash(hash, vchSig, keyIDRet));
+    BOOST_CHECK(CHashSigner::IsHashSigCached(hash, vchSig));
+    std::string strError;
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash, keyID, vchSig, strError));
+    BOOST_CHECK_EQUAL(strError, "Error recovering public key.");
+}
+
+BOOST_AUTO_TEST_CASE(hashsig_cache_bls)
+{
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    const CBLSPublicKey pk = sk.GetPublicKey();
+    const uint256 hash = GetRandHash();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(CHashSigner::SignHash(hash, sk, vchSig));
+
+    BOOST_CHECK(!CHashSigner::IsHashSigCached(hash, vchSig, &pk));
+    BOOST_CHECK(CHashSigner::VerifyHash(hash, pk, vchSig));
+    BOOST_CHECK(CHashSigner::IsHashSigCached(hash, vchSig, &pk));
+    BOOST_CHECK(CHashSigner::VerifyHash(hash, pk, vchSig));
+
+    // The signature of another hash is invalid, and cached as such
+    const uint256 hash2 = GetRandHash();
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash2, pk, vchSig));
+    BOOST_CHECK(CHashSigner::IsHashSigCached(hash2, vchSig, &pk));
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash2, pk, vchSig));
+
+    // The result is cached for a key
+    CBLSSecretKey sk2;
+    sk2.MakeNewKey();
+    const CBLSPublicKey pk2 = sk2.GetPublicKey();
+    BOOST_CHECK(!CHashSigner::IsHashSigCached(hash, vchSig, &pk2));
+    BOOST_CHECK(!CHashSigner::VerifyHash(hash, pk2, vchSig));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
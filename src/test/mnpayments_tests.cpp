@@ -314,4 +314,56 @@ BOOST_FIXTURE_TEST_CASE(mnwinner_test, TestChain100Setup)
     BOOST_CHECK_MESSAGE(stateInternal.IsValid(), stateInternal.GetRejectReason());
 }
 
+
+static void AddTestWinnerVotes(CMasternodePayments& payments, int nHeight, const CScript& payee, int nVotes)
+{
+    static uint32_t nVoter = 0;
+    for (int i = 0; i < nVotes; i++) {
+        CMasternodePaymentWinner winner(CTxIn(COutPoint(UINT256_ONE, nVoter++)), nHeight);
+        winner.AddPayee(payee);
+        payments.AddWinningMasternode(winner);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(mnpayments_lastpaid_index_test, BasicTestingSetup)
+{
+    CMasternodePayments payments;
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    const CScript payeeA = GetScriptForDestination(keyA.GetPubKey().GetID());
+    const CScript payeeB = GetScriptForDestination(keyB.GetPubKey().GetID());
+
+    // A single vote is not enough to consider the payee paid
+    AddTestWinnerVotes(payments, 10, payeeA, 1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 100), -1);
+    AddTestWinnerVotes(payments, 10, payeeA, 1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 100), 10);
+
+    // The most recent height within the window is returned
+    AddTestWinnerVotes(payments, 20, payeeA, 3);
+    AddTestWinnerVotes(payments, 20, payeeB, 1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 100), 20);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 19), 10);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 11, 19), -1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 20, 20), 20);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeB, 1, 100), -1);
+
+    // The index is rebuilt when loading from disk
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+    CMasternodePayments payments2;
+    ss >> payments2;
+    BOOST_CHECK_EQUAL(payments2.GetLastPaidHeight(payeeA, 1, 100), 20);
+    BOOST_CHECK_EQUAL(payments2.GetLastPaidHeight(payeeA, 1, 19), 10);
+    BOOST_CHECK_EQUAL(payments2.GetLastPaidHeight(payeeB, 1, 100), -1);
+
+    // Pruned heights are removed from the index (limit is 1000 blocks)
+    payments.CleanPaymentList(0, 1015);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 19), -1);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 100), 20);
+    payments.CleanPaymentList(0, 1025);
+    BOOST_CHECK_EQUAL(payments.GetLastPaidHeight(payeeA, 1, 100), -1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "net.h"
 #include "netbase.h"
 #include "serialize.h"
+#include "socketevents.h"
 #include "span.h"
 #include "streams.h"
 #include "version.h"
@@ -702,4 +703,115 @@ BOOST_AUTO_TEST_CASE(PoissonNextSend)
     g_mock_deterministic_tests = false;
 }
 
+BOOST_AUTO_TEST_CASE(cnode_direct_receive)
+{
+    // A message with a payload larger than the allocation steps of CNetMessage
+    std::vector<unsigned char> vPayload(600 * 1024);
+    for (size_t i = 0; i < vPayload.size(); i++) vPayload[i] = (unsigned char)(i * 7);
+    uint256 hash = Hash(vPayload.begin(), vPayload.end());
+    CMessageHeader hdr(Params().MessageStart(), NetMsgType::BLOCK, vPayload.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream ssMsg(SER_NETWORK, INIT_PROTO_VERSION);
+    ssMsg << hdr;
+    ssMsg.write((const char*)vPayload.data(), vPayload.size());
+
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0);
+    unsigned int nMax = 0x10000;
+    BOOST_CHECK(node.GetRecvDataBuffer(1, nMax) == nullptr);
+
+    // Header and the start of the payload go through the copying path
+    const unsigned int nFirst = CMessageHeader::HEADER_SIZE + 1000;
+    bool complete = false;
+    BOOST_CHECK(node.ReceiveMsgBytes(ssMsg.data(), nFirst, complete));
+    BOOST_CHECK(!complete);
+
+    // Only used when enough of the payload is outstanding
+    nMax = 0x10000;
+    BOOST_CHECK(node.GetRecvDataBuffer(vPayload.size(), nMax) == nullptr);
+
+    // The rest is read straight into the message, in uneven chunks
+    size_t nPos = nFirst;
+    while (!complete) {
+        nMax = 70000;
+        char* pch = node.GetRecvDataBuffer(1, nMax);
+        BOOST_REQUIRE(pch != nullptr);
+        BOOST_REQUIRE(nMax > 0 && nMax <= 70000 && nPos + nMax <= ssMsg.size());
+        memcpy(pch, ssMsg.data() + nPos, nMax);
+        nPos += nMax;
+        node.ReceiveMsgData(nMax, complete);
+    }
+    BOOST_CHECK_EQUAL(nPos, ssMsg.size());
+    BOOST_CHECK_EQUAL(node.GetTotalRecvSize(), ssMsg.size());
+    nMax = 0x10000;
+    BOOST_CHECK(node.GetRecvDataBuffer(1, nMax) == nullptr);
+
+    // Both paths produce the same message and checksum
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_CHECK_EQUAL(msg.readHeader(ssMsg.data(), CMessageHeader::HEADER_SIZE), (int)CMessageHeader::HEADER_SIZE);
+    for (size_t n = CMessageHeader::HEADER_SIZE; n < ssMsg.size();) {
+        unsigned int nBytes = std::min<size_t>(ssMsg.size() - n, 0x10000);
+        char* pch = msg.reserveData(nBytes);
+        memcpy(pch, ssMsg.data() + n, nBytes);
+        msg.commitData(nBytes);
+        n += nBytes;
+    }
+    BOOST_CHECK(msg.complete());
+    BOOST_CHECK(msg.GetMessageHash() == hash);
+    BOOST_CHECK(std::equal(msg.vRecv.begin(), msg.vRecv.end(), (const char*)vPayload.data()));
+}
+
+#ifndef WIN32
+static void CheckSocketEvents(SocketEventsMode mode)
+{
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    SOCKET hSocket = fds[0];
+    BOOST_CHECK(SetSocketNonBlocking(hSocket, true));
+
+    CSocketEvents events(mode);
+    std::string strError;
+    BOOST_REQUIRE(events.Init(strError));
+    BOOST_CHECK(events.Add(fds[0], 7));
+    std::vector<SocketInterest> vInterest;
+    if (!events.IsEdgeTriggered()) vInterest.emplace_back(fds[0], 7, true, false);
+
+    // Nothing to read yet
+    std::vector<SocketEvent> vEvents;
+    BOOST_CHECK(events.Wait(vInterest, 0, vEvents));
+    for (const SocketEvent& event : vEvents) BOOST_CHECK(!event.fRecv);
+
+    const char msg[] = "ping";
+    BOOST_CHECK_EQUAL(send(fds[1], msg, sizeof(msg), 0), (ssize_t)sizeof(msg));
+    BOOST_CHECK(events.Wait(vInterest, 1000, vEvents));
+    BOOST_REQUIRE_EQUAL(vEvents.size(), 1U);
+    BOOST_CHECK_EQUAL(vEvents[0].nTag, 7U);
+    BOOST_CHECK(vEvents[0].fRecv);
+
+    char buf[16];
+    BOOST_CHECK_EQUAL(recv(fds[0], buf, sizeof(buf), 0), (ssize_t)sizeof(msg));
+    if (events.IsEdgeTriggered()) {
+        // Reported once per edge
+        BOOST_CHECK(events.Wait(vInterest, 0, vEvents));
+        BOOST_CHECK(vEvents.empty());
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(socket_events)
+{
+    SocketEventsMode mode;
+    BOOST_CHECK(SocketEventsModeFromString("select", mode) && mode == SocketEventsMode::SELECT);
+    BOOST_CHECK(!SocketEventsModeFromString("kqueue", mode));
+    CheckSocketEvents(SocketEventsMode::SELECT);
+#ifdef USE_EPOLL
+    BOOST_CHECK(SocketEventsModeFromString("epoll", mode) && mode == SocketEventsMode::EPOLL);
+    CheckSocketEvents(SocketEventsMode::EPOLL);
+#endif
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
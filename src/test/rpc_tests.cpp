@@ -5,6 +5,7 @@
 
 #include "rpc/server.h"
 #include "rpc/client.h"
+#include "rpc/jsonwriter.h"
 
 #include "key_io.h"
 #include "netbase.h"
@@ -286,4 +287,73 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+static void WriteTestDocument(JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("name", "a \"quoted\" string\n");
+    writer.Key("entries");
+    writer.BeginArray();
+    for (int i = 0; i < 1000; i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("n", i);
+        entry.pushKV("value", ValueFromAmount(i * COIN / 3));
+        writer.Value(entry);
+        writer.Flush();
+    }
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Key("nested");
+    writer.BeginArray();
+    writer.BeginArray();
+    writer.Value(NullUniValue);
+    writer.Value(true);
+    writer.EndArray();
+    writer.BeginObject();
+    writer.KeyValue("x", 1.5);
+    writer.EndObject();
+    writer.EndArray();
+    writer.EndObject();
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_writer)
+{
+    UniValueWriter uniWriter;
+    WriteTestDocument(uniWriter);
+    const UniValue& doc = uniWriter.GetResult();
+    BOOST_CHECK_EQUAL(doc["entries"].size(), 1000U);
+    BOOST_CHECK_EQUAL(doc["entries"][999]["n"].get_int(), 999);
+    BOOST_CHECK_EQUAL(doc["nested"][1]["x"].get_real(), 1.5);
+
+    // Streamed in small chunks, the output is the serialization of the UniValue
+    std::string strOut;
+    size_t nChunks = 0;
+    size_t nWaits = 0;
+    JSONStreamWriter streamWriter([&](std::string&& strChunk, bool fWait) {
+        BOOST_CHECK(strChunk.size() < 2 * 1024);
+        strOut += strChunk;
+        nChunks++;
+        if (fWait) nWaits++;
+    }, 1024);
+    BOOST_CHECK(streamWriter.IsEmpty());
+    WriteTestDocument(streamWriter);
+    BOOST_CHECK(streamWriter.HasSentOutput());
+    streamWriter.Finish();
+    BOOST_CHECK_EQUAL(strOut, doc.write());
+    BOOST_CHECK(nChunks > 10);
+    BOOST_CHECK(nWaits > 0);
+
+    // Small documents are left buffered
+    bool fSent = false;
+    JSONStreamWriter smallWriter([&](std::string&& strChunk, bool fWait) { fSent = true; });
+    smallWriter.BeginArray();
+    smallWriter.Value("x");
+    smallWriter.Flush();
+    smallWriter.EndArray();
+    BOOST_CHECK(!smallWriter.IsEmpty());
+    BOOST_CHECK(!smallWriter.HasSentOutput());
+    BOOST_CHECK(!fSent);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
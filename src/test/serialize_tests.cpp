@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or https://www.opensource.org/licenses/mit-license.php.
 
+#include "chain.h"
 #include "optional.h"
 #include "serialize.h"
 #include "streams.h"
@@ -289,6 +290,34 @@ BOOST_AUTO_TEST_CASE(vector_bool)
     BOOST_CHECK(SerializeHash(vec1) == SerializeHash(vec2));
 }
 
+BOOST_AUTO_TEST_CASE(stake_modifier_bytes)
+{
+    // Must be serialized exactly like the std::vector<unsigned char> it replaced
+    for (size_t nLen : {0, 8, 32}) {
+        std::vector<unsigned char> vec(nLen);
+        for (size_t i = 0; i < nLen; i++) vec[i] = (unsigned char)(i * 7 + 1);
+        CStakeModifierBytes mod;
+        mod.assign(vec.data(), vec.size());
+        BOOST_CHECK_EQUAL(mod.size(), nLen);
+
+        CDataStream ssVec(SER_DISK, CLIENT_VERSION), ssMod(SER_DISK, CLIENT_VERSION);
+        ssVec << vec;
+        ssMod << mod;
+        BOOST_CHECK(ssVec.str() == ssMod.str());
+
+        CStakeModifierBytes mod2;
+        ssVec >> mod2;
+        BOOST_CHECK(mod2 == mod);
+    }
+
+    // Longer than any stake modifier
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::vector<unsigned char>(CStakeModifierBytes::MAX_SIZE + 1);
+    CStakeModifierBytes mod;
+    BOOST_CHECK_THROW(ss >> mod, std::ios_base::failure);
+    BOOST_CHECK_THROW(mod.assign(nullptr, CStakeModifierBytes::MAX_SIZE + 1), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(noncanonical)
 {
     // Write some non-canonical CompactSize encodings, and
@@ -9,6 +9,7 @@
 
 #include "blockassembler.h"
 #include "consensus/merkle.h"
+#include "crypto/sha256.h"
 #include "bls/bls_wrapper.h"
 #include "guiinterface.h"
 #include "evo/deterministicmns.h"
@@ -44,10 +45,12 @@ std::ostream& operator<<(std::ostream& os, const uint256& num)
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_oasis" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
+    SHA256AutoDetect();
     ECC_Start();
     BLSInit();
     SetupEnvironment();
     InitSignatureCache();
+    InitScriptExecutionCache();
     fCheckBlockIndex = true;
     SelectParams(chainName);
     evoDb.reset(new CEvoDB(1 << 20, true, true));
@@ -107,8 +110,10 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
             BOOST_CHECK(ok);
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadSaplingCheck);
+        }
         peerLogic.reset(new PeerLogicValidation(connman));
 }
 
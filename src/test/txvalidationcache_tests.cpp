@@ -86,4 +86,46 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_block_script_cache, TestChain100Setup)
+{
+    // The scripts of a transaction accepted to the mempool are not executed
+    // again when it is connected in a block.
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Mature the second coinbase
+    CreateAndProcessBlock({}, scriptPubKey);
+
+    std::vector<CMutableTransaction> spends;
+    spends.resize(2);
+    for (int i = 0; i < 2; i++)
+    {
+        spends[i].nVersion = 1;
+        spends[i].vin.resize(1);
+        spends[i].vin[0].prevout.hash = coinbaseTxns[i].GetHash();
+        spends[i].vin[0].prevout.n = 0;
+        spends[i].vout.resize(1);
+        spends[i].vout[0].nValue = 11*CENT;
+        spends[i].vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spends[i].vin[0].scriptSig << vchSig;
+    }
+
+    uint64_t nLookups, nHits, nLookupsNew, nHitsNew;
+    GetScriptExecutionCacheStats(nLookups, nHits);
+
+    // spends[0] was validated in the mempool, spends[1] wasn't
+    BOOST_CHECK(ToMemPool(spends[0]));
+    CBlock block = CreateAndProcessBlock(spends, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(mempool.size(), 0);
+
+    GetScriptExecutionCacheStats(nLookupsNew, nHitsNew);
+    BOOST_CHECK_EQUAL(nLookupsNew - nLookups, 2);
+    BOOST_CHECK_EQUAL(nHitsNew - nHits, 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -165,4 +165,53 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, WITH_LOCK(cs_main, return chainActive.Tip()->GetBlockHash()));
 }
 
+BOOST_AUTO_TEST_CASE(processnewblockheaders_parallel_download)
+{
+    BOOST_CHECK_MESSAGE(ProcessNewBlock(std::make_shared<CBlock>(Params().GenesisBlock()), nullptr), "Error: genesis not connected");
+    SyncWithValidationInterfaceQueue();
+
+    // build a linear chain on top of the current tip
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    std::vector<CBlockHeader> headers;
+    uint256 prev_hash = WITH_LOCK(cs_main, return chainActive.Tip()->GetBlockHash());
+    for (int i = 0; i < 10; i++) {
+        blocks.emplace_back(GoodBlock(prev_hash));
+        headers.emplace_back(blocks.back()->GetBlockHeader());
+        prev_hash = blocks.back()->GetHash();
+    }
+
+    // headers are indexed without data
+    CValidationState state;
+    CBlockIndex* pindexLast = nullptr;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state, &pindexLast));
+    BOOST_CHECK(state.IsValid());
+    BOOST_REQUIRE(pindexLast != nullptr);
+    BOOST_CHECK_EQUAL(pindexLast->GetBlockHash(), blocks.back()->GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(pindexBestHeader, pindexLast);
+        BOOST_CHECK(!(pindexLast->nStatus & BLOCK_HAVE_DATA));
+        BOOST_CHECK(pindexLast->IsValid(BLOCK_VALID_TREE));
+    }
+
+    // a block whose parent has not been downloaded yet is not accepted
+    BlockStateCatcher sc(blocks[5]->GetHash());
+    sc.registerEvent();
+    BOOST_CHECK(!ProcessNewBlock(blocks[5], nullptr));
+    BOOST_CHECK(sc.found && sc.state.GetRejectReason() == "prevblk-not-downloaded");
+
+    // processing the bodies in order connects the whole chain
+    for (const auto& block : blocks) {
+        BOOST_CHECK(ProcessNewBlock(block, nullptr));
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(WITH_LOCK(cs_main, return chainActive.Tip()->GetBlockHash()), blocks.back()->GetHash());
+
+    // a non-continuous header is rejected
+    CBlockHeader orphan = GoodBlock(GetRandHash())->GetBlockHeader();
+    state = CValidationState();
+    BOOST_CHECK(!ProcessNewBlockHeaders({orphan}, state));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "prevblk-not-found");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
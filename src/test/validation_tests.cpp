@@ -7,6 +7,7 @@
 #include "primitives/transaction.h"
 #include "sapling/sapling_validation.h"
 #include "test/librust/utiltest.h"
+#include "txdb.h"
 #include "util/blockstatecatcher.h"
 #include "wallet/test/wallet_test_fixture.h"
 
@@ -94,4 +95,90 @@ BOOST_FIXTURE_TEST_CASE(test_simple_shielded_invalid, TestingSetup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(block_stats_index, TestChain100Setup)
+{
+    fBlockStatsIndex = true;
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // Spend a mature coinbase paying one cent of fee
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(coinbaseTxns[0].GetHash(), 0));
+    spend.vout.emplace_back(coinbaseTxns[0].vout[0].nValue - CENT, scriptPubKey);
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    const CBlockIndex* pindex = WITH_LOCK(cs_main, return chainActive.Tip());
+    BOOST_CHECK(pindex->GetBlockHash() == block.GetHash());
+
+    // The entry written by ConnectBlock matches the one computed from disk
+    std::map<int, CDiskBlockStats> mapStats;
+    BOOST_CHECK(pblocktree->ReadBlockStats(pindex->nHeight, pindex->nHeight, mapStats));
+    BOOST_CHECK_EQUAL(mapStats.size(), 1);
+    const CDiskBlockStats& stats = mapStats.begin()->second;
+    BOOST_CHECK(stats.hashBlock == block.GetHash());
+    BOOST_CHECK_EQUAL(stats.nTxCount, 1);
+    BOOST_CHECK_EQUAL(stats.nTxCountAll, 2);
+    BOOST_CHECK_EQUAL(stats.nTxBytes, (int64_t) GetSerializeSize(block.vtx[1], CLIENT_VERSION));
+    BOOST_CHECK_EQUAL(stats.nFees, CENT);
+
+    CDiskBlockStats statsDisk;
+    BOOST_CHECK(ReadBlockStatsFromDisk(pindex, statsDisk));
+    BOOST_CHECK(statsDisk.hashBlock == stats.hashBlock);
+    BOOST_CHECK_EQUAL(statsDisk.nFees, stats.nFees);
+    BOOST_CHECK_EQUAL(statsDisk.nTxBytes, stats.nTxBytes);
+
+    // The previous block was connected before the index was enabled
+    mapStats.clear();
+    BOOST_CHECK(pblocktree->ReadBlockStats(pindex->nHeight - 1, pindex->nHeight - 1, mapStats));
+    BOOST_CHECK(mapStats.empty());
+    fBlockStatsIndex = false;
+}
+
+BOOST_FIXTURE_TEST_CASE(load_block_index_guts, BasicTestingSetup)
+{
+    // More than one batch, to go through the read-ahead path
+    const int nEntries = BLOCK_INDEX_LOAD_BATCH + 500;
+    const int nFirstHeight = Params().GetConsensus().vUpgrades[Consensus::UPGRADE_POS].nActivationHeight;
+    CBlockTreeDB blocktree(1 << 20, true);
+    std::vector<uint256> vHashes;
+    uint256 hashPrev;
+    for (int i = 0; i < nEntries; i++) {
+        CDiskBlockIndex diskindex;
+        diskindex.hashPrev = hashPrev;
+        diskindex.nHeight = nFirstHeight + i;
+        diskindex.nVersion = 6;
+        diskindex.nTime = 1000 + i;
+        diskindex.nTx = 1 + i % 7;
+        diskindex.nStatus = BLOCK_VALID_TREE;
+        diskindex.SetStakeModifier(uint256S(strprintf("%x", i + 1)));
+        BOOST_CHECK(blocktree.WriteBlockIndex(diskindex));
+        hashPrev = diskindex.GetBlockHash();
+        vHashes.emplace_back(hashPrev);
+    }
+
+    std::map<uint256, std::unique_ptr<CBlockIndex>> mapIndex;
+    auto insert = [&mapIndex](const uint256& hash) -> CBlockIndex* {
+        if (hash.IsNull()) return nullptr;
+        auto it = mapIndex.find(hash);
+        if (it == mapIndex.end()) {
+            it = mapIndex.emplace(hash, std::unique_ptr<CBlockIndex>(new CBlockIndex())).first;
+            it->second->phashBlock = &it->first;
+        }
+        return it->second.get();
+    };
+    BOOST_CHECK(blocktree.LoadBlockIndexGuts(insert, 4));
+    BOOST_CHECK_EQUAL(mapIndex.size(), (size_t) nEntries);
+    for (int i = 0; i < nEntries; i++) {
+        const CBlockIndex* pindex = mapIndex.at(vHashes[i]).get();
+        BOOST_CHECK_EQUAL(pindex->nHeight, nFirstHeight + i);
+        BOOST_CHECK_EQUAL(pindex->nTx, (unsigned int) (1 + i % 7));
+        BOOST_CHECK(pindex->GetStakeModifierV2() == uint256S(strprintf("%x", i + 1)));
+        BOOST_CHECK(pindex->pprev == (i ? mapIndex.at(vHashes[i - 1]).get() : nullptr));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "tiertwo_sigverifier.h"
+
+#include "budget/budgetmanager.h"
+#include "ctpl.h"
+#include "evo/deterministicmns.h"
+#include "masternode-payments.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "net_processing.h"
+#include "util/system.h"
+#include "util/threadnames.h"
+
+#include <future>
+
+std::unique_ptr<CTierTwoSigVerifier> g_tiertwo_sigverifier;
+
+CTierTwoSigVerifier::CTierTwoSigVerifier() :
+    nThreads(std::max(1, std::min(GetNumCores(), MAX_TIERTWO_SIGVERIFY_THREADS))),
+    workerPool(new ctpl::thread_pool(nThreads))
+{
+    RenameThreadPool(*workerPool, "oasis-t2sig");
+}
+
+CTierTwoSigVerifier::~CTierTwoSigVerifier()
+{
+    Stop();
+    workerPool->stop(true);
+}
+
+bool CTierTwoSigVerifier::IsVerifiedAhead(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::MNPING ||
+           strCommand == NetMsgType::BUDGETVOTE ||
+           strCommand == NetMsgType::FINALBUDGETVOTE ||
+           strCommand == NetMsgType::MNWINNER;
+}
+
+bool CTierTwoSigVerifier::Push(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv)
+{
+    {
+        LOCK(cs);
+        if (fStopped || queue.size() >= MAX_TIERTWO_SIGVERIFY_QUEUE) {
+            return false;
+        }
+        queue.push_back(Message{pfrom->AddRef(), strCommand, vRecv});
+    }
+    cond.notify_one();
+    return true;
+}
+
+void CTierTwoSigVerifier::Start()
+{
+    LOCK(cs);
+    if (!fStopped) return;
+    fStopped = false;
+    threadVerifier = std::thread(&TraceThread<std::function<void()> >, "t2sigverify", std::function<void()>(std::bind(&CTierTwoSigVerifier::ThreadVerifier, this)));
+}
+
+void CTierTwoSigVerifier::Stop()
+{
+    {
+        LOCK(cs);
+        fStopped = true;
+    }
+    cond.notify_one();
+    if (threadVerifier.joinable()) {
+        threadVerifier.join();
+    }
+}
+
+void CTierTwoSigVerifier::ThreadVerifier()
+{
+    while (true) {
+        std::vector<Message> vBatch;
+        {
+            WAIT_LOCK(cs, lock);
+            cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(cs) { return fStopped || !queue.empty(); });
+            if (queue.empty()) return; // stopped, and nothing left to process
+            while (!queue.empty() && vBatch.size() < MAX_TIERTWO_SIGVERIFY_BATCH) {
+                vBatch.emplace_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        // Verify the signatures of the batch in parallel, then process the messages in order
+        std::vector<std::future<void>> vFutures;
+        vFutures.reserve(vBatch.size());
+        for (const Message& msg : vBatch) {
+            if (msg.pfrom->fDisconnect) continue;
+            std::function<void()> sigCheck = GetSigCheck(msg);
+            if (sigCheck) {
+                vFutures.emplace_back(workerPool->push([sigCheck](int threadId) { sigCheck(); }));
+            }
+        }
+        for (auto& f : vFutures) {
+            f.get();
+        }
+        for (Message& msg : vBatch) {
+            if (!msg.pfrom->fDisconnect) {
+                ProcessTierTwoMessage(msg.pfrom, msg.strCommand, msg.vRecv);
+            }
+            msg.pfrom->Release();
+        }
+    }
+}
+
+std::function<void()> CTierTwoSigVerifier::GetSigCheck(const Message& msg)
+{
+    // The messages already seen are dropped by the managers, without checking their signature
+    try {
+        CDataStream vRecv(msg.vRecv);
+        if (msg.strCommand == NetMsgType::MNPING) {
+            CMasternodePing mnp;
+            vRecv >> mnp;
+            if (mnodeman.mapSeenMasternodePing.count(mnp.GetHash())) return nullptr;
+            return [mnp]() { mnp.PreVerifySignature(); };
+        } else if (msg.strCommand == NetMsgType::BUDGETVOTE) {
+            CBudgetVote vote;
+            vRecv >> vote;
+            if (g_budgetman.HaveSeenProposalVote(vote.GetHash())) return nullptr;
+            return [vote]() { vote.PreVerifySignature(); };
+        } else if (msg.strCommand == NetMsgType::FINALBUDGETVOTE) {
+            CFinalizedBudgetVote vote;
+            vRecv >> vote;
+            if (g_budgetman.HaveSeenFinalizedBudgetVote(vote.GetHash())) return nullptr;
+            // The finalized budget votes of the deterministic masternodes are signed by the operator key
+            auto dmn = deterministicMNManager->GetListAtChainTip().GetMNByCollateral(vote.GetVin().prevout);
+            return [vote, dmn]() { vote.PreVerifySignature(dmn ? &dmn->pdmnState->pubKeyOperator.Get() : nullptr); };
+        } else if (msg.strCommand == NetMsgType::MNWINNER) {
+            CMasternodePaymentWinner winner;
+            vRecv >> winner;
+            if (WITH_LOCK(cs_mapMasternodePayeeVotes, return masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash()))) return nullptr;
+            auto dmn = deterministicMNManager->GetListAtChainTip().GetMNByCollateral(winner.vinMasternode.prevout);
+            return [winner, dmn]() { winner.PreVerifySignature(dmn ? &dmn->pdmnState->pubKeyOperator.Get() : nullptr); };
+        }
+    } catch (const std::exception& e) {
+        // Malformed message, reported when it is processed
+    }
+    return nullptr;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2022 The OASIS developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OASIS_TIERTWO_SIGVERIFIER_H
+#define OASIS_TIERTWO_SIGVERIFIER_H
+
+#include "streams.h"
+#include "sync.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+class CNode;
+
+namespace ctpl {
+    class thread_pool;
+}
+
+//! Maximum number of tier two messages waiting for their signature to be verified
+static const size_t MAX_TIERTWO_SIGVERIFY_QUEUE = 10000;
+//! Maximum number of messages verified at once (and applied afterwards, in order)
+static const size_t MAX_TIERTWO_SIGVERIFY_BATCH = 256;
+//! Maximum number of threads verifying the signatures
+static const int MAX_TIERTWO_SIGVERIFY_THREADS = 8;
+
+/**
+ * Verifies the signatures of the tier two messages that are relayed the most (masternode
+ * pings, budget votes and masternode winners) on a pool of worker threads, instead of the
+ * message handler thread. The queued messages are taken in batches: the signatures of a
+ * batch are verified in parallel and stored in the message signature cache, then the
+ * messages are processed in arrival order by the usual managers, whose signature checks
+ * hit the cache. A message with an invalid signature is processed like any other: its
+ * signature check fails (and the peer is punished) as before.
+ */
+class CTierTwoSigVerifier
+{
+public:
+    CTierTwoSigVerifier();
+    ~CTierTwoSigVerifier();
+
+    // Whether the messages of this type are queued by Push
+    static bool IsVerifiedAhead(const std::string& strCommand);
+
+    // Queue the message, returns false if the queue is full or stopped (the message
+    // must then be processed by the caller)
+    bool Push(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv);
+
+    void Start();
+    // Process the queued messages and stop the thread
+    void Stop();
+
+private:
+    struct Message {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+    };
+
+    const int nThreads;
+    std::unique_ptr<ctpl::thread_pool> workerPool;
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<Message> queue GUARDED_BY(cs);
+    bool fStopped GUARDED_BY(cs){true};
+    std::thread threadVerifier;
+
+    void ThreadVerifier();
+    // The check of the signature of the message, run ahead on the pool, or null if the
+    // message doesn't need one (already seen, or malformed)
+    std::function<void()> GetSigCheck(const Message& msg);
+};
+
+extern std::unique_ptr<CTierTwoSigVerifier> g_tiertwo_sigverifier;
+
+#endif // OASIS_TIERTWO_SIGVERIFIER_H
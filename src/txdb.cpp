@@ -6,10 +6,12 @@
 
 #include "txdb.h"
 
+#include "ctpl.h"
 #include "random.h"
 #include "pow.h"
 #include "uint256.h"
 #include "util/system.h"
+#include "util/threadnames.h"
 #include "util/vector.h"
 
 #include <stdint.h>
@@ -21,6 +23,7 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_STATS = 's';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -40,6 +43,16 @@ struct CoinEntry
     SERIALIZE_METHODS(CoinEntry, obj) { READWRITE(obj.key, obj.outpoint->hash, VARINT(obj.outpoint->n)); }
 };
 
+// Block stats keys are big-endian heights, so that the entries are sorted by height
+struct BlockStatsEntry
+{
+    char key;
+    uint32_t nHeight;
+    explicit BlockStatsEntry(uint32_t nHeightIn = 0) : key(DB_BLOCK_STATS), nHeight(nHeightIn) {}
+
+    SERIALIZE_METHODS(BlockStatsEntry, obj) { READWRITE(obj.key, Using<BigEndianFormatter<4>>(obj.nHeight)); }
+};
+
 }
 
 
@@ -260,6 +273,30 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::WriteBlockStats(int nHeight, const CDiskBlockStats& stats)
+{
+    return Write(BlockStatsEntry(nHeight), stats);
+}
+
+bool CBlockTreeDB::ReadBlockStats(int nHeightStart, int nHeightEnd, std::map<int, CDiskBlockStats>& mapStats)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(BlockStatsEntry(nHeightStart));
+    while (pcursor->Valid()) {
+        BlockStatsEntry key;
+        if (!pcursor->GetKey(key) || key.key != DB_BLOCK_STATS || (int)key.nHeight > nHeightEnd) {
+            break;
+        }
+        CDiskBlockStats stats;
+        if (!pcursor->GetValue(stats)) {
+            return error("%s : failed to read value", __func__);
+        }
+        mapStats.emplace(key.nHeight, stats);
+        pcursor->Next();
+    }
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
@@ -284,56 +321,129 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+namespace {
+
+//! A block index record decoded by a LoadBlockIndexGuts worker
+struct DecodedBlockIndex
 {
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDiskBlockIndex diskindex;
+    uint256 hashBlock;
+    bool fDecoded{false};
+    bool fValidPoW{true};
+};
 
+//! Deserialize the records in [nBegin, nEnd), compute their block hash and check the proof-of-work
+void DecodeBlockIndexRange(const std::vector<CDataStream>& vRaw, std::vector<DecodedBlockIndex>& vDecoded, size_t nBegin, size_t nEnd)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    for (size_t i = nBegin; i < nEnd; i++) {
+        DecodedBlockIndex& entry = vDecoded[i];
+        try {
+            CDataStream ssValue(vRaw[i]);
+            ssValue >> entry.diskindex;
+        } catch (const std::exception& e) {
+            return;
+        }
+        entry.hashBlock = entry.diskindex.GetBlockHash();
+        entry.fDecoded = true;
+        if (!consensus.NetworkUpgradeActive(entry.diskindex.nHeight, Consensus::UPGRADE_POS)) {
+            entry.fValidPoW = CheckProofOfWork(entry.hashBlock, entry.diskindex.nBits);
+        }
+    }
+}
+
+} // anon namespace
+
+bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nThreads)
+{
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, UINT256_ZERO));
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    // Read the next batch of raw block index records
+    int64_t nTimeRead = 0;
+    auto readBatch = [&](std::vector<CDataStream>& vRaw) {
+        const int64_t nStart = GetTimeMicros();
+        vRaw.clear();
+        while (pcursor->Valid() && vRaw.size() < BLOCK_INDEX_LOAD_BATCH) {
+            std::pair<char, uint256> key;
+            if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) break;
+            vRaw.emplace_back(pcursor->GetValue());
+            pcursor->Next();
+        }
+        nTimeRead += GetTimeMicros() - nStart;
+    };
+
+    std::vector<CDataStream> vRaw, vRawNext;
+    std::vector<DecodedBlockIndex> vDecoded;
+    int64_t nTimeDecode = 0, nTimeInsert = 0;
+    size_t nLoaded = 0;
+
+    // Declared after the buffers, so that pending tasks are done before they go out of scope
+    nThreads = std::max(1, nThreads);
+    ctpl::thread_pool pool(nThreads);
+    RenameThreadPool(pool, "oasis-loadidx");
+
+    readBatch(vRaw);
+    while (!vRaw.empty()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                // sapling
-                pindexNew->nSaplingValue  = diskindex.nSaplingValue;
-                pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
-
-                //Proof Of Stake
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->vStakeModifier = diskindex.vStakeModifier;
-
-                if (!Params().GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_POS)) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
 
-                pcursor->Next();
-            } else {
+        // Decode this batch on the workers while the next one is read from the database
+        vDecoded.assign(vRaw.size(), DecodedBlockIndex());
+        const size_t nChunk = (vRaw.size() + nThreads - 1) / nThreads;
+        std::vector<std::future<void>> vFutures;
+        for (size_t nBegin = 0; nBegin < vRaw.size(); nBegin += nChunk) {
+            const size_t nEnd = std::min(vRaw.size(), nBegin + nChunk);
+            vFutures.emplace_back(pool.push([&vRaw, &vDecoded, nBegin, nEnd](int) {
+                DecodeBlockIndexRange(vRaw, vDecoded, nBegin, nEnd);
+            }));
+        }
+        readBatch(vRawNext);
+        int64_t nTime = GetTimeMicros();
+        for (auto& f : vFutures) f.get();
+        nTimeDecode += GetTimeMicros() - nTime;
+
+        // Link the decoded entries into the block index, in database order
+        nTime = GetTimeMicros();
+        for (const DecodedBlockIndex& entry : vDecoded) {
+            if (!entry.fDecoded) {
                 return error("%s : failed to read value", __func__);
             }
-        } else {
-            break;
+            const CDiskBlockIndex& diskindex = entry.diskindex;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(entry.hashBlock);
+            pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            // sapling
+            pindexNew->nSaplingValue  = diskindex.nSaplingValue;
+            pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
+
+            //Proof Of Stake
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->vStakeModifier = diskindex.vStakeModifier;
+
+            if (!entry.fValidPoW)
+                return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
         }
+        nTimeInsert += GetTimeMicros() - nTime;
+        nLoaded += vDecoded.size();
+
+        std::swap(vRaw, vRawNext);
     }
 
+    LogPrint(BCLog::BENCHMARK, "%s: %u entries with %d threads, read %.2fms, decode wait %.2fms, insert %.2fms\n", __func__,
+             nLoaded, nThreads, nTimeRead * 0.001, nTimeDecode * 0.001, nTimeInsert * 0.001);
     return true;
 }
 
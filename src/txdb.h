@@ -121,6 +121,26 @@ private:
     friend class CCoinsViewDB;
 };
 
+/** Per-block statistics kept by -blockstatsindex (used by getblockindexstats) */
+struct CDiskBlockStats
+{
+    uint256 hashBlock;          // block the entry refers to (entries are keyed by height)
+    int64_t nTxCount{0};        // txes, excluding coinbase/coinstake
+    int64_t nTxCountAll{0};     // txes, including coinbase/coinstake
+    int64_t nTxBytes{0};        // size of the txes, excluding coinbase/coinstake
+    CAmount nFees{0};           // fees of the txes
+    CAmount nShieldedValueIn{0};    // value moved out of the shielded pool (positive valueBalance)
+    CAmount nShieldedValueOut{0};   // value moved into the shielded pool (negative valueBalance)
+
+    SERIALIZE_METHODS(CDiskBlockStats, obj)
+    {
+        READWRITE(obj.hashBlock, obj.nTxCount, obj.nTxCountAll, obj.nTxBytes, obj.nFees, obj.nShieldedValueIn, obj.nShieldedValueOut);
+    }
+};
+
+//! Number of block index records read and decoded together when loading the block index
+static const size_t BLOCK_INDEX_LOAD_BATCH = 4096;
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -138,11 +158,16 @@ public:
     bool ReadReindexing(bool& fReindexing);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect);
+    bool WriteBlockStats(int nHeight, const CDiskBlockStats& stats);
+    //! Read the block stats entries with height in [nHeightStart, nHeightEnd] (missing heights are skipped)
+    bool ReadBlockStats(int nHeightStart, int nHeightEnd, std::map<int, CDiskBlockStats>& mapStats);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
-    bool LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    //! Load the block index entries. Records are read in batches and decoded (deserialization,
+    //! block hash and proof-of-work check) by nThreads workers while the next batch is read.
+    bool LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nThreads = 1);
 };
 
 #endif // BITCOIN_TXDB_H
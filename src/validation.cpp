@@ -18,10 +18,13 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "ctpl.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
 #include "evo/specialtx.h"
 #include "flatfile.h"
 #include "guiinterface.h"
@@ -31,9 +34,11 @@
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "memusage.h"
 #include "policy/policy.h"
 #include "pow.h"
 #include "reverse_iterate.h"
+#include "sapling/sapling_validation.h"
 #include "script/sigcache.h"
 #include "shutdown.h"
 #include "spork.h"
@@ -42,6 +47,7 @@
 #include "txdb.h"
 #include "undo.h"
 #include "util/system.h"
+#include "util/threadnames.h"
 #include "util/validation.h"
 #include "utilmoneystr.h"
 #include "validationinterface.h"
@@ -49,6 +55,7 @@
 #include "bignum.h"
 
 #include <future>
+#include <numeric>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -78,6 +85,7 @@
 RecursiveMutex cs_main;
 
 BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex* pindexBestHeader = NULL;
 CAmount nBurnedCoins = 0;
@@ -95,6 +103,7 @@ int nScriptCheckThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
+bool fBlockStatsIndex = false;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 size_t nCoinCacheUsage = 5000 * 300;
@@ -590,12 +599,13 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
         PrecomputedTransactionData precomTxData(tx);
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        if (!CheckInputs(tx, state, view, true, flags, true, false, precomTxData)) {
             return false;
         }
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
+        // Check again against the consensus-critical flags of the next block
+        // (the mandatory script verification flags, and the ones enforced by
+        // the active upgrades), in case of bugs in the standard flags that cause
         // transactions to pass as valid when they're actually invalid. For
         // instance the STRICTENC flag was incorrectly allowing certain
         // CHECKSIG NOT scripts to pass, even though they were invalid.
@@ -603,10 +613,12 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        flags = MANDATORY_SCRIPT_VERIFY_FLAGS;
-        if (fCLTVIsActivated)
-            flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        //
+        // The result is stored in the script execution cache, so that the
+        // scripts are not executed again when the transaction is connected
+        // in a block with these same flags.
+        flags = GetBlockScriptFlags(chainActive.Tip());
+        if (!CheckInputs(tx, state, view, true, flags, true, true, precomTxData)) {
             return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
                     __func__, hash.ToString(), FormatStateMessage(state));
         }
@@ -799,6 +811,48 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CBlockIndex* pindex)
+{
+    FlatFilePos pos = WITH_LOCK(cs_main, return pindex->GetBlockPos(); );
+    // Seek back to the message start and size written by WriteBlockToDisk
+    const unsigned int nMetaSize = MESSAGE_START_SIZE + sizeof(unsigned int);
+    if (pos.nPos < nMetaSize)
+        return error("%s : invalid block position %s", __func__, pos.ToString());
+    pos.nPos -= nMetaSize;
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    try {
+        CMessageHeader::MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> pchMessageStart >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return error("%s : block magic mismatch at %s", __func__, pos.ToString());
+        if (nSize > MAX_SIZE)
+            return error("%s : block size %u too large at %s", __func__, nSize, pos.ToString());
+        vBlock.resize(nSize);
+        filein.read((char*)vBlock.data(), nSize);
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Only the header is deserialized, to check that these are the bytes of the indexed block.
+    // 112 bytes cover the header of any version, including the Sapling root.
+    CBlockHeader header;
+    try {
+        const char* pch = (const char*)vBlock.data();
+        CDataStream ssHeader(pch, pch + std::min(vBlock.size(), (size_t)112), SER_DISK, CLIENT_VERSION);
+        ssHeader >> header;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize error - %s", __func__, e.what());
+    }
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("%s : block=%s index=%s", __func__, header.GetHash().GetHex(), pindex->GetBlockHash().GetHex());
+    return true;
+}
+
 
 double ConvertBitsToDouble(unsigned int nBits)
 {
@@ -1114,7 +1168,41 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
+/**
+ * Valid script execution cache: entries are SHA256(nonce || txid || flags) of the
+ * transactions whose scripts were all executed successfully with these flags.
+ * Protected by cs_main (CuckooCache requires external locking).
+ */
+static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+static uint256 scriptExecutionCacheNonce(GetRandHash());
+static std::atomic<uint64_t> nScriptExecutionCacheLookups{0};
+static std::atomic<uint64_t> nScriptExecutionCacheHits{0};
+
+void InitScriptExecutionCache()
+{
+    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+void GetScriptExecutionCacheStats(uint64_t& nLookupsRet, uint64_t& nHitsRet)
+{
+    nLookupsRet = nScriptExecutionCacheLookups;
+    nHitsRet = nScriptExecutionCacheHits;
+}
+
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindexPrev)
+{
+    unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+    if (pindexPrev && Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight, Consensus::UPGRADE_BIP65))
+        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    return flags;
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase() ) {
 
@@ -1132,19 +1220,40 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // First check if the scripts were already executed with the same flags
+            // (when the transaction was accepted to the mempool). The txid commits
+            // to the prevouts, hence to the scriptPubKeys of the coins being spent.
+            uint256 hashCacheEntry;
+            // We only use the first 19 bytes of nonce to avoid a second SHA
+            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            AssertLockHeld(cs_main);
+            const bool fHit = scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore);
+            if (!cacheSigStore) {
+                // Connecting a block
+                nScriptExecutionCacheLookups++;
+                if (fHit) nScriptExecutionCacheHits++;
+            }
+            if (fHit) {
+                return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
                 assert(!coin.IsSpent());
 
                 // We very carefully only pass in things to CScriptCheck which
-                // are clearly committed to by tx' witness hash. This provides
-                // a sanity check that our caching is not introducing consensus
-                // failures through additional data in, eg, the coins being
-                // spent being checked as a part of CScriptCheck.
+                // are committed to by the script execution cache key: the txid
+                // (the scriptSigs and, through the prevouts, the coins being
+                // spent) and the script flags. This provides a sanity check
+                // that our caching is not introducing consensus failures
+                // through additional data being checked as a part of
+                // CScriptCheck.
 
                 // Verify signature
-                CScriptCheck check(coin.out, tx, i, flags, cacheStore, &precomTxData);
+                CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &precomTxData);
                 if (pvChecks) {
                     pvChecks->emplace_back();
                     check.swap(pvChecks->back());
@@ -1157,7 +1266,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(coin.out, tx, i,
-                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &precomTxData);
+                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, &precomTxData);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1171,6 +1280,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // We executed all of the provided scripts, and were told to
+                // cache the result. Do so now.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1224,6 +1339,8 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, FlatFilePos& pos, const uint25
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1249,7 +1366,53 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint2
     return true;
 }
 
-} // anon namespace
+CDiskBlockStats ComputeBlockStats(const CBlock& block, const CBlockUndo& blockundo)
+{
+    CDiskBlockStats stats;
+    stats.hashBlock = block.GetHash();
+    const int ntx = block.vtx.size();
+    const int firstTxIndex = block.IsProofOfStake() ? 2 : 1;
+    stats.nTxCountAll = ntx;
+    stats.nTxCount = std::max(0, ntx - firstTxIndex);
+
+    for (int idx = 0; idx < ntx; idx++) {
+        const CTransaction& tx = *(block.vtx[idx]);
+        if (tx.hasSaplingData()) {
+            if (tx.sapData->valueBalance > 0) stats.nShieldedValueIn += tx.sapData->valueBalance;
+            else stats.nShieldedValueOut -= tx.sapData->valueBalance;
+        }
+        // size and fee, except for coinbase/coinstake
+        if (idx < firstTxIndex) continue;
+        stats.nTxBytes += GetSerializeSize(tx, CLIENT_VERSION);
+
+        // vtxundo has no entry for the coinbase
+        CAmount nValueIn = tx.GetShieldedValueIn();
+        for (const Coin& coin : blockundo.vtxundo[idx - 1].vprevout) {
+            nValueIn += coin.out.nValue;
+        }
+        stats.nFees += nValueIn - tx.GetValueOut();
+    }
+    return stats;
+}
+
+bool ReadBlockStatsFromDisk(const CBlockIndex* pindex, CDiskBlockStats& stats)
+{
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+
+    CBlockUndo blockundo;
+    if (pindex->pprev) {
+        const FlatFilePos& pos = pindex->GetUndoPos();
+        if (pos.IsNull() || !UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash()))
+            return error("%s : failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s : block and undo data inconsistent", __func__);
+
+    stats = ComputeBlockStats(block, blockundo);
+    return true;
+}
 
 enum DisconnectResult
 {
@@ -1421,6 +1584,14 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CSaplingCheck> saplingcheckqueue(16);
+
+void ThreadSaplingCheck()
+{
+    util::ThreadRename("oasis-saplingch");
+    saplingcheckqueue.Thread();
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeProcessSpecial = 0;
 static int64_t nTimeConnect = 0;
@@ -1504,10 +1675,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
 
     // If scripts won't be checked anyways, don't bother seeing if CLTV is activated
-    bool fCLTVIsActivated = false;
-    if (fScriptChecks && pindex->pprev) {
-        fCLTVIsActivated = consensus.NetworkUpgradeActive(pindex->pprev->nHeight, Consensus::UPGRADE_BIP65);
-    }
+    const unsigned int flags = fScriptChecks ? GetBlockScriptFlags(pindex->pprev) : 0;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
@@ -1529,6 +1697,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     // Sapling
     SaplingMerkleTree sapling_tree;
     assert(view.GetSaplingAnchorAt(view.GetBestAnchor(), sapling_tree));
+    std::vector<uint256> vSaplingCommitments;
 
     std::vector<PrecomputedTransactionData> precomTxData;
     precomTxData.reserve(block.vtx.size()); // Required so that pointers to individual precomTxData don't get invalidated
@@ -1576,12 +1745,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             nValueIn += txValueIn;
 
             std::vector<CScriptCheck> vChecks;
-            unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
-            if (fCLTVIsActivated)
-                flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
                 return error("%s: Check inputs on %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
 
@@ -1602,10 +1767,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         const bool fSkipInvalid = SkipInvalidUTXOS(pindex->nHeight);
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight, fSkipInvalid);
 
-        // Sapling update tree
+        // Sapling commitments, appended to the tree once the whole block is connected
         if (tx.IsShieldedTx() && !tx.sapData->vShieldedOutput.empty()) {
             for(const OutputDescription &outputDescription : tx.sapData->vShieldedOutput) {
-                sapling_tree.append(outputDescription.cmu);
+                vSaplingCommitments.emplace_back(outputDescription.cmu);
             }
         }
 
@@ -1613,7 +1778,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         pos.nTxOffset += ::GetSerializeSize(tx, CLIENT_VERSION);
     }
 
-    // Push new tree anchor
+    // Update the Sapling tree and push the new anchor
+    sapling_tree.append(vSaplingCommitments);
     view.PushAnchor(sapling_tree);
 
     // Verify header correctness
@@ -1716,6 +1882,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (fBlockStatsIndex)
+        if (!pblocktree->WriteBlockStats(pindex->nHeight, ComputeBlockStats(block, blockundo)))
+            return AbortNode(state, "Failed to write block stats index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
     evoDb->WriteBestBlock(pindex->GetBlockHash());
@@ -2442,7 +2612,7 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlock& block)
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
 {
     // Check for duplicate
     uint256 hash = block.GetHash();
@@ -2451,7 +2621,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.Alloc(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2464,16 +2634,6 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         pindexNew->pprev = (*miPrev).second;
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
-
-        const Consensus::Params& consensus = Params().GetConsensus();
-        if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_TIME_V2)) {
-            // compute and set new V1 stake modifier (entropy bits)
-            pindexNew->SetNewStakeModifier();
-
-        } else {
-            // compute and set new V2 stake modifier (hash of prevout and prevModifier)
-            pindexNew->SetNewStakeModifier(block.vtx[1]->vin[0].prevout.hash);
-        }
     }
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
@@ -2491,6 +2651,21 @@ bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBl
 {
     if (block.IsProofOfStake())
         pindexNew->SetProofOfStake();
+
+    // The stake modifier needs the block body (and the modifiers of all its ancestors),
+    // so it is computed here rather than when the header is added to the index.
+    if (pindexNew->pprev) {
+        const Consensus::Params& consensus = Params().GetConsensus();
+        if (!consensus.NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_TIME_V2)) {
+            // compute and set new V1 stake modifier (entropy bits)
+            pindexNew->SetNewStakeModifier();
+
+        } else {
+            // compute and set new V2 stake modifier (hash of prevout and prevModifier)
+            pindexNew->SetNewStakeModifier(block.vtx[1]->vin[0].prevout.hash);
+        }
+    }
+
     pindexNew->nTx = block.vtx.size();
     pindexNew->nChainTx = 0;
 
@@ -2816,14 +2991,17 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 }
 
 
-bool CheckWork(const CBlock& block, const CBlockIndex* const pindexPrev)
+bool CheckWork(const CBlockHeader& block, const CBlockIndex* const pindexPrev)
 {
     if (pindexPrev == NULL)
         return error("%s : null pindexPrev for block %s", __func__, block.GetHash().GetHex());
 
     unsigned int nBitsRequired = GetNextWorkRequired(pindexPrev, &block);
 
-    if (!Params().IsRegTestNet() && block.IsProofOfWork() && (pindexPrev->nHeight + 1 <= 68589)) {
+    // PoW and PoS blocks are not mixed (see ConnectBlock), so the height tells which one this is
+    // even when only the header is known.
+    const bool fProofOfWork = !Params().GetConsensus().NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_POS);
+    if (!Params().IsRegTestNet() && fProofOfWork && (pindexPrev->nHeight + 1 <= 68589)) {
         double n1 = ConvertBitsToDouble(block.nBits);
         double n2 = ConvertBitsToDouble(nBitsRequired);
 
@@ -2928,12 +3106,17 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
 {
     const int nHeight = pindexPrev == nullptr ? 0 : pindexPrev->nHeight + 1;
     const CChainParams& chainparams = Params();
+    const bool fIBD = IsInitialBlockDownload();
+
+    // Sapling proofs are verified by the check threads (if any), after the other checks
+    std::vector<CSaplingCheck> vSaplingChecks;
+    std::vector<CSaplingCheck>* pvSaplingChecks = nScriptCheckThreads ? &vSaplingChecks : nullptr;
 
     // Check that all transactions are finalized
     for (const auto& tx : block.vtx) {
 
         // Check transaction contextually against consensus rules at block height
-        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true /* isMined */, IsInitialBlockDownload())) {
+        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true /* isMined */, fIBD, pvSaplingChecks)) {
             return false;
         }
 
@@ -2942,6 +3125,21 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
         }
     }
 
+    if (!vSaplingChecks.empty()) {
+        CCheckQueueControl<CSaplingCheck> control(&saplingcheckqueue);
+        control.Add(vSaplingChecks);
+        if (!control.Wait()) {
+            // Verify serially to find the failing transaction and its reject reason
+            for (const auto& tx : block.vtx) {
+                if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true /* isMined */, fIBD)) {
+                    return false;
+                }
+            }
+            return state.DoS(100, error("%s: Sapling proofs verification failed", __func__),
+                             REJECT_INVALID, "bad-txns-sapling-proofs-invalid");
+        }
+    }
+
     if (block.IsProofOfStake()) {
         CTransactionRef csTx = block.vtx[1];
         if (csTx->vin.size() > 1) {
@@ -2960,8 +3158,8 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     return true;
 }
 
-// Get the index of previous block of given CBlock
-bool GetPrevIndex(const CBlock& block, CBlockIndex** pindexPrevRet, CValidationState& state)
+// Get the index of previous block of given block header
+bool GetPrevIndex(const CBlockHeader& block, CBlockIndex** pindexPrevRet, CValidationState& state)
 {
     CBlockIndex*& pindexPrev = *pindexPrevRet;
     pindexPrev = nullptr;
@@ -2990,7 +3188,7 @@ bool GetPrevIndex(const CBlock& block, CBlockIndex** pindexPrevRet, CValidationS
     return true;
 }
 
-bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex** ppindex, CBlockIndex* pindexPrev)
+bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex, CBlockIndex* pindexPrev)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3190,6 +3388,11 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockInde
     if (!GetPrevIndex(block, &pindexPrev, state))
         return false;
 
+    // With headers-first sync the parent may be known by header only. The PoS checks
+    // below need its stake modifier, so the parent body must be connected to the index first.
+    if (pindexPrev && !(pindexPrev->nStatus & BLOCK_HAVE_DATA))
+        return state.Error("prevblk-not-downloaded");
+
    if (block.GetHash() != consensus.hashGenesisBlock && !CheckWork(block, pindexPrev))
         return state.DoS(100, false, REJECT_INVALID);
 
@@ -3345,6 +3548,43 @@ bool ProcessNewBlock(const std::shared_ptr<const CBlock>& pblock, const FlatFile
     return true;
 }
 
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, CBlockIndex** ppindex)
+{
+    AssertLockNotHeld(cs_main);
+
+    const Consensus::Params& consensus = Params().GetConsensus();
+    {
+        LOCK(cs_main);
+        for (const CBlockHeader& header : headers) {
+            CBlockIndex* pindex = nullptr;
+            BlockMap::iterator mi = mapBlockIndex.find(header.GetHash());
+            if (mi == mapBlockIndex.end()) {
+                CBlockIndex* pindexPrev = nullptr;
+                if (!GetPrevIndex(header, &pindexPrev, state))
+                    return false;
+                if (pindexPrev == nullptr)
+                    return state.Invalid(error("%s : unexpected genesis header", __func__), 0, "bad-genesis");
+
+                if (!consensus.NetworkUpgradeActive(pindexPrev->nHeight + 1, Consensus::UPGRADE_POS) &&
+                        !CheckProofOfWork(header.GetHash(), header.nBits))
+                    return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+
+                if (!CheckWork(header, pindexPrev))
+                    return state.DoS(100, false, REJECT_INVALID, "bad-diffbits", false, "incorrect work");
+
+                if (!AcceptBlockHeader(header, state, &pindex, pindexPrev))
+                    return false;
+            } else if (!AcceptBlockHeader(header, state, &pindex)) {
+                // already known, fails only if it was marked invalid
+                return false;
+            }
+            if (ppindex)
+                *ppindex = pindex;
+        }
+    }
+    return true;
+}
+
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* const pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckBlockSig)
 {
     AssertLockHeld(cs_main);
@@ -3412,7 +3652,7 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = blockIndexArena.Alloc();
     mi = mapBlockIndex.emplace(hash, pindexNew).first;
 
     pindexNew->phashBlock = &((*mi).first);
@@ -3422,29 +3662,45 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(std::string& strError)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex)){
+    int64_t nStart = GetTimeMicros();
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, std::max(1, nScriptCheckThreads))){
         return false;
     }
-        
+    int64_t nTime1 = GetTimeMicros();
+    LogPrintf("%s: loaded %u block index entries in %.2fms, memory usage %.2fMiB (map %.2fMiB, entries %.2fMiB)\n", __func__,
+              mapBlockIndex.size(), 0.001 * (nTime1 - nStart),
+              (memusage::DynamicUsage(mapBlockIndex) + blockIndexArena.DynamicMemoryUsage()) * (1.0 / (1<<20)),
+              memusage::DynamicUsage(mapBlockIndex) * (1.0 / (1<<20)),
+              blockIndexArena.DynamicMemoryUsage() * (1.0 / (1<<20)));
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    // Calculate nChainWork, in height order. Heights are dense, so the entries
+    // are ordered with a counting sort instead of a comparison sort.
+    int nMaxHeight = 0;
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    }
+    std::vector<size_t> vHeightOffset(nMaxHeight + 2, 0);
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+        vHeightOffset[item.second->nHeight + 1]++;
+    }
+    std::partial_sum(vHeightOffset.begin(), vHeightOffset.end(), vHeightOffset.begin());
+    std::vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
     for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.emplace_back(pindex->nHeight, pindex);
+        vSortedByHeight[vHeightOffset[item.second->nHeight]++] = item.second;
     }
-    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight) {
+    int64_t nTime2 = GetTimeMicros();
+
+    std::set<int> setBlkDataFiles;
+    for (CBlockIndex* pindex : vSortedByHeight) {
         // Stop if shutdown was requested
         if (ShutdownRequested()) return false;
 
-        CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         if (pindex->nStatus & BLOCK_HAVE_DATA) {
+            setBlkDataFiles.insert(pindex->nFile);
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -3474,6 +3730,8 @@ bool static LoadBlockIndexDB(std::string& strError)
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTime3 = GetTimeMicros();
+    LogPrint(BCLog::BENCHMARK, "%s: sort by height %.2fms, chain work pass %.2fms\n", __func__, 0.001 * (nTime2 - nTime1), 0.001 * (nTime3 - nTime2));
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -3494,13 +3752,6 @@ bool static LoadBlockIndexDB(std::string& strError)
 
     // Check presence of blk files
     LogPrintf("Checking all blk files are present...\n");
-    std::set<int> setBlkDataFiles;
-    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
-        CBlockIndex* pindex = item.second;
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
-            setBlkDataFiles.insert(pindex->nFile);
-        }
-    }
     for (std::set<int>::iterator it = setBlkDataFiles.begin(); it != setBlkDataFiles.end(); it++) {
         FlatFilePos pos(*it, 0);
         if (CAutoFile(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION).IsNull()) {
@@ -3781,10 +4032,8 @@ void UnloadBlockIndex()
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
 }
 
 bool LoadBlockIndex(std::string& strError)
@@ -3844,10 +4093,146 @@ bool LoadGenesisBlock()
 }
 
 
-bool LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
+namespace {
+/** A block read from an external file, and its position in the file (if reindexing) */
+struct CExternalBlock
+{
+    std::shared_ptr<const CBlock> block;
+    uint256 hash;
+    FlatFilePos pos;
+};
+
+/** The blocks of a block file, read ahead while the previous files are being processed */
+struct CReindexFile
+{
+    bool fOpened{false};
+    std::vector<CExternalBlock> vBlocks;
+    uint64_t nBytes{0};
+    int64_t nReadTimeMillis{0};
+};
+}
+
+/**
+ * Read the blocks of an external file, in file order, and pass them to fn (stopping if it
+ * returns false). dbp is the position of the file, if the blocks are to be stored at it.
+ * Returns the number of bytes read.
+ */
+static uint64_t ReadExternalBlockFile(FILE* fileIn, const FlatFilePos* dbp, const std::function<bool(CExternalBlock&&)>& fn)
+{
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        blkdat.SetPos(nRewind);
+        nRewind++;         // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(Params().MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> buf;
+            if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            CExternalBlock extBlock;
+            if (dbp) {
+                extBlock.pos = FlatFilePos(dbp->nFile, nBlockPos);
+            }
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            blkdat >> *pblock;
+            nRewind = blkdat.GetPos();
+            extBlock.hash = pblock->GetHash();
+            extBlock.block = std::move(pblock);
+            if (!fn(std::move(extBlock))) {
+                break;
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return blkdat.GetPos();
+}
+
+/**
+ * Process a block read from an external file. Out of order blocks are stored, and processed
+ * once their parent is (only when reindexing). Returns false if the block is invalid.
+ */
+static bool ProcessExternalBlock(const CExternalBlock& extBlock, bool fReindexing, BlockStateCatcher& stateCatcher, int& nLoaded)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, FlatFilePos> mapBlocksUnknownParent;
+
+    const CBlock& block = *extBlock.block;
+    const uint256& hash = extBlock.hash;
+    FlatFilePos pos = extBlock.pos;
+    FlatFilePos* dbp = fReindexing ? &pos : nullptr;
+
+    // detect out of order blocks, and store them for later
+    // (a parent known only by its header counts as unknown)
+    BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock);
+    if (hash != Params().GetConsensus().hashGenesisBlock &&
+            (miPrev == mapBlockIndex.end() || !(miPrev->second->nStatus & BLOCK_HAVE_DATA))) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
+                hash.GetHex(), block.hashPrevBlock.GetHex());
+        if (dbp)
+            mapBlocksUnknownParent.emplace(block.hashPrevBlock, *dbp);
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        stateCatcher.setBlockHash(hash);
+        if (ProcessNewBlock(extBlock.block, dbp)) {
+            nLoaded++;
+        }
+        if (stateCatcher.stateErrorFound()) {
+            return false;
+        }
+    } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, FlatFilePos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockChild = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockChild, it->second)) {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockChild->GetHash().ToString(),
+                    head.ToString());
+                if (ProcessNewBlock(pblockChild, &it->second)) {
+                    nLoaded++;
+                    queue.emplace_back(pblockChild->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+        }
+    }
+    return true;
+}
+
+bool LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
+{
     int64_t nStart = GetTimeMillis();
 
     // Block checked event listener
@@ -3856,93 +4241,15 @@ bool LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        ReadExternalBlockFile(fileIn, dbp, [&](CExternalBlock&& extBlock) {
             boost::this_thread::interruption_point();
-
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
             try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> buf;
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
-                            hash.GetHex(), block.hashPrevBlock.GetHex());
-                    if (dbp)
-                        mapBlocksUnknownParent.emplace(block.hashPrevBlock, *dbp);
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    std::shared_ptr<const CBlock> block_ptr = std::make_shared<const CBlock>(block);
-                    stateCatcher.setBlockHash(block_ptr->GetHash());
-                    if (ProcessNewBlock(block_ptr, dbp)) {
-                        nLoaded++;
-                    }
-                    if (stateCatcher.stateErrorFound()) {
-                        break;
-                    }
-                } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, FlatFilePos>::iterator, std::multimap<uint256, FlatFilePos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, FlatFilePos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            std::shared_ptr<const CBlock> block_ptr = std::make_shared<const CBlock>(block);
-                            if (ProcessNewBlock(block_ptr, &it->second)) {
-                                nLoaded++;
-                                queue.emplace_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                    }
-                }
+                return ProcessExternalBlock(extBlock, dbp != nullptr, stateCatcher, nLoaded);
             } catch (const std::exception& e) {
                 LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+                return true;
             }
-        }
+        });
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -3951,6 +4258,108 @@ bool LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp)
     return nLoaded > 0;
 }
 
+/** Read the blocks of the block file nFile (reindex reader stage) */
+static CReindexFile ReadReindexFile(int nFile, const std::atomic<bool>& fStop)
+{
+    CReindexFile ret;
+    const FlatFilePos pos(nFile, 0);
+    FILE* file = OpenBlockFile(pos, true);
+    if (!file) {
+        return ret; // This error is logged in OpenBlockFile
+    }
+    ret.fOpened = true;
+    int64_t nStart = GetTimeMillis();
+    try {
+        ret.nBytes = ReadExternalBlockFile(file, &pos, [&](CExternalBlock&& extBlock) {
+            ret.vBlocks.emplace_back(std::move(extBlock));
+            return !fStop && !ShutdownRequested();
+        });
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    ret.nReadTimeMillis = GetTimeMillis() - nStart;
+    return ret;
+}
+
+void ReindexBlockFiles()
+{
+    const int nThreads = std::max(1, std::min(GetNumCores() - 1, MAX_REINDEX_READ_THREADS));
+    LogPrintf("Reindexing with %d block file reader threads\n", nThreads);
+
+    std::atomic<bool> fStop{false};
+    ctpl::thread_pool readerPool(nThreads);
+    RenameThreadPool(readerPool, "oasis-reindex");
+
+    // The files being read, in file order. At most nThreads files are read ahead of the
+    // one being processed, to bound the memory used by the deserialized blocks.
+    std::deque<std::future<CReindexFile>> queue;
+    int nNextFile = 0;
+    auto fnReadAhead = [&]() {
+        while ((int)queue.size() < nThreads && fs::exists(GetBlockPosFilename(FlatFilePos(nNextFile, 0)))) {
+            const int nFile = nNextFile++;
+            queue.emplace_back(readerPool.push([nFile, &fStop](int threadId) { return ReadReindexFile(nFile, fStop); }));
+        }
+    };
+
+    BlockStateCatcher stateCatcher(UINT256_ZERO);
+    stateCatcher.registerEvent();
+
+    int nFile = 0;
+    int nLoaded = 0;
+    uint64_t nTotalBytes = 0;
+    int64_t nTotalReadMillis = 0, nTotalWaitMillis = 0, nTotalProcessMillis = 0;
+    const int64_t nStart = GetTimeMillis();
+    try {
+        fnReadAhead();
+        while (!queue.empty()) {
+            int64_t nTime1 = GetTimeMillis();
+            CReindexFile reindexFile = queue.front().get();
+            queue.pop_front();
+            if (!reindexFile.fOpened) {
+                break;
+            }
+            // Keep the readers busy while this file is processed
+            fnReadAhead();
+
+            int64_t nTime2 = GetTimeMillis();
+            int nFileLoaded = 0;
+            for (const CExternalBlock& extBlock : reindexFile.vBlocks) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!ProcessExternalBlock(extBlock, true, stateCatcher, nFileLoaded)) {
+                        break;
+                    }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+                }
+            }
+            int64_t nTime3 = GetTimeMillis();
+
+            nLoaded += nFileLoaded;
+            nTotalBytes += reindexFile.nBytes;
+            nTotalReadMillis += reindexFile.nReadTimeMillis;
+            nTotalWaitMillis += nTime2 - nTime1;
+            nTotalProcessMillis += nTime3 - nTime2;
+            LogPrintf("Reindexed block file blk%05u.dat: %u blocks, %.2fMiB read in %dms (waited %dms), %d blocks processed in %dms\n",
+                      (unsigned int)nFile, reindexFile.vBlocks.size(), reindexFile.nBytes * (1.0 / (1<<20)),
+                      reindexFile.nReadTimeMillis, nTime2 - nTime1, nFileLoaded, nTime3 - nTime2);
+            nFile++;
+        }
+    } catch (...) {
+        // Interrupted: drop the files not read yet, and wait for the readers
+        fStop = true;
+        readerPool.stop(false);
+        throw;
+    }
+    // Don't finish reading the files left after an error
+    fStop = true;
+
+    LogPrintf("Reindexed %d block files in %dms: %d blocks processed, %.2fMiB read by %d threads in %dms, "
+              "waited for the readers %dms, processing %dms\n",
+              nFile, GetTimeMillis() - nStart, nLoaded, nTotalBytes * (1.0 / (1<<20)), nThreads,
+              nTotalReadMillis, nTotalWaitMillis, nTotalProcessMillis);
+}
+
 void static CheckBlockIndex()
 {
     if (!fCheckBlockIndex) {
@@ -4250,10 +4659,8 @@ public:
     ~CMainCleanup()
     {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
 
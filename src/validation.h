@@ -40,6 +40,8 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
+struct CDiskBlockStats;
 class CBudgetManager;
 class CCoinsViewDB;
 class CSporkDB;
@@ -67,6 +69,8 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
 /** Default for -txindex */
 static const bool DEFAULT_TXINDEX = true;
+/** Default for -blockstatsindex */
+static const bool DEFAULT_BLOCKSTATSINDEX = false;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 /** The maximum size for transactions we're willing to relay/mine */
 static const unsigned int MAX_STANDARD_TX_SIZE = 100000;
@@ -85,6 +89,8 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads reading the block files ahead when reindexing */
+static const int MAX_REINDEX_READ_THREADS = 4;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -123,6 +129,8 @@ extern RecursiveMutex cs_main;
 extern CTxMemPool mempool;
 typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
+//! Owns the CBlockIndex entries referenced by mapBlockIndex
+extern CBlockIndexArena blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern int64_t nTimeBestReceived;
@@ -138,6 +146,7 @@ extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fBlockStatsIndex;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern size_t nCoinCacheUsage;
@@ -172,6 +181,20 @@ extern CBlockIndex* pindexBestHeader;
  */
 bool ProcessNewBlock(const std::shared_ptr<const CBlock>& pblock, const FlatFilePos* dbp);
 
+/**
+ * Process incoming block headers.
+ *
+ * Headers are checked for work and context and added to the block index, so that the
+ * corresponding blocks can be requested in parallel. Proof-of-stake and block signature
+ * checks need the block body and are performed once it arrives (see ProcessNewBlock).
+ *
+ * @param[in]  headers     The block headers themselves, in chain order
+ * @param[out] state       This may be set to an Error state if any error occurred processing them
+ * @param[out] ppindex     If set, the pointer will be set to point to the last new block index object for the given headers
+ * @return True if all headers were accepted
+ */
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, CBlockIndex** ppindex = nullptr);
+
 /** Open a block file (blk?????.dat) */
 FILE* OpenBlockFile(const FlatFilePos& pos, bool fReadOnly = false);
 /** Open an undo file (rev?????.dat) */
@@ -180,6 +203,11 @@ FILE* OpenUndoFile(const FlatFilePos& pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const FlatFilePos &pos);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, FlatFilePos* dbp = NULL);
+/**
+ * Reindex the block files (blk?????.dat): reader threads deserialize the blocks of the
+ * next files while the blocks of the current one are processed, in file order.
+ */
+void ReindexBlockFiles();
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock();
 /** Load the block tree and coins database from disk,
@@ -193,6 +221,8 @@ void UnloadBlockIndex();
 int ActiveProtocol();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the Sapling proofs checking thread */
+void ThreadSaplingCheck();
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -241,12 +271,22 @@ CAmount GetShieldedTxMinFee(const CTransaction& tx);
  *   DUP CHECKSIG DROP ... repeated 100 times... OP_1
  */
 
+/** Initializes the script execution cache (half of -maxsigcachesize) */
+void InitScriptExecutionCache();
+/** Number of transactions looked up in the script execution cache while connecting blocks, and hits */
+void GetScriptExecutionCacheStats(uint64_t& nLookupsRet, uint64_t& nHitsRet);
+/** Script verification flags of the block following pindexPrev */
+unsigned int GetBlockScriptFlags(const CBlockIndex* pindexPrev);
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
  * instead of being performed inline.
+ * cacheSigStore stores the valid signatures in the signature cache, cacheFullScriptStore stores
+ * the transaction in the script execution cache once all its scripts are executed successfully
+ * (otherwise a hit in the script execution cache is consumed).
  */
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight, bool fSkipInvalid = false);
@@ -313,13 +353,21 @@ public:
 bool WriteBlockToDisk(const CBlock& block, FlatFilePos& pos);
 bool ReadBlockFromDisk(CBlock& block, const FlatFilePos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const FlatFilePos& pos, const uint256& hashBlock);
+/** Read the serialized bytes of a block, as they are relayed, without deserializing its transactions */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CBlockIndex* pindex);
+
+/** Compute the statistics of a block (indexed by -blockstatsindex), using the values of the spent coins in its undo data */
+CDiskBlockStats ComputeBlockStats(const CBlock& block, const CBlockUndo& blockundo);
+/** Compute the statistics of a connected block, reading the block and its undo data from disk */
+bool ReadBlockStatsFromDisk(const CBlockIndex* pindex, CDiskBlockStats& stats);
 
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
-bool CheckWork(const CBlock& block, const CBlockIndex* const pindexPrev);
+bool CheckWork(const CBlockHeader& block, const CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev);
@@ -328,7 +376,7 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckBlockSig = true);
 
-bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex** ppindex = nullptr, CBlockIndex* pindexPrev = nullptr);
+bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex = nullptr, CBlockIndex* pindexPrev = nullptr);
 
 
 /** RAII wrapper for VerifyDB: Verify consistency of the block and coin databases */
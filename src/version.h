@@ -12,7 +12,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 90914;
+static const int PROTOCOL_VERSION = 90916;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -24,6 +24,12 @@ static const int MIN_PEER_PROTO_VERSION_AFTER_ENFORCEMENT = 90913;
 //! Version where BIP155 was introduced
 static const int MIN_BIP155_PROTOCOL_VERSION = 90914;
 
+//! Version where getheaders is answered with headers (headers-first sync)
+static const int HEADERS_FIRST_VERSION = 90915;
+
+//! Version where compact block relay (BIP152) was introduced
+static const int COMPACT_BLOCKS_VERSION = 90916;
+
 // Make sure that none of the values above collide with
 // `ADDRV2_FORMAT`.
 
@@ -8,6 +8,7 @@
 
 #include "guiinterfaceutil.h"
 #include "net.h"
+#include "sapling/sapling_operation_queue.h"
 #include "util/system.h"
 #include "utilmoneystr.h"
 #include "validation.h"
@@ -26,6 +27,7 @@ std::string GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf("Fee (in %s/kB) to add to transactions you send (default: %s)", CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", "Rescan the block chain for missing wallet transactions on startup");
     strUsage += HelpMessageOpt("-salvagewallet", "Attempt to recover private keys from a corrupt wallet file on startup");
+    strUsage += HelpMessageOpt("-shieldsendthreads=<n>", strprintf("Number of shielded sends queued by shieldsendmanyasync executed at the same time (1-%d, default: %d)", MAX_SHIELD_SEND_THREADS, DEFAULT_SHIELD_SEND_THREADS));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf("Spend unconfirmed change when sending transactions (default: %u)", DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)", 1));
     strUsage += HelpMessageOpt("-upgradewallet", "Upgrade wallet to latest format on startup");
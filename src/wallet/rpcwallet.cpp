@@ -19,8 +19,10 @@
 #include "messagesigner.h"
 #include "net.h"
 #include "policy/feerate.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "sapling/sapling_operation.h"
+#include "sapling/sapling_operation_queue.h"
 #include "sapling/key_io_sapling.h"
 #include "shutdown.h"
 #include "spork.h"
@@ -1745,10 +1747,10 @@ UniValue viewshieldtransaction(const JSONRPCRequest& request)
     return entry;
 }
 
-static SaplingOperation CreateShieldedTransaction(CWallet* const pwallet, const JSONRPCRequest& request)
+// Set up the operation with the shieldsendmany parameters, without building it
+static void SetupShieldedTransaction(CWallet* const pwallet, const JSONRPCRequest& request, SaplingOperation& operation)
 {
-    LOCK2(cs_main, pwallet->cs_wallet);
-    SaplingOperation operation(Params().GetConsensus(), pwallet);
+    AssertLockHeld(pwallet->cs_wallet);
 
     // Param 0: source of funds. Can either be a valid address, sapling address,
     // or the string "from_transparent"|"from_trans_cold"|"from_shield"
@@ -1903,10 +1905,18 @@ static SaplingOperation CreateShieldedTransaction(CWallet* const pwallet, const
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Minconf cannot be negative");
     }
 
+    operation.setMinDepth(nMinDepth)
+            ->setRecipients(recipients);
+}
+
+static SaplingOperation CreateShieldedTransaction(CWallet* const pwallet, const JSONRPCRequest& request)
+{
+    LOCK2(cs_main, pwallet->cs_wallet);
+    SaplingOperation operation(Params().GetConsensus(), pwallet);
+    SetupShieldedTransaction(pwallet, request, operation);
+
     // Build the send operation
-    OperationResult res = operation.setMinDepth(nMinDepth)
-            ->setRecipients(recipients)
-            ->build();
+    OperationResult res = operation.build();
     if (!res) throw JSONRPCError(RPC_WALLET_ERROR, res.getError());
     return operation;
 }
@@ -2025,6 +2035,200 @@ UniValue rawshieldsendmany(const JSONRPCRequest& request)
     return EncodeHexTx(tx);
 }
 
+UniValue shieldsendmanyasync(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp))
+        return NullUniValue;
+
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 5)
+        throw std::runtime_error(
+                "shieldsendmanyasync \"fromaddress\" [{\"address\":... ,\"amount\":...},...] ( minconf fee subtract_fee_from )\n"
+                "\nQueue a shieldsendmany operation and return its id right away. The inputs are selected,\n"
+                "the proofs are made and the transaction is sent by a background worker (see -shieldsendthreads).\n"
+                "Use getoperationstatus and getoperationresult to follow the operation."
+                + HelpRequiringPassphrase(pwallet) + "\n"
+
+                "\nArguments:\n"
+                "1. \"fromaddress\"         (string, required) The transparent addr or shield addr to send the funds from.\n"
+                "                             It can also be the string \"from_transparent\"|\"from_shield\" to send the funds\n"
+                "                             from any transparent|shield address available.\n"
+                "                             Additionally, it can be the string \"from_trans_cold\" to select transparent funds,\n"
+                "                             possibly including delegated coins, if needed.\n"
+                "2. \"amounts\"             (array, required) An array of json objects representing the amounts to send.\n"
+                "    [{\n"
+                "      \"address\":address  (string, required) The address is a transparent addr or shield addr\n"
+                "      \"amount\":amount    (numeric, required) The numeric amount in " + "XOS" + " is the value\n"
+                "      \"memo\":memo        (string, optional) If the address is a shield addr, message string of max 512 bytes\n"
+                "    }, ... ]\n"
+                "3. minconf               (numeric, optional, default=1) Only use funds confirmed at least this many times.\n"
+                "4. fee                   (numeric, optional), The fee amount to attach to this transaction.\n"
+                "                            If not specified, or set to 0, the wallet will try to compute the minimum possible fee for a shield TX,\n"
+                "                            based on the expected transaction size and the current value of -minRelayTxFee.\n"
+                "5. subtract_fee_from     (array, optional) A json array with addresses.\n"
+                "                           The fee will be equally deducted from the amount of each selected address.\n"
+                "    [\n"
+                "      \"address\"          (string) Subtract fee from this address\n"
+                "      ,...\n"
+                "    ]\n"
+                "\nResult:\n"
+                "\"operationid\"          (string) the id of the queued operation\n"
+                "\nExamples:\n"
+                + HelpExampleCli("shieldsendmanyasync",
+                                 "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\" '[{\"address\": \"ps1ra969yfhvhp73rw5ak2xvtcm9fkuqsnmad7qln79mphhdrst3lwu9vvv03yuyqlh42p42st47qd\" ,\"amount\": 5.0}]'")
+                + HelpExampleRpc("shieldsendmanyasync",
+                                 "\"DMJRSsuU9zfyrvxVaAEFQqK4MxZg6vgeS6\", [{\"address\": \"ps1ra969yfhvhp73rw5ak2xvtcm9fkuqsnmad7qln79mphhdrst3lwu9vvv03yuyqlh42p42st47qd\" ,\"amount\": 5.0}]")
+        );
+
+    EnsureWalletIsUnlocked(pwallet);
+
+    // Make sure the results are valid at least up to the most recent block
+    // the user could have gotten from another RPC command prior to now
+    pwallet->BlockUntilSyncedToCurrentChain();
+
+    // The parameters are checked now, the transaction is built by the worker
+    std::unique_ptr<SaplingOperation> operation(new SaplingOperation(Params().GetConsensus(), pwallet));
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+        SetupShieldedTransaction(pwallet, request, *operation);
+    }
+    auto op = std::make_shared<AsyncSaplingOperation>(pwallet, std::move(operation), "shieldsendmanyasync", request.params);
+    if (!GetSaplingOperationQueue()->Push(op)) {
+        throw JSONRPCError(RPC_WALLET_ERROR, strprintf("Too many shielded sends in progress (max %d)", MAX_PENDING_SAPLING_OPERATIONS));
+    }
+    return op->GetId();
+}
+
+static std::set<std::string> ParseOperationIds(const UniValue& ids)
+{
+    std::set<std::string> setIds;
+    if (!ids.isNull()) {
+        for (const UniValue& id : ids.get_array().getValues()) {
+            setIds.insert(id.get_str());
+        }
+    }
+    return setIds;
+}
+
+UniValue getoperationstatus(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp))
+        return NullUniValue;
+
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+                "getoperationstatus ( [\"operationid\", ...] )\n"
+                "\nGet the status of the operations queued by shieldsendmanyasync (all of them, or only the given ones).\n"
+
+                "\nArguments:\n"
+                "1. \"operationids\"        (array, optional) A list of operation ids.\n"
+
+                "\nResult:\n"
+                "[\n"
+                "  {\n"
+                "    \"id\": \"xxxx\",            (string) The operation id\n"
+                "    \"status\": \"xxxx\",        (string) queued|executing|success|failed|cancelled\n"
+                "    \"creation_time\": n,      (numeric) The time the operation was queued, in seconds since epoch\n"
+                "    \"method\": \"xxxx\",        (string) The RPC method queuing the operation\n"
+                "    \"params\": {...},         (json) The parameters of the method\n"
+                "    \"stage\": \"xxxx\",         (string, executing only) selecting inputs|proving|sending\n"
+                "    \"execution_secs\": n,     (numeric, not when queued or cancelled) The time spent executing\n"
+                "    \"result\": {\"txid\": \"xxxx\"},                (json, success only) The transaction sent\n"
+                "    \"error\": {\"code\": n, \"message\": \"xxxx\"}   (json, failed only) The error\n"
+                "  }, ...\n"
+                "]\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("getoperationstatus", "")
+                + HelpExampleCli("getoperationstatus", "'[\"opid-0bd5c9d2b8d48e1e8e2b7d1e7a4ef3b1\"]'")
+                + HelpExampleRpc("getoperationstatus", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    for (const auto& op : GetSaplingOperationQueue()->GetOperations(pwallet, ParseOperationIds(request.params[0]))) {
+        ret.push_back(op->ToJSON());
+    }
+    return ret;
+}
+
+UniValue getoperationresult(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp))
+        return NullUniValue;
+
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+                "getoperationresult ( [\"operationid\", ...] )\n"
+                "\nGet the status of the finished operations queued by shieldsendmanyasync (all of them, or only the given ones),\n"
+                "and forget them. The operations still queued or executing are not returned.\n"
+
+                "\nArguments:\n"
+                "1. \"operationids\"        (array, optional) A list of operation ids.\n"
+
+                "\nResult:\n"
+                "[\n"
+                "  {...}, ...             (json) The status of each finished operation, as returned by getoperationstatus\n"
+                "]\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("getoperationresult", "")
+                + HelpExampleCli("getoperationresult", "'[\"opid-0bd5c9d2b8d48e1e8e2b7d1e7a4ef3b1\"]'")
+                + HelpExampleRpc("getoperationresult", "")
+        );
+
+    SaplingOperationQueue* queue = GetSaplingOperationQueue();
+    UniValue ret(UniValue::VARR);
+    for (const auto& op : queue->GetOperations(pwallet, ParseOperationIds(request.params[0]))) {
+        if (!op->IsFinished()) continue;
+        ret.push_back(op->ToJSON());
+        queue->Remove(op->GetId());
+    }
+    return ret;
+}
+
+UniValue listoperationids(const JSONRPCRequest& request)
+{
+    CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp))
+        return NullUniValue;
+
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+                "listoperationids ( \"status\" )\n"
+                "\nList the ids of the operations queued by shieldsendmanyasync, in creation order.\n"
+
+                "\nArguments:\n"
+                "1. \"status\"              (string, optional) Only the operations with this status:\n"
+                "                             queued|executing|success|failed|cancelled\n"
+
+                "\nResult:\n"
+                "[\n"
+                "  \"operationid\"          (string) an operation id\n"
+                "  ,...\n"
+                "]\n"
+
+                "\nExamples:\n"
+                + HelpExampleCli("listoperationids", "")
+                + HelpExampleCli("listoperationids", "\"success\"")
+                + HelpExampleRpc("listoperationids", "\"success\"")
+        );
+
+    const std::string strStatus = request.params[0].isNull() ? "" : request.params[0].get_str();
+    UniValue ret(UniValue::VARR);
+    for (const auto& op : GetSaplingOperationQueue()->GetOperations(pwallet)) {
+        if (strStatus.empty() || AsyncOperationStatusToString(op->GetStatus()) == strStatus) {
+            ret.push_back(op->GetId());
+        }
+    }
+    return ret;
+}
+
 UniValue listaddressgroupings(const JSONRPCRequest& request)
 {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
@@ -3772,6 +3976,9 @@ UniValue encryptwallet(const JSONRPCRequest& request)
     return "wallet encrypted; oasis server stopping, restart to run with encrypted wallet. The keypool has been flushed, you need to make a new backup.";
 }
 
+/** Number of outputs written by listunspent between the waits for the reader (without the wallet lock) */
+static const size_t UNSPENT_JSON_BATCH_SIZE = 1000;
+
 UniValue listunspent(const JSONRPCRequest& request)
 {
     CWallet * const pwallet = GetWalletForJSONRPCRequest(request);
@@ -3911,56 +4118,76 @@ UniValue listunspent(const JSONRPCRequest& request)
     bool include_unsafe = request.params.size() < 6 || request.params[5].get_bool();
     coinFilter.fOnlySafe = !include_unsafe;
 
-    UniValue results(UniValue::VARR);
-    std::vector<COutput> vecOutputs;
-
-    LOCK2(cs_main, pwallet->cs_wallet);
-    pwallet->AvailableCoins(&vecOutputs, &coinControl, coinFilter);
-    for (const COutput& out : vecOutputs) {
-        if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
-            continue;
-
-        if (!destinations.empty()) {
-            CTxDestination address;
-            if (!ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address))
+    // The outputs (with the hash of their transaction) are written in batches,
+    // releasing the locks in between. The ones of the transactions removed
+    // from the wallet meanwhile are skipped.
+    std::vector<std::pair<uint256, COutput>> vecOutputs;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+        std::vector<COutput> vecAvailable;
+        pwallet->AvailableCoins(&vecAvailable, &coinControl, coinFilter);
+        for (const COutput& out : vecAvailable) {
+            if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
                 continue;
 
-            if (!destinations.count(address))
-                continue;
-        }
+            if (!destinations.empty()) {
+                CTxDestination address;
+                if (!ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address))
+                    continue;
 
-        CAmount nValue = out.tx->tx->vout[out.i].nValue;
-        const CScript& pk = out.tx->tx->vout[out.i].scriptPubKey;
-        UniValue entry(UniValue::VOBJ);
-        entry.pushKV("txid", out.tx->GetHash().GetHex());
-        entry.pushKV("vout", out.i);
-        entry.pushKV("generated", out.tx->IsCoinStake() || out.tx->IsCoinBase());
-        CTxDestination address;
-        if (ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address)) {
-            entry.pushKV("address", EncodeDestination(address));
-            if (pwallet->HasAddressBook(address)) {
-                entry.pushKV("label", pwallet->GetNameForAddressBookEntry(address));
+                if (!destinations.count(address))
+                    continue;
             }
+            vecOutputs.emplace_back(out.tx->GetHash(), out);
         }
-        entry.pushKV("scriptPubKey", HexStr(pk));
-        if (pk.IsPayToScriptHash()) {
-            CTxDestination address;
-            if (ExtractDestination(pk, address)) {
-                const CScriptID& hash = boost::get<CScriptID>(address);
-                CScript redeemScript;
-                if (pwallet->GetCScript(hash, redeemScript))
-                    entry.pushKV("redeemScript", HexStr(redeemScript));
-            }
-        }
-        entry.pushKV("amount", ValueFromAmount(nValue));
-        entry.pushKV("confirmations", out.nDepth);
-        entry.pushKV("spendable", out.fSpendable);
-        entry.pushKV("solvable", out.fSolvable);
-        entry.pushKV("safe", out.fSafe);
-        results.push_back(entry);
     }
 
-    return results;
+    return WriteRPCResult(request, [&](JSONWriter& writer) {
+        writer.BeginArray();
+        for (size_t nBatchStart = 0; nBatchStart < vecOutputs.size(); nBatchStart += UNSPENT_JSON_BATCH_SIZE) {
+            {
+                LOCK2(cs_main, pwallet->cs_wallet);
+                const size_t nBatchEnd = std::min(vecOutputs.size(), nBatchStart + UNSPENT_JSON_BATCH_SIZE);
+                for (size_t i = nBatchStart; i < nBatchEnd; i++) {
+                    const COutput& out = vecOutputs[i].second;
+                    if (pwallet->GetWalletTx(vecOutputs[i].first) != out.tx)
+                        continue;
+
+                    CAmount nValue = out.tx->tx->vout[out.i].nValue;
+                    const CScript& pk = out.tx->tx->vout[out.i].scriptPubKey;
+                    UniValue entry(UniValue::VOBJ);
+                    entry.pushKV("txid", out.tx->GetHash().GetHex());
+                    entry.pushKV("vout", out.i);
+                    entry.pushKV("generated", out.tx->IsCoinStake() || out.tx->IsCoinBase());
+                    CTxDestination address;
+                    if (ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address)) {
+                        entry.pushKV("address", EncodeDestination(address));
+                        if (pwallet->HasAddressBook(address)) {
+                            entry.pushKV("label", pwallet->GetNameForAddressBookEntry(address));
+                        }
+                    }
+                    entry.pushKV("scriptPubKey", HexStr(pk));
+                    if (pk.IsPayToScriptHash()) {
+                        CTxDestination address;
+                        if (ExtractDestination(pk, address)) {
+                            const CScriptID& hash = boost::get<CScriptID>(address);
+                            CScript redeemScript;
+                            if (pwallet->GetCScript(hash, redeemScript))
+                                entry.pushKV("redeemScript", HexStr(redeemScript));
+                        }
+                    }
+                    entry.pushKV("amount", ValueFromAmount(nValue));
+                    entry.pushKV("confirmations", out.nDepth);
+                    entry.pushKV("spendable", out.fSpendable);
+                    entry.pushKV("solvable", out.fSolvable);
+                    entry.pushKV("safe", out.fSafe);
+                    writer.Value(entry);
+                }
+            }
+            writer.Flush();
+        }
+        writer.EndArray();
+    });
 }
 
 UniValue fundrawtransaction(const JSONRPCRequest& request)
@@ -4466,6 +4693,7 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
             "  \"lastattempt_hash\": xxx            (hex string) hash of the block on top of which the last stake attempt was made\n"
             "  \"lastattempt_coins\": n             (numeric) number of stakeable coins available during last stake attempt\n"
             "  \"lastattempt_tries\": n             (numeric) number of stakeable coins checked during last stake attempt\n"
+            "  \"lastattempt_searchtime\": n        (numeric) microseconds spent hashing the kernels during last stake attempt\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -4496,6 +4724,7 @@ UniValue getstakingstatus(const JSONRPCRequest& request)
             obj.pushKV("lastattempt_hash", ss->GetLastHash().GetHex());
             obj.pushKV("lastattempt_coins", ss->GetLastCoins());
             obj.pushKV("lastattempt_tries", ss->GetLastTries());
+            obj.pushKV("lastattempt_searchtime", ss->GetLastSearchTime());
         }
         return obj;
     }
@@ -4911,6 +5140,10 @@ static const CRPCCommand commands[] =
     { "wallet",             "listshieldunspent",             &listshieldunspent,              false, {"minconf","maxconf","include_watchonly","addresses"} },
     { "wallet",             "rawshieldsendmany",             &rawshieldsendmany,              false, {"fromaddress","amounts","minconf","fee"} },
     { "wallet",             "shieldsendmany",                &shieldsendmany,                 false, {"fromaddress","amounts","minconf","fee","subtract_fee_from"} },
+    { "wallet",             "shieldsendmanyasync",           &shieldsendmanyasync,            false, {"fromaddress","amounts","minconf","fee","subtract_fee_from"} },
+    { "wallet",             "getoperationstatus",            &getoperationstatus,             true,  {"operationids"} },
+    { "wallet",             "getoperationresult",            &getoperationresult,             true,  {"operationids"} },
+    { "wallet",             "listoperationids",              &listoperationids,               true,  {"status"} },
     { "wallet",             "listreceivedbyshieldaddress",   &listreceivedbyshieldaddress,    false, {"address","minconf"} },
     { "wallet",             "viewshieldtransaction",         &viewshieldtransaction,          false, {"txid"} },
     { "wallet",             "getsaplingnotescount",          &getsaplingnotescount,           false, {"minconf"} },
@@ -9,6 +9,7 @@
 #include "util/blockstatecatcher.h"
 #include "blocksignature.h"
 #include "consensus/merkle.h"
+#include "kernel.h"
 #include "primitives/block.h"
 #include "script/sign.h"
 #include "test/util/blocksutil.h"
@@ -194,6 +195,63 @@ static COutput GetUnspentCoin(CWallet* pwallet, std::initializer_list<std::share
     throw std::runtime_error("Unspent coin not found");
 }
 
+BOOST_FIXTURE_TEST_CASE(kernel_search_tests, TestPoSChainSetup)
+{
+    const CBlockIndex* pindexPrev = WITH_LOCK(cs_main, return chainActive.Tip());
+    SyncWithValidationInterfaceQueue();
+    std::vector<CStakeableOutput> availableCoins;
+    BOOST_CHECK(pwalletMain->StakeableCoins(&availableCoins));
+
+    // Easy target (2^220, about 2^250 once weighted by the 1000 XOS coins), to get some hits.
+    // Add the coins three times, to go over the parallel threshold.
+    const unsigned int nBits = 0x1c100000;
+    std::vector<std::unique_ptr<CPivStake>> vInputs;
+    for (int r = 0; r < 3; r++) {
+        for (const CStakeableOutput& out : availableCoins) {
+            vInputs.emplace_back(new CPivStake(out.tx->tx->vout[out.i], COutPoint(out.tx->GetHash(), out.i), out.pindex));
+        }
+    }
+    BOOST_CHECK(vInputs.size() >= 512);
+
+    // The cached (midstate) search must give the same result as the reference kernel, both
+    // on the calling thread and on the thread pool
+    for (int nThreads : {1, 4}) {
+        CStakeKernelSearch search(nThreads);
+        search.Reset(pindexPrev, nBits, 1);
+        for (const auto& input : vInputs) search.AddInput(input.get());
+        BOOST_CHECK(search.IsCachedFor(pindexPrev, nBits, 1));
+        BOOST_CHECK(!search.IsCachedFor(pindexPrev, nBits, 2));
+
+        int nTotalHits = 0;
+        for (int nTime = pindexPrev->nTime + 1; nTime < (int)pindexPrev->nTime + 50; nTime++) {
+            CStakeKernelSearch::Hits expected;
+            for (size_t i = 0; i < vInputs.size(); i++) {
+                if (CStakeKernel(pindexPrev, vInputs[i].get(), nBits, nTime).CheckKernelHash(true)) {
+                    expected.emplace_back(i);
+                }
+            }
+            BOOST_CHECK(search.Search(nTime) == expected);
+            nTotalHits += expected.size();
+        }
+        BOOST_CHECK(nTotalHits > 0);
+
+        // Drop the first copy of the coins
+        std::vector<bool> vErase(vInputs.size(), false);
+        std::fill(vErase.begin(), vErase.begin() + availableCoins.size(), true);
+        search.EraseInputs(vErase, 2);
+        BOOST_CHECK_EQUAL(search.size(), vInputs.size() - availableCoins.size());
+        BOOST_CHECK(search.IsCachedFor(pindexPrev, nBits, 2));
+        const int nTime = pindexPrev->nTime + 1;
+        CStakeKernelSearch::Hits expected;
+        for (size_t i = availableCoins.size(); i < vInputs.size(); i++) {
+            if (CStakeKernel(pindexPrev, vInputs[i].get(), nBits, nTime).CheckKernelHash(true)) {
+                expected.emplace_back(i - availableCoins.size());
+            }
+        }
+        BOOST_CHECK(search.Search(nTime) == expected);
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(created_on_fork_tests, TestPoSChainSetup)
 {
     // Let's create few more PoS blocks
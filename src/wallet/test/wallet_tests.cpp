@@ -499,7 +499,7 @@ CBlockIndex* SimpleFakeMine(CWalletTx& wtx, CWallet &wallet, CBlockIndex* pprev
     block.vtx.emplace_back(wtx.tx);
     block.hashMerkleRoot = BlockMerkleRoot(block);
     if (pprev) block.hashPrevBlock = pprev->GetBlockHash();
-    CBlockIndex* fakeIndex = new CBlockIndex(block);
+    CBlockIndex* fakeIndex = blockIndexArena.Alloc(block);
     fakeIndex->pprev = pprev;
     mapBlockIndex.emplace(block.GetHash(), fakeIndex);
     fakeIndex->phashBlock = &mapBlockIndex.find(block.GetHash())->first;
@@ -14,8 +14,10 @@
 #include "budget/budgetmanager.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
+#include "ctpl.h"
 #include "evo/deterministicmns.h"
 #include "guiinterfaceutil.h"
+#include "index/blockfilterindex.h"
 #include "masternode.h"
 #include "policy/policy.h"
 #include "sapling/key_io_sapling.h"
@@ -963,6 +965,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         }
     }
 
+    m_sspk_man->AddToWitnessedNotes(wtx);
+
     //// debug print
     LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -1029,6 +1033,7 @@ bool CWallet::LoadToWallet(CWalletTx& wtxIn)
     wtx.BindWallet(this);
     // Sapling
     m_sspk_man->UpdateNullifierNoteMapWithTx(wtx);
+    m_sspk_man->AddToWitnessedNotes(wtx);
     wtxOrdered.emplace(wtx.nOrderPos, &wtx);
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
@@ -1043,9 +1048,18 @@ bool CWallet::LoadToWallet(CWalletTx& wtxIn)
     return true;
 }
 
-bool CWallet::FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData)
+bool CWallet::FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData,
+                                                      const std::map<uint256, SaplingNotesFound>* pSaplingNotes)
 {
-    auto saplingNoteDataAndAddressesToAdd = m_sspk_man->FindMySaplingNotes(tx);
+    SaplingNotesFound saplingNoteDataAndAddressesToAdd;
+    if (pSaplingNotes) {
+        auto it = pSaplingNotes->find(tx.GetHash());
+        if (it != pSaplingNotes->end()) {
+            saplingNoteDataAndAddressesToAdd = m_sspk_man->FindMySaplingNotes(it->second);
+        }
+    } else {
+        saplingNoteDataAndAddressesToAdd = m_sspk_man->FindMySaplingNotes(tx);
+    }
     saplingNoteData = saplingNoteDataAndAddressesToAdd.first;
     auto addressesToAdd = saplingNoteDataAndAddressesToAdd.second;
     // Add my addresses
@@ -1094,7 +1108,8 @@ void CWallet::AddExternalNotesDataToTx(CWalletTx& wtx) const
  * Abandoned state should probably be more carefully tracked via different
  * posInBlock signals or by checking mempool presence when necessary.
  */
-bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm, bool fUpdate)
+bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm, bool fUpdate,
+                                       const std::map<uint256, SaplingNotesFound>* pSaplingNotes)
 {
     const CTransaction& tx = *ptx;
     {
@@ -1119,7 +1134,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CWallet
         // Check tx for Sapling notes
         Optional<mapSaplingNoteData_t> saplingNoteData {nullopt};
         if (HasSaplingSPKM()) {
-            if (!FindNotesDataAndAddMissingIVKToKeystore(tx, saplingNoteData)) {
+            if (!FindNotesDataAndAddMissingIVKToKeystore(tx, saplingNoteData, pSaplingNotes)) {
                 return false; // error adding incoming viewing key.
             }
         }
@@ -1277,9 +1292,10 @@ void CWallet::MarkConflicted(const uint256& hashBlock, int conflicting_height, c
     }
 }
 
-void CWallet::SyncTransaction(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm)
+void CWallet::SyncTransaction(const CTransactionRef& ptx, const CWalletTx::Confirmation& confirm,
+                              const std::map<uint256, SaplingNotesFound>* pSaplingNotes)
 {
-    if (!AddToWalletIfInvolvingMe(ptx, confirm, true)) {
+    if (!AddToWalletIfInvolvingMe(ptx, confirm, true, pSaplingNotes)) {
         return; // Not one of ours
     }
 
@@ -1344,10 +1360,19 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         m_last_block_processed = pindex->GetBlockHash();
         m_last_block_processed_time = pindex->GetBlockTime();
         m_last_block_processed_height = pindex->nHeight;
+
+        // Sapling: trial-decrypt the shielded outputs of the whole block at once, on the worker threads
+        std::map<uint256, SaplingNotesFound> mapSaplingNotes;
+        const bool fSaplingNotes = HasSaplingSPKM();
+        if (fSaplingNotes) {
+            size_t nOutputs;
+            mapSaplingNotes = m_sspk_man->GetNoteDecryptor()->DecryptBlock(*pblock, m_sspk_man->GetSaplingIncomingViewingKeys(), nOutputs);
+        }
+
         for (size_t index = 0; index < pblock->vtx.size(); index++) {
             CWalletTx::Confirmation confirm(CWalletTx::Status::CONFIRMED, m_last_block_processed_height,
                                             m_last_block_processed, index);
-            SyncTransaction(pblock->vtx[index], confirm);
+            SyncTransaction(pblock->vtx[index], confirm, fSaplingNotes ? &mapSaplingNotes : nullptr);
             TransactionRemovedFromMempool(pblock->vtx[index], MemPoolRemovalReason::BLOCK);
         }
 
@@ -1873,6 +1898,23 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+void CWallet::GetBlockFilterElements(GCSFilter::ElementSet& elements) const
+{
+    std::set<CKeyID> setKeyIDs;
+    GetKeys(setKeyIDs);
+    for (const CKeyID& keyID : setKeyIDs) {
+        elements.emplace(keyID.begin(), keyID.end());
+    }
+    LOCK(cs_KeyStore);
+    for (const auto& it : mapScripts) {
+        elements.emplace(it.first.begin(), it.first.end());
+    }
+    for (const CScript& script : setWatchOnly) {
+        elements.emplace(script.begin(), script.end());
+        AddScriptFilterElements(script, elements);
+    }
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1912,8 +1954,71 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             dProgressTip = Checkpoints::GuessVerificationProgress(tip, false);
         }
 
+        // The blocks are read and their shielded outputs trial-decrypted on the worker
+        // threads, up to nReadAhead blocks ahead of the one being added to the wallet.
+        // With the block filter index, the blocks whose filter doesn't match the scripts
+        // of the wallet (nor the shielded transactions, if it has Sapling keys) are skipped.
+        struct ScannedBlock {
+            bool fRead{false};
+            bool fSkipped{false};
+            CBlock block;
+            std::map<uint256, SaplingNotesFound> mapSaplingNotes;
+            size_t nOutputs{0};
+            BlockFilter filter;
+            std::shared_ptr<const GCSFilter::ElementSet> filterElements;
+        };
+        const bool fSaplingNotes = HasSaplingSPKM();
+        SaplingNoteDecryptor* decryptor;
+        std::vector<libzcash::SaplingIncomingViewingKey> vIvks;
+        std::shared_ptr<const GCSFilter::ElementSet> filterElements;
+        auto fnUpdateFilterElements = [&]() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet) {
+            if (!g_blockfilterindex) return;
+            auto elements = std::make_shared<GCSFilter::ElementSet>();
+            GetBlockFilterElements(*elements);
+            if (fSaplingNotes) elements->emplace(SHIELDED_TX_ELEMENT);
+            filterElements = std::move(elements);
+        };
+        {
+            LOCK(cs_wallet);
+            decryptor = m_sspk_man->GetNoteDecryptor();
+            if (fSaplingNotes) vIvks = m_sspk_man->GetSaplingIncomingViewingKeys();
+            fnUpdateFilterElements();
+        }
+        const size_t nReadAhead = 2 * decryptor->GetNumThreads();
+        std::deque<std::pair<CBlockIndex*, std::future<ScannedBlock>>> scanQueue;
+        CBlockIndex* pindexNextRead = pindex;
+        auto fillScanQueue = [&]() {
+            while (pindexNextRead && scanQueue.size() < nReadAhead) {
+                CBlockIndex* pindexRead = pindexNextRead;
+                // Workers don't lock cs_main (which may be held by the caller)
+                const FlatFilePos pos = WITH_LOCK(cs_main, return pindexRead->GetBlockPos(); );
+                const uint256 hashBlock = pindexRead->GetBlockHash();
+                scanQueue.emplace_back(pindexRead, decryptor->GetPool().push([pos, hashBlock, pindexRead, decryptor, &vIvks, filterElements](int threadId) {
+                    ScannedBlock scanned;
+                    if (filterElements && g_blockfilterindex->LookupFilter(pindexRead, scanned.filter) &&
+                            !scanned.filter.GetFilter().MatchAny(*filterElements)) {
+                        scanned.fSkipped = true;
+                        scanned.filterElements = filterElements;
+                        return scanned;
+                    }
+                    scanned.fRead = ReadBlockFromDisk(scanned.block, pos) && scanned.block.GetHash() == hashBlock;
+                    if (scanned.fRead) {
+                        scanned.mapSaplingNotes = decryptor->DecryptBlock(scanned.block, vIvks, scanned.nOutputs, false);
+                    }
+                    return scanned;
+                }));
+                pindexNextRead = (pindexRead == pindexStop) ? nullptr : WITH_LOCK(cs_main, return chainActive.Next(pindexRead); );
+            }
+        };
+
+        const int64_t nScanStart = GetTimeMillis();
+        uint64_t nScannedOutputs = 0;
+        int nScannedBlocks = 0;
+        int nSkippedBlocks = 0;
         std::vector<uint256> myTxHashes;
-        while (pindex && !fAbortRescan) {
+        fillScanQueue();
+        while (!scanQueue.empty() && !fAbortRescan) {
+            pindex = scanQueue.front().first;
             double gvp = 0;
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
                 gvp = WITH_LOCK(cs_main, return Checkpoints::GuessVerificationProgress(pindex, false); );
@@ -1921,14 +2026,41 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             }
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, gvp);
+                LogPrintf("Still rescanning. At block %d. Progress=%f, %.1f shielded outputs/s\n", pindex->nHeight, gvp,
+                          1000.0 * nScannedOutputs / std::max((int64_t) 1, GetTimeMillis() - nScanStart));
             }
             if (fromStartup && ShutdownRequested()) {
                 break;
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex)) {
+            ScannedBlock scanned = scanQueue.front().second.get();
+            scanQueue.pop_front();
+            nScannedBlocks++;
+            nScannedOutputs += scanned.nOutputs;
+            if (scanned.fSkipped && scanned.filterElements != filterElements &&
+                    scanned.filter.GetFilter().MatchAny(*filterElements)) {
+                // The wallet got new scripts after the filter was checked. This block has no
+                // shielded transaction to decrypt (or the wallet has no Sapling keys).
+                scanned.fSkipped = false;
+                const FlatFilePos pos = WITH_LOCK(cs_main, return pindex->GetBlockPos(); );
+                scanned.fRead = ReadBlockFromDisk(scanned.block, pos) && scanned.block.GetHash() == pindex->GetBlockHash();
+            }
+            if (scanned.fSkipped) {
+                nSkippedBlocks++;
+                LOCK2(cs_main, cs_wallet);
+                if (!chainActive.Contains(pindex)) {
+                    ret = pindex;
+                    break;
+                }
+                // Increment note witness caches: the block has no note commitment
+                if (pindex->pprev && Params().GetConsensus().NetworkUpgradeActive(pindex->pprev->nHeight, Consensus::UPGRADE_V4_0)) {
+                    SaplingMerkleTree saplingTree;
+                    assert(pcoinsTip->GetSaplingAnchorAt(pindex->pprev->hashFinalSaplingRoot, saplingTree));
+                    const CBlock emptyBlock;
+                    ChainTipAdded(pindex, &emptyBlock, saplingTree);
+                }
+            } else if (scanned.fRead) {
+                const CBlock& block = scanned.block;
                 LOCK2(cs_main, cs_wallet);
                 if (pindex && !chainActive.Contains(pindex)) {
                      // Abort scan if current block is no longer active, to prevent
@@ -1936,13 +2068,19 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                      ret = pindex;
                      break;
                  }
+                bool fAddedTxes = false;
                 for (int posInBlock = 0; posInBlock < (int) block.vtx.size(); posInBlock++) {
                     const auto& tx = block.vtx[posInBlock];
                     CWalletTx::Confirmation confirm(CWalletTx::Status::CONFIRMED, pindex->nHeight, pindex->GetBlockHash(), posInBlock);
-                    if (AddToWalletIfInvolvingMe(tx, confirm, fUpdate)) {
+                    if (AddToWalletIfInvolvingMe(tx, confirm, fUpdate, fSaplingNotes ? &scanned.mapSaplingNotes : nullptr)) {
                         myTxHashes.push_back(tx->GetHash());
+                        fAddedTxes = true;
                     }
                 }
+                // The keypool may have been topped up
+                if (fAddedTxes) {
+                    fnUpdateFilterElements();
+                }
 
                 // Sapling
                 // This should never fail: we should always be able to get the tree
@@ -1963,13 +2101,25 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             }
             {
                 LOCK(cs_main);
-                pindex = chainActive.Next(pindex);
                 if (tip != chainActive.Tip()) {
                     tip = chainActive.Tip();
                     // in case the tip has changed, update progress max
                     dProgressTip = Checkpoints::GuessVerificationProgress(tip, false);
                 }
             }
+            fillScanQueue();
+        }
+        // Wait for the blocks still being read (they use vIvks)
+        for (auto& it : scanQueue) {
+            it.second.wait();
+        }
+        if (nSkippedBlocks > 0) {
+            LogPrintf("Rescan skipped %d of %d blocks not matching the block filters\n", nSkippedBlocks, nScannedBlocks);
+        }
+        if (nScannedOutputs > 0) {
+            const int64_t nScanTime = GetTimeMillis() - nScanStart;
+            LogPrintf("Rescan trial-decrypted %u shielded outputs in %dms (%.1f outputs/s, %d threads)\n",
+                      nScannedOutputs, nScanTime, 1000.0 * nScannedOutputs / std::max((int64_t) 1, nScanTime), decryptor->GetNumThreads());
         }
 
         // Sapling
@@ -3296,6 +3446,16 @@ int CWallet::GetLastBlockHeightLockWallet() const
     return WITH_LOCK(cs_wallet, return m_last_block_processed_height;);
 }
 
+// Identify a list of stakeable coins (in order), to detect when the kernel search cache is stale
+static uint64_t GetStakeableCoinsId(const std::vector<CStakeableOutput>& coins)
+{
+    uint64_t nId = coins.size();
+    for (const CStakeableOutput& out : coins) {
+        nId = (nId * 0x100000001b3ULL) ^ (out.tx->GetHash().GetCheapHash() + out.i);
+    }
+    return nId;
+}
+
 bool CWallet::CreateCoinStake(
         const CBlockIndex* pindexPrev,
         unsigned int nBits,
@@ -3304,61 +3464,96 @@ bool CWallet::CreateCoinStake(
         std::vector<CStakeableOutput>* availableCoins,
         bool stopOnNewBlock) const
 {
-    // shuffle coins
-    if (availableCoins && Params().IsRegTestNet()) {
-        Shuffle(availableCoins->begin(), availableCoins->end(), FastRandomContext());
-    }
-
     // Mark coin stake transaction
     txNew.vin.clear();
     txNew.vout.clear();
     txNew.vout.emplace_back(0, CScript());
 
+    // The kernel search (and the hits it returns) can't be shared with another search
+    LOCK(cs_stakeKernelSearch);
+
+    // Cache the constant part of the kernels of the available coins (once per tip)
+    if (!pStakeKernelSearch->IsCachedFor(pindexPrev, nBits, GetStakeableCoinsId(*availableCoins))) {
+        // shuffle coins
+        if (Params().IsRegTestNet()) {
+            Shuffle(availableCoins->begin(), availableCoins->end(), FastRandomContext());
+        }
+        pStakeKernelSearch->Reset(pindexPrev, nBits, GetStakeableCoinsId(*availableCoins));
+        for (const CStakeableOutput& out : *availableCoins) {
+            CPivStake stakeInput(out.tx->tx->vout[out.i], COutPoint(out.tx->GetHash(), out.i), out.pindex);
+            pStakeKernelSearch->AddInput(&stakeInput);
+        }
+    }
+
+    // Make sure the stake inputs haven't been spent since last check (remove them from the available coins)
+    {
+        std::vector<bool> vSpent(availableCoins->size(), false);
+        bool fAnySpent = false;
+        {
+            LOCK(cs_wallet);
+            for (size_t i = 0; i < availableCoins->size(); i++) {
+                const CStakeableOutput& out = (*availableCoins)[i];
+                vSpent[i] = IsSpent(COutPoint(out.tx->GetHash(), out.i));
+                fAnySpent |= vSpent[i];
+            }
+        }
+        if (fAnySpent) {
+            size_t j = 0;
+            for (size_t i = 0; i < availableCoins->size(); i++) {
+                if (!vSpent[i]) (*availableCoins)[j++] = (*availableCoins)[i];
+            }
+            availableCoins->erase(availableCoins->begin() + j, availableCoins->end());
+            pStakeKernelSearch->EraseInputs(vSpent, GetStakeableCoinsId(*availableCoins));
+        }
+    }
+
     // update staker status (hash)
     pStakerStatus->SetLastTip(pindexPrev);
     pStakerStatus->SetLastCoins((int) availableCoins->size());
 
-    // Kernel Search
-    CAmount nCredit;
-    CScript scriptPubKeyKernel;
-    bool fKernelFound = false;
-    int nAttempts = 0;
-    for (auto it = availableCoins->begin(); it != availableCoins->end();) {
-        COutPoint outPoint = COutPoint(it->tx->GetHash(), it->i);
-        CPivStake stakeInput(it->tx->tx->vout[it->i],
-                             outPoint,
-                             it->pindex);
-
-        // New block came in, move on
-        if (stopOnNewBlock && GetLastBlockHeightLockWallet() != pindexPrev->nHeight) return false;
-
-        // Make sure the wallet is unlocked and shutdown hasn't been requested
-        if (IsLocked() || ShutdownRequested()) return false;
-
-        // Make sure the stake input hasn't been spent since last check
-        if (WITH_LOCK(cs_wallet, return IsSpent(outPoint))) {
-            // remove it from the available coins
-            it = availableCoins->erase(it);
-            continue;
-        }
+    // Make sure the wallet is unlocked and shutdown hasn't been requested
+    if (IsLocked() || ShutdownRequested()) return false;
 
-        nCredit = 0;
+    // Get the new time slot (and verify it's not the same as previous block)
+    const bool fRegTest = Params().IsRegTestNet();
+    nTxNewTime = (fRegTest ? GetAdjustedTime() : GetCurrentTimeSlot());
+    if (nTxNewTime <= pindexPrev->nTime && !fRegTest) {
+        pStakerStatus->SetLastTime(nTxNewTime);
+        return false;
+    }
 
-        nAttempts++;
-        fKernelFound = Stake(pindexPrev, &stakeInput, nBits, nTxNewTime);
+    // Kernel Search: hash all the coins for this time slot
+    const int64_t nSearchStart = GetTimeMicros();
+    const CStakeKernelSearch::Hits& hits = pStakeKernelSearch->Search(nTxNewTime);
+    const int nAttempts = (int) availableCoins->size();
 
-        // update staker status (time, attempts)
-        pStakerStatus->SetLastTime(nTxNewTime);
-        pStakerStatus->SetLastTries(nAttempts);
+    // update staker status (time, attempts, search time)
+    pStakerStatus->SetLastTime(nTxNewTime);
+    pStakerStatus->SetLastTries(nAttempts);
+    pStakerStatus->SetLastSearchTime(GetTimeMicros() - nSearchStart);
 
-        if (!fKernelFound) {
-            it++;
+    // New block came in, move on
+    if (stopOnNewBlock && GetLastBlockHeightLockWallet() != pindexPrev->nHeight) return false;
+
+    CAmount nCredit;
+    bool fKernelFound = false;
+    for (const size_t idx : hits) {
+        const CStakeableOutput& out = (*availableCoins)[idx];
+        CPivStake stakeInput(out.tx->tx->vout[out.i],
+                             COutPoint(out.tx->GetHash(), out.i),
+                             out.pindex);
+
+        // Double check the kernel with the reference implementation
+        CStakeKernel stakeKernel(pindexPrev, &stakeInput, nBits, nTxNewTime);
+        if (!stakeKernel.CheckKernelHash()) {
+            LogPrintf("%s : cached kernel search mismatch for %s\n", __func__, stakeInput.GetTxIn().prevout.ToString());
             continue;
         }
 
         // Found a kernel
         LogPrintf("CreateCoinStake : kernel found\n");
-        nCredit += stakeInput.GetValue();
+        fKernelFound = true;
+        nCredit = stakeInput.GetValue();
 
         // Add block reward to the credit
         nCredit += GetBlockValue(pindexPrev->nHeight + 1);
@@ -3367,7 +3562,7 @@ bool CWallet::CreateCoinStake(
         std::vector<CTxOut> vout;
         if (!stakeInput.CreateTxOuts(this, vout, nCredit)) {
             LogPrintf("%s : failed to create output\n", __func__);
-            it++;
+            fKernelFound = false;
             continue;
         }
         txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
@@ -3530,6 +3725,9 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     if (nLoadWalletRet != DB_LOAD_OK)
         return nLoadWalletRet;
 
+    // Stop updating the witnesses of the notes already spent
+    m_sspk_man->RetireSpentNotes();
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -4453,6 +4651,14 @@ void CWallet::SetNull()
     } else {
         pStakerStatus = new CStakerStatus();
     }
+    {
+        LOCK(cs_stakeKernelSearch);
+        if (pStakeKernelSearch) {
+            pStakeKernelSearch->Reset(nullptr, 0, 0);
+        } else {
+            pStakeKernelSearch.reset(new CStakeKernelSearch(std::min(GetNumCores(), MAX_STAKE_SEARCH_THREADS)));
+        }
+    }
     // Stake split threshold
     nStakeSplitThreshold = DEFAULT_STAKE_SPLIT_THRESHOLD;
 
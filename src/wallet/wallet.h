@@ -10,6 +10,7 @@
 
 #include "addressbook.h"
 #include "amount.h"
+#include "blockfilter.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
 #include "crypter.h"
@@ -23,6 +24,7 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "sapling/address.h"
+#include "sapling/sapling_notes.h"
 #include "guiinterface.h"
 #include "util/system.h"
 #include "utilstrencodings.h"
@@ -78,6 +80,8 @@ static const bool DEFAULT_SPEND_ZEROCONF_CHANGE = true;
 static const bool DEFAULT_STAKING = true;
 //! Default for -coldstaking
 static const bool DEFAULT_COLDSTAKING = true;
+//! Maximum number of threads hashing stake kernels
+static const int MAX_STAKE_SEARCH_THREADS = 8;
 //! Defaults for -gen and -genproclimit
 static const bool DEFAULT_GENERATE = false;
 static const unsigned int DEFAULT_GENERATE_PROCLIMIT = 1;
@@ -189,6 +193,7 @@ private:
     int64_t nTime{0};
     int nTries{0};
     int nCoins{0};
+    int64_t nSearchTime{0};     // duration of the last kernel search (microseconds)
 
 public:
     // Get
@@ -198,17 +203,20 @@ public:
     int GetLastCoins() const { return nCoins; }
     int GetLastTries() const { return nTries; }
     int64_t GetLastTime() const { return nTime; }
+    int64_t GetLastSearchTime() const { return nSearchTime; }
     // Set
     void SetLastCoins(const int coins) { nCoins = coins; }
     void SetLastTries(const int tries) { nTries = tries; }
     void SetLastTip(const CBlockIndex* lastTip) { tipBlock = lastTip; }
     void SetLastTime(const uint64_t lastTime) { nTime = lastTime; }
+    void SetLastSearchTime(const int64_t searchTime) { nSearchTime = searchTime; }
     void SetNull()
     {
         SetLastCoins(0);
         SetLastTries(0);
         SetLastTip(nullptr);
         SetLastTime(0);
+        SetLastSearchTime(0);
     }
     // Check whether staking status is active (last attempt earlier than 30 seconds ago)
     bool IsActive() const { return (nTime + 30) >= GetTime(); }
@@ -269,7 +277,6 @@ private:
 
 template <class T>
 using TxSpendMap = std::multimap<T, uint256>;
-typedef std::map<SaplingOutPoint, SaplingNoteData> mapSaplingNoteData_t;
 
 typedef std::map<std::string, std::string> mapValue_t;
 
@@ -647,8 +654,10 @@ private:
     void SyncMetaData(std::pair<typename TxSpendMap<T>::iterator, typename TxSpendMap<T>::iterator> range);
     void ChainTipAdded(const CBlockIndex *pindex, const CBlock *pblock, SaplingMerkleTree saplingTree);
 
-    /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected */
-    void SyncTransaction(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm);
+    /* Used by TransactionAddedToMemorypool/BlockConnected/Disconnected.
+     * pSaplingNotes: the notes found by the trial decryption of the whole block, if done in advance */
+    void SyncTransaction(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm,
+                         const std::map<uint256, SaplingNotesFound>* pSaplingNotes = nullptr);
 
     bool IsKeyUsed(const CPubKey& vchPubKey) const;
 
@@ -735,6 +744,10 @@ public:
     static CAmount minStakeSplitThreshold;
     // Staker status (last hashed block and time)
     CStakerStatus* pStakerStatus = nullptr;
+    // Kernel search engine, caching the kernel prefix of the stakeable coins.
+    // Held by CreateCoinStake, which the staker thread and the RPC calls may run at once.
+    mutable Mutex cs_stakeKernelSearch;
+    std::unique_ptr<CStakeKernelSearch> pStakeKernelSearch GUARDED_BY(cs_stakeKernelSearch);
 
     // User-defined fee XOS/kb
     bool fUseCustomFee;
@@ -915,7 +928,9 @@ public:
     //////////// Sapling //////////////////
 
     // Search for notes and addresses from this wallet in the tx, and add the addresses --> IVK mapping to the keystore if missing.
-    bool FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData);
+    // If pSaplingNotes is set, the outputs were already trial-decrypted (txes without notes are not in the map).
+    bool FindNotesDataAndAddMissingIVKToKeystore(const CTransaction& tx, Optional<mapSaplingNoteData_t>& saplingNoteData,
+                                                 const std::map<uint256, SaplingNotesFound>* pSaplingNotes = nullptr);
     // Decrypt sapling output notes with the inputs ovk and updates saplingNoteDataMap
     void AddExternalNotesDataToTx(CWalletTx& wtx) const;
 
@@ -1015,7 +1030,8 @@ public:
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const uint256& blockHash, int nBlockHeight, int64_t blockTime) override;
-    bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm, bool fUpdate);
+    bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CWalletTx::Confirmation& confirm, bool fUpdate,
+                                  const std::map<uint256, SaplingNotesFound>* pSaplingNotes = nullptr);
     void EraseFromWallet(const uint256& hash);
 
     /**
@@ -1025,6 +1041,8 @@ public:
     bool ActivateSaplingWallet(bool memOnly = false);
 
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
+    //! The block filter elements of the scripts of the wallet (see BlockFilter)
+    void GetBlockFilterElements(GCSFilter::ElementSet& elements) const;
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver& reserver, bool fUpdate = false, bool fromStartup = false);
     void TransactionRemovedFromMempool(const CTransactionRef &ptx, MemPoolRemovalReason reason) override;
     void ReacceptWalletTransactions(bool fFirstLoad = false);
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Tests the JSON-RPC batches, executed sequentially and concurrently."""
+
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import assert_equal
+
+
+class RPCInterfaceTest(PivxTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.setup_clean_chain = True
+
+    def test_batch_ordering(self):
+        self.log.info("Testing the ordering of the batch replies...")
+        node = self.nodes[0]
+        height = node.getblockcount()
+        # getblockhash, getblockheader and echo are executed concurrently,
+        # getblockchaininfo is not, an unknown method fails in its slot.
+        requests = []
+        for h in range(height + 1):
+            requests.append(node.getblockhash.get_request(h))
+            requests.append(node.echo.get_request(h))
+        requests.append(node.getblockchaininfo.get_request())
+        requests.append(node.getblockheader.get_request(node.getbestblockhash()))
+        requests.append({"method": "unknownmethod", "id": -1})
+        requests.append(node.getblockcount.get_request())
+        replies = node.batch(requests)
+
+        assert_equal([r["id"] for r in replies], [r["id"] for r in requests])
+        for h in range(height + 1):
+            assert_equal(replies[2 * h]["error"], None)
+            assert_equal(replies[2 * h]["result"], node.getblockhash(h))
+            assert_equal(replies[2 * h + 1]["result"], [h])
+        tail = replies[2 * (height + 1):]
+        assert_equal(tail[0]["result"]["blocks"], height)
+        assert_equal(tail[1]["result"]["height"], height)
+        assert_equal(tail[2]["result"], None)
+        assert_equal(tail[2]["error"]["code"], -32601)
+        assert_equal(tail[3]["result"], height)
+
+    def test_batch_write_barrier(self):
+        self.log.info("Testing that the calls after a write call see its effects...")
+        node = self.nodes[0]
+        height = node.getblockcount()
+        requests = [
+            node.getblockcount.get_request(),
+            node.getbestblockhash.get_request(),
+            node.generate.get_request(1),
+            node.getblockcount.get_request(),
+            node.getbestblockhash.get_request(),
+            node.getblockhash.get_request(height + 1),
+        ]
+        replies = node.batch(requests)
+        assert all(r["error"] is None for r in replies)
+        assert_equal(replies[0]["result"], height)
+        assert_equal(replies[1]["result"], node.getblockhash(height))
+        new_hash = replies[2]["result"][0]
+        assert_equal(replies[3]["result"], height + 1)
+        assert_equal(replies[4]["result"], new_hash)
+        assert_equal(replies[5]["result"], new_hash)
+
+    def run_batch_tests(self):
+        self.test_batch_ordering()
+        self.test_batch_write_barrier()
+
+    def run_test(self):
+        self.nodes[0].generate(10)
+        self.log.info("Default batch threads and concurrency")
+        self.run_batch_tests()
+        for args in [["-rpcbatchconcurrency=1"],
+                     ["-rpcbatchthreads=2", "-rpcbatchconcurrency=16"],
+                     ["-rpcbatchthreads=0"]]:
+            self.log.info("Restarting with %s" % " ".join(args))
+            self.restart_node(0, extra_args=args)
+            self.run_batch_tests()
+
+
+if __name__ == '__main__':
+    RPCInterfaceTest().main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016-2020 The Bitcoin Core developers
+# Copyright (c) 2022 The OASIS developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test compact block relay (BIP152).
+
+- the node offers compact blocks (low bandwidth) to peers supporting them,
+- a peer asking for high bandwidth mode is announced new blocks as cmpctblock,
+  with the coinbase (and the coinstake of proof-of-stake blocks) prefilled and
+  the block signature carried along,
+- getblocktxn is answered with blocktxn, or with the full block for old blocks,
+- a getblocktxn with an out-of-bounds index gets the peer disconnected,
+- two nodes relay blocks to each other as compact blocks, using less bandwidth
+  than the full blocks.
+"""
+
+import time
+
+from test_framework.messages import (
+    BlockTransactionsRequest,
+    CBlock,
+    FromHex,
+    HeaderAndShortIDs,
+    calculate_shortid,
+    msg_getblocktxn,
+    msg_sendcmpct,
+)
+from test_framework.mininode import (
+    P2PInterface,
+    mininode_lock,
+)
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_greater_than,
+    hex_str_to_bytes,
+    wait_until,
+)
+
+COMPACT_BLOCKS_VERSION = 90916
+
+
+class CompactBlocksNode(P2PInterface):
+    def peer_connect(self, *args, **kwargs):
+        create_conn = super().peer_connect(*args, **kwargs)
+        # Announce a protocol version with compact block support
+        self.on_connection_send_msg.nVersion = COMPACT_BLOCKS_VERSION
+        return create_conn
+
+    def clear_block_messages(self):
+        with mininode_lock:
+            self.last_message.pop("cmpctblock", None)
+            self.last_message.pop("blocktxn", None)
+            self.last_message.pop("block", None)
+
+
+class CompactBlocksTest(PivxTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+
+    def send_transactions(self, count):
+        for _ in range(count):
+            self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        self.sync_mempools()
+
+    def test_sendcmpct(self, test_node):
+        self.log.info("Check that the node offers compact blocks")
+        wait_until(lambda: "sendcmpct" in test_node.last_message, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            assert_equal(test_node.last_message["sendcmpct"].announce, False)
+            assert_equal(test_node.last_message["sendcmpct"].version, 1)
+
+    def test_cmpctblock_announcement(self, test_node):
+        self.log.info("Check that new blocks are announced as cmpctblock in high bandwidth mode")
+        node = self.nodes[0]
+        sendcmpct = msg_sendcmpct()
+        sendcmpct.announce = True
+        sendcmpct.version = 1
+        test_node.send_and_ping(sendcmpct)
+
+        self.send_transactions(3)
+        test_node.clear_block_messages()
+        block_hash = node.generate(1)[0]
+        wait_until(lambda: "cmpctblock" in test_node.last_message, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            header_and_shortids = HeaderAndShortIDs(test_node.last_message["cmpctblock"].header_and_shortids)
+        header_and_shortids.header.calc_sha256()
+        assert_equal(header_and_shortids.header.hash, block_hash)
+
+        block_hex = node.getblock(block_hash, False)
+        block = FromHex(CBlock(), block_hex)
+        block.rehash()
+        [tx.calc_sha256() for tx in block.vtx]
+        assert_greater_than(len(block.vtx), 2)
+        is_pos = block.vtx[1].is_coinstake()
+        prefilled = [x.index for x in header_and_shortids.prefilled_txn]
+        assert_equal(prefilled, [0, 1] if is_pos else [0])
+        for x in header_and_shortids.prefilled_txn:
+            x.tx.calc_sha256()
+            assert_equal(x.tx.sha256, block.vtx[x.index].sha256)
+
+        # Short ids of the other transactions, in block order
+        [k0, k1] = header_and_shortids.get_siphash_keys()
+        expected_shortids = [calculate_shortid(k0, k1, tx.sha256) for i, tx in enumerate(block.vtx) if i not in prefilled]
+        assert_equal(header_and_shortids.shortids, expected_shortids)
+
+        # The block signature follows the transactions of the full block
+        if is_pos:
+            assert_greater_than(len(header_and_shortids.block_sig), 0)
+            assert hex_str_to_bytes(block_hex).endswith(header_and_shortids.block_sig)
+        else:
+            assert_equal(header_and_shortids.block_sig, b"")
+        return block
+
+    def test_getblocktxn(self, test_node, block):
+        self.log.info("Check that getblocktxn is answered with blocktxn")
+        test_node.clear_block_messages()
+        indexes = list(range(1, len(block.vtx)))
+        msg = msg_getblocktxn()
+        msg.block_txn_request = BlockTransactionsRequest(block.sha256, [])
+        msg.block_txn_request.from_absolute(indexes)
+        test_node.send_message(msg)
+        wait_until(lambda: "blocktxn" in test_node.last_message, timeout=30, lock=mininode_lock)
+        with mininode_lock:
+            block_txn = test_node.last_message["blocktxn"].block_transactions
+        assert_equal(block_txn.blockhash, block.sha256)
+        assert_equal(len(block_txn.transactions), len(indexes))
+        for tx, i in zip(block_txn.transactions, indexes):
+            tx.calc_sha256()
+            assert_equal(tx.sha256, block.vtx[i].sha256)
+
+        self.log.info("Check that getblocktxn for an old block is answered with the full block")
+        self.nodes[0].generate(11)
+        self.sync_blocks()
+        test_node.clear_block_messages()
+        test_node.send_message(msg)
+        test_node.wait_for_block(block.sha256, timeout=30)
+        with mininode_lock:
+            assert "blocktxn" not in test_node.last_message
+
+    def test_node_relay(self):
+        self.log.info("Check that the nodes relay blocks to each other as compact blocks")
+        node0, node1 = self.nodes[0], self.nodes[1]
+        # The first block validated from a peer makes it one of the high bandwidth peers
+        node0.generate(1)
+        self.sync_blocks()
+
+        def get_cmpct_bytes():
+            bytes_per_msg = [p["bytesrecv_per_msg"] for p in node1.getpeerinfo()]
+            return sum(b.get("cmpctblock", 0) + b.get("blocktxn", 0) for b in bytes_per_msg)
+
+        cmpct_bytes_before = get_cmpct_bytes()
+        full_bytes = 0
+        latencies = []
+        for _ in range(5):
+            self.send_transactions(5)
+            start = time.time()
+            block_hash = node0.generate(1)[0]
+            wait_until(lambda: node1.getbestblockhash() == block_hash, timeout=30)
+            latencies.append(time.time() - start)
+            full_bytes += node0.getblock(block_hash)["size"]
+        cmpct_bytes = get_cmpct_bytes() - cmpct_bytes_before
+
+        self.log.info("Relayed %d bytes of blocks with %d bytes of cmpctblock/blocktxn, %.3fs average latency" %
+                      (full_bytes, cmpct_bytes, sum(latencies) / len(latencies)))
+        assert_greater_than(cmpct_bytes, 0)
+        assert_greater_than(full_bytes, cmpct_bytes)
+
+    def test_invalid_getblocktxn(self, test_node):
+        self.log.info("Check that a getblocktxn with an out-of-bounds index gets the peer disconnected")
+        block_hash = self.nodes[0].getbestblockhash()
+        tx_count = len(self.nodes[0].getblock(block_hash)["tx"])
+        msg = msg_getblocktxn()
+        msg.block_txn_request = BlockTransactionsRequest(int(block_hash, 16), [])
+        msg.block_txn_request.from_absolute([tx_count])
+        test_node.send_message(msg)
+        test_node.wait_for_disconnect()
+
+    def run_test(self):
+        test_node = self.nodes[0].add_p2p_connection(CompactBlocksNode())
+        self.test_sendcmpct(test_node)
+        block = self.test_cmpctblock_announcement(test_node)
+        self.test_getblocktxn(test_node, block)
+        self.test_node_relay()
+        self.test_invalid_getblocktxn(test_node)
+
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
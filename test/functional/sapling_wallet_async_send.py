@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The OASIS developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or https://www.opensource.org/licenses/mit-license.php .
+"""Test the shielded sends queued by shieldsendmanyasync.
+
+- the operation id is returned right away, the status goes through
+  queued/executing to success, with the txid of the transaction sent,
+- a failing operation reports its error,
+- listoperationids filters by status, getoperationresult forgets the
+  finished operations.
+"""
+
+from decimal import Decimal
+
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    wait_until,
+)
+
+
+class SaplingWalletAsyncSend(PivxTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.setup_clean_chain = True
+        saplingUpgrade = ['-nuparams=v5_shield:201']
+        self.extra_args = [saplingUpgrade + ['-shieldsendthreads=2'], saplingUpgrade]
+
+    def wait_for_operations(self, node, opids):
+        wait_until(lambda: all(op["status"] not in ("queued", "executing")
+                               for op in node.getoperationstatus(opids)), timeout=120)
+        return {op["id"]: op for op in node.getoperationstatus(opids)}
+
+    def run_test(self):
+        node0, node1 = self.nodes
+        self.log.info("Mining...")
+        node0.generate(210)
+        self.sync_all()
+
+        self.log.info("Queue shielded sends from transparent funds")
+        saplingAddr0 = node0.getnewshieldaddress()
+        saplingAddr1 = node1.getnewshieldaddress()
+        opids = []
+        for amount in (10, 20, 30):
+            recipients = [{"address": saplingAddr1, "amount": Decimal(amount)},
+                          {"address": saplingAddr0, "amount": Decimal(amount)}]
+            opid = node0.shieldsendmanyasync("from_transparent", recipients)
+            assert opid.startswith("opid-")
+            opids.append(opid)
+        assert_equal(set(node0.listoperationids()), set(opids))
+        assert_equal(node1.listoperationids(), [])
+
+        ops = self.wait_for_operations(node0, opids)
+        txids = []
+        for opid in opids:
+            op = ops[opid]
+            assert_equal(op["status"], "success")
+            assert_equal(op["method"], "shieldsendmanyasync")
+            assert "error" not in op
+            txids.append(op["result"]["txid"])
+        assert_equal(len(set(txids)), 3)
+        assert_equal(set(node0.getrawmempool()), set(txids))
+        node0.generate(1)
+        self.sync_all()
+        assert_equal(node1.getshieldbalance(saplingAddr1), Decimal('60'))
+        assert_equal(node0.getshieldbalance(saplingAddr0), Decimal('60'))
+
+        self.log.info("Queue a shielded send from a shield address")
+        opid = node0.shieldsendmanyasync(saplingAddr0, [{"address": saplingAddr1, "amount": Decimal('5')}])
+        op = self.wait_for_operations(node0, [opid])[opid]
+        assert_equal(op["status"], "success")
+        assert op["execution_secs"] > 0
+        assert op["result"]["txid"] in node0.getrawmempool()
+
+        self.log.info("A failing operation reports its error")
+        opid_failed = node0.shieldsendmanyasync(saplingAddr0, [{"address": saplingAddr1, "amount": Decimal('1000')}])
+        op = self.wait_for_operations(node0, [opid_failed])[opid_failed]
+        assert_equal(op["status"], "failed")
+        assert_equal(op["error"]["code"], -4)
+        assert "Insufficient shielded funds" in op["error"]["message"]
+        assert_equal(node0.listoperationids("failed"), [opid_failed])
+
+        self.log.info("Invalid parameters are still reported by the call")
+        assert_raises_rpc_error(-5, "Invalid from address",
+                                node0.shieldsendmanyasync, "invalidaddress", [{"address": saplingAddr1, "amount": 1}])
+
+        self.log.info("getoperationresult forgets the finished operations")
+        results = node0.getoperationresult([opid_failed])
+        assert_equal(len(results), 1)
+        assert_equal(results[0]["id"], opid_failed)
+        assert opid_failed not in node0.listoperationids()
+        results = node0.getoperationresult()
+        assert_equal(len(results), 4)
+        assert_equal(node0.listoperationids(), [])
+        assert_equal(node0.getoperationresult(), [])
+
+
+if __name__ == '__main__':
+    SaplingWalletAsyncSend().main()
@@ -741,6 +741,7 @@ class P2PHeaderAndShortIDs:
         self.shortids = []
         self.prefilled_txn_length = 0
         self.prefilled_txn = []
+        self.block_sig = b""
 
     def deserialize(self, f):
         self.header.deserialize(f)
@@ -752,6 +753,8 @@ class P2PHeaderAndShortIDs:
             self.shortids.append(struct.unpack("<Q", f.read(6) + b'\x00\x00')[0])
         self.prefilled_txn = deser_vector(f, PrefilledTransaction)
         self.prefilled_txn_length = len(self.prefilled_txn)
+        # The block signature of proof-of-stake blocks (empty for proof-of-work blocks)
+        self.block_sig = deser_string(f)
 
     # When using version 2 compact blocks, we must serialize with_witness.
     def serialize(self, with_witness=False):
@@ -766,10 +769,11 @@ class P2PHeaderAndShortIDs:
             r += ser_vector(self.prefilled_txn, "serialize_with_witness")
         else:
             r += ser_vector(self.prefilled_txn, "serialize_without_witness")
+        r += ser_string(self.block_sig)
         return r
 
     def __repr__(self):
-        return "P2PHeaderAndShortIDs(header=%s, nonce=%d, shortids_length=%d, shortids=%s, prefilled_txn_length=%d, prefilledtxn=%s" % (repr(self.header), self.nonce, self.shortids_length, repr(self.shortids), self.prefilled_txn_length, repr(self.prefilled_txn))
+        return "P2PHeaderAndShortIDs(header=%s, nonce=%d, shortids_length=%d, shortids=%s, prefilled_txn_length=%d, prefilledtxn=%s, block_sig=%s" % (repr(self.header), self.nonce, self.shortids_length, repr(self.shortids), self.prefilled_txn_length, repr(self.prefilled_txn), self.block_sig.hex())
 
 # P2P version of the above that will use witness serialization (for compact
 # block version 2)
@@ -791,11 +795,13 @@ class HeaderAndShortIDs:
         self.nonce = 0
         self.shortids = []
         self.prefilled_txn = []
+        self.block_sig = b""
         self.use_witness = False
 
         if p2pheaders_and_shortids is not None:
             self.header = p2pheaders_and_shortids.header
             self.nonce = p2pheaders_and_shortids.nonce
+            self.block_sig = p2pheaders_and_shortids.block_sig
             self.shortids = p2pheaders_and_shortids.shortids
             last_index = -1
             for x in p2pheaders_and_shortids.prefilled_txn:
@@ -817,6 +823,7 @@ class HeaderAndShortIDs:
         for x in self.prefilled_txn:
             ret.prefilled_txn.append(PrefilledTransaction(x.index - last_index - 1, x.tx))
             last_index = x.index
+        ret.block_sig = self.block_sig
         return ret
 
     def get_siphash_keys(self):
@@ -833,6 +840,7 @@ class HeaderAndShortIDs:
         self.nonce = nonce
         self.prefilled_txn = [ PrefilledTransaction(i, block.vtx[i]) for i in prefill_list ]
         self.shortids = []
+        self.block_sig = getattr(block, "vchBlockSig", b"")
         self.use_witness = use_witness
         [k0, k1] = self.get_siphash_keys()
         for i in range(len(block.vtx)):
@@ -69,6 +69,7 @@ BASE_SCRIPTS= [
     'rpc_fundrawtransaction.py',                # ~ 227 sec
     'mining_pos_coldStaking.py',                # ~ 220 sec
     'wallet_import_rescan.py',                  # ~ 204 sec
+    'wallet_rescan_blockfilter.py',
     'rpc_bind.py --ipv4',
     'rpc_bind.py --ipv6',
     'rpc_bind.py --nonloopback',
@@ -132,7 +133,9 @@ BASE_SCRIPTS= [
     'wallet_autocombine.py',                    # ~ 49 sec
     'mining_v5_upgrade.py',                     # ~ 48 sec
     'p2p_mempool.py',                           # ~ 46 sec
+    'p2p_compactblocks.py',
     'rpc_named_arguments.py',                   # ~ 45 sec
+    'interface_rpc.py',
     'feature_filelock.py',
     'feature_help.py',                          # ~ 30 sec
 
@@ -174,6 +177,7 @@ SAPLING_SCRIPTS = [
     'sapling_wallet_send.py',                   # ~ 126 sec
     'sapling_mempool.py',                       # ~ 98 sec
     'sapling_wallet_persistence.py',            # ~ 90 sec
+    'sapling_wallet_async_send.py',             # ~ 60 sec
     'sapling_supply.py',                        # ~ 58 sec
     'sapling_malleable_sigs.py',                # ~ 44 sec
 ]
@@ -234,6 +238,7 @@ LEGACY_SKIP_TESTS = [
     'sapling_wallet_listreceived.py',
     'sapling_wallet_nullifiers.py',
     'sapling_mempool.py',
+    'sapling_wallet_async_send.py',
     'wallet_importmulti.py',
     'wallet_import_rescan.py',
     'wallet_multiwallet.py',
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# Copyright (c) 2022 The OASIS developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or https://www.opensource.org/licenses/mit-license.php.
+"""Test the wallet rescans with the block filter index.
+
+Node 1 runs with -blockfilterindex: a rescan skips the blocks whose filter
+doesn't match its wallet, and still finds the transactions of the imported key,
+also after the block of the transaction is disconnected and connected again.
+"""
+
+import os
+
+from test_framework.test_framework import PivxTestFramework
+from test_framework.util import (
+    assert_equal,
+    wait_until,
+)
+
+
+class WalletRescanBlockFilterTest(PivxTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [[], ["-blockfilterindex"]]
+
+    def filter_index_synced(self):
+        debug_log = os.path.join(self.nodes[1].datadir, 'regtest', 'debug.log')
+        with open(debug_log, encoding='utf-8') as dl:
+            return "Block filter index is enabled" in dl.read()
+
+    def run_test(self):
+        wait_until(self.filter_index_synced, timeout=60)
+
+        self.log.info("Sending to a key that node 1 doesn't have yet...")
+        addr = self.nodes[0].getnewaddress()
+        privkey = self.nodes[0].dumpprivkey(addr)
+        txid = self.nodes[0].sendtoaddress(addr, 10)
+        block_hash = self.nodes[0].generate(1)[0]
+        self.nodes[0].generate(5)
+        self.sync_all()
+
+        self.log.info("Importing it: the rescan skips the blocks not matching the wallet")
+        with self.nodes[1].assert_debug_log(["Rescan skipped"]):
+            self.nodes[1].importprivkey(privkey, "", True)
+        assert_equal(self.nodes[1].gettransaction(txid)["blockhash"], block_hash)
+        assert_equal(self.nodes[1].getreceivedbyaddress(addr), 10)
+
+        self.log.info("Rescanning after the block of the transaction is disconnected and connected again...")
+        self.nodes[1].invalidateblock(block_hash)
+        self.nodes[1].reconsiderblock(block_hash)
+        assert_equal(self.nodes[1].getbestblockhash(), self.nodes[0].getbestblockhash())
+        with self.nodes[1].assert_debug_log(["Rescan skipped"]):
+            self.nodes[1].rescanblockchain()
+        assert_equal(self.nodes[1].gettransaction(txid)["blockhash"], block_hash)
+        assert_equal(self.nodes[1].getreceivedbyaddress(addr), 10)
+
+
+if __name__ == '__main__':
+    WalletRescanBlockFilterTest().main()